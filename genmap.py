@@ -58,6 +58,25 @@ class _Ps2Key:
     code: int
     type: str
 
+    @property
+    def make_sequence(self) -> list[int]:
+        # Scancode set 2
+        return {
+            "reg": [self.code],
+            "spec": [0xE0, self.code],
+            "print": [0xE0, 0x12, 0xE0, 0x7C],
+            "pause": [0xE1, 0x14, 0x77, 0xE1, 0xF0, 0x14, 0xF0, 0x77],
+        }[self.type]
+
+    @property
+    def break_sequence(self) -> list[int]:
+        return {
+            "reg": [0xF0, self.code],
+            "spec": [0xE0, 0xF0, self.code],
+            "print": [0xE0, 0xF0, 0x7C, 0xE0, 0xF0, 0x12],
+            "pause": [],  # Pause has no break code
+        }[self.type]
+
 
 @dataclasses.dataclass(frozen=True)
 class _X11Key:
@@ -0,0 +1,120 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "proto.h"
+#include "host.h"
+
+
+// Пропускная способность пути "байты Serial1 -> разбор кадра -> отчет -> ответ".
+// Один байт за итерацию loop(), как у настоящего DRIVERS::Serial, так что
+// кадр - это восемь итераций. Время настоящее, виртуальное только для прошивки.
+
+#define DEFAULT_FRAMES	100000
+
+
+static unsigned long long _nowNs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void _feedPing(unsigned frames) {
+	for (unsigned index = 0; index < frames; ++index) {
+		HOST::serialFeedFrame(PROTO::CMD::PING, 0, 0, 0, 0);
+	}
+}
+
+static void _feedKeys(unsigned frames) {
+	for (unsigned index = 0; index < frames; ++index) {
+		const uint8_t key = 1 + (index / 2) % 26; // KeyA...KeyZ, press and release
+		HOST::serialFeedFrame(PROTO::CMD::KEYBOARD::KEY, key, !(index & 1), 0, 0);
+	}
+}
+
+static void _feedMouseAbs(unsigned frames) {
+	for (unsigned index = 0; index < frames; ++index) {
+		const int16_t x = (int16_t)(index * 37);
+		const int16_t y = (int16_t)(index * 59);
+		HOST::serialFeedFrame(PROTO::CMD::MOUSE::MOVE, (uint16_t)x >> 8, x & 0xFF, (uint16_t)y >> 8, y & 0xFF);
+	}
+}
+
+static void _feedMouseRel(unsigned frames) {
+	for (unsigned index = 0; index < frames; ++index) {
+		HOST::serialFeedFrame(PROTO::CMD::MOUSE::RELATIVE, 3, (uint8_t)-2, 0, 0);
+	}
+}
+
+static void _run(const char *name, uint8_t outputs, void (*feed)(unsigned), unsigned frames) {
+	fflush(stdout);
+	const pid_t pid = fork();
+	if (pid == 0) {
+		// Outputs of the previous firmware, see Journal::_readLegacy()
+		uint8_t *const data = HOST::storageData();
+		memset(data, 0, 8);
+		data[0] = PROTO::MAGIC;
+		data[1] = outputs;
+		PROTO::split16(PROTO::crc16(data, 6), &data[6], &data[7]);
+
+		HOST::run(100000); // Boot
+		HOST::usbReportsClear();
+
+		feed(frames);
+		const unsigned long reports = HOST::usbReportsTotal();
+		const unsigned long loops = HOST::loops();
+		const unsigned long long begin_ns = _nowNs();
+		HOST::drain(0);
+		const unsigned long long elapsed_ns = _nowNs() - begin_ns;
+
+		printf("%-16s %9u %9lu %9.1f %9.3f %9.1f\n",
+			name, frames, HOST::usbReportsTotal() - reports,
+			(double)elapsed_ns / frames,
+			(double)frames * 1000 / elapsed_ns,
+			(double)(HOST::loops() - loops) / frames);
+		exit(0);
+	}
+	waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char **argv) {
+	const unsigned frames = (argc > 1 ? (unsigned)atol(argv[1]) : DEFAULT_FRAMES);
+	const uint8_t usb = PROTO::OUTPUTS1::KEYBOARD::USB | PROTO::OUTPUTS1::MOUSE::USB_ABS;
+	const uint8_t usb_nkro = PROTO::OUTPUTS1::KEYBOARD::USB_NKRO | PROTO::OUTPUTS1::MOUSE::USB_ABS;
+	const uint8_t usb_rel = PROTO::OUTPUTS1::KEYBOARD::USB | PROTO::OUTPUTS1::MOUSE::USB_REL;
+
+	printf("%-16s %9s %9s %9s %9s %9s\n", "# scenario", "frames", "reports", "ns/frame", "Mframe/s", "loops/fr");
+	_run("ping", usb, _feedPing, frames);
+	_run("usb_key", usb, _feedKeys, frames);
+	_run("usb_nkro_key", usb_nkro, _feedKeys, frames);
+	_run("usb_mouse_abs", usb, _feedMouseAbs, frames);
+	_run("usb_mouse_rel", usb_rel, _feedMouseRel, frames);
+	return 0;
+}
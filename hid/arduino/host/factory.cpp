@@ -0,0 +1,167 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+
+#ifdef HOST_STM32
+#	include "usb/keyboard-stm32.h"
+#	include "usb/hid-wrapper-stm32.h"
+#	include "usb/mouse-absolute-stm32.h"
+#	include "usb/mouse-relative-stm32.h"
+#else
+#	include "usb/hid.h"
+#endif
+#include "factory.h"
+#include "serial.h"
+#include "host.h"
+
+// Хостовая замена lib/drivers-avr/factory.cpp (или lib/drivers-stm32/factory.cpp): USB-драйверы
+// настоящие (поверх фейка HID-Project или USBComposite), а EEPROM или backup-регистры
+// и плата только запоминают, что с ними делали.
+
+
+static uint8_t _storage[HOST_STORAGE_SIZE];
+static bool _storage_inited = false;
+static unsigned long _storage_write_us = HOST_STORAGE_WRITE_US;
+static unsigned long _storage_busy_ts = 0;
+static unsigned long _storage_writes = 0;
+static unsigned long _board_resets = 0;
+
+
+class HostStorage : public DRIVERS::Storage {
+	public:
+		using DRIVERS::Storage::Storage;
+
+		void readBlock(void *dest, const void *src, size_t size) override {
+			memcpy(dest, &HOST::storageData()[(uintptr_t)src], size);
+		}
+
+		void updateBlock(const void *src, void *dest, size_t size) override {
+			uint8_t *const data = &HOST::storageData()[(uintptr_t)dest];
+			if (memcmp(data, src, size)) {
+				// Like eeprom_update_block(), the same bytes are not written
+				memcpy(data, src, size);
+				_storage_writes += size;
+				_storage_busy_ts = micros() + _storage_write_us * size;
+			}
+		}
+
+		size_t getSize() override {
+			return HOST_STORAGE_SIZE;
+		}
+
+		bool isReady() override {
+			return (micros() >= _storage_busy_ts);
+		}
+
+		bool hasWriteLatency() override {
+			return (_storage_write_us > 0);
+		}
+};
+
+class HostBoard : public DRIVERS::Board {
+	public:
+		using DRIVERS::Board::Board;
+
+		void reset() override {
+			++_board_resets; // The harness keeps running, the test decides what to do next
+		}
+};
+
+
+namespace DRIVERS {
+#	ifdef HOST_STM32
+	HidWrapper _hidWrapper;
+
+	Keyboard *Factory::makeKeyboard(type _type) {
+		switch (_type) {
+			case USB_KEYBOARD: return new UsbKeyboard(_hidWrapper);
+			default: return new Keyboard(DUMMY);
+		}
+	}
+
+	Mouse *Factory::makeMouse(type _type) {
+		switch (_type) {
+			case USB_MOUSE_ABSOLUTE: return new UsbMouseAbsolute(_hidWrapper);
+			case USB_MOUSE_RELATIVE: return new UsbMouseRelative(_hidWrapper);
+			default: return new Mouse(DRIVERS::DUMMY);
+		}
+	}
+#	else
+	Keyboard *Factory::makeKeyboard(type _type) {
+		switch (_type) {
+			case USB_KEYBOARD: return new UsbKeyboard();
+			case USB_KEYBOARD_NKRO: return new UsbKeyboardNkro();
+			default: return new Keyboard(DUMMY);
+		}
+	}
+
+	Mouse *Factory::makeMouse(type _type) {
+		switch (_type) {
+			case USB_MOUSE_ABSOLUTE:
+			case USB_MOUSE_ABSOLUTE_WIN98:
+				return new UsbMouseAbsolute(_type);
+			case USB_MOUSE_RELATIVE:
+				return new UsbMouseRelative();
+			default:
+				return new Mouse(DRIVERS::DUMMY);
+		}
+	}
+#	endif
+
+	Storage *Factory::makeStorage(type _type) {
+		switch (_type) {
+			case NON_VOLATILE_STORAGE: return new HostStorage(DRIVERS::NON_VOLATILE_STORAGE);
+			default: return new Storage(DRIVERS::DUMMY);
+		}
+	}
+
+	Board *Factory::makeBoard(type _type) {
+		return new HostBoard(DRIVERS::BOARD);
+	}
+
+	Connection *Factory::makeConnection(type _type) {
+		return new Serial();
+	}
+}
+
+
+namespace HOST {
+	uint8_t *storageData() {
+		if (!_storage_inited) {
+			memset(_storage, 0xFF, HOST_STORAGE_SIZE); // Erased EEPROM
+			_storage_inited = true;
+		}
+		return _storage;
+	}
+
+	void storageSetWriteUs(unsigned long us) {
+		_storage_write_us = us;
+	}
+
+	unsigned long storageWrites() {
+		return _storage_writes;
+	}
+
+	unsigned long boardResets() {
+		return _board_resets;
+	}
+}
@@ -0,0 +1,66 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+
+#pragma once
+
+// Минимальное ядро Arduino для сборки на хосте: время виртуальное и идет
+// только в HOST::run(), регистры USB-контроллера AVR отражают состояние
+// эндпоинтов фейкового хоста, см. host.cpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define ARDUINO_ARCH_HOST
+
+unsigned long millis();
+unsigned long micros();
+
+// USB controller of ATmega32U4, only the endpoint probe of HID_USB_CHECK_ENDPOINT
+extern uint8_t SREG;
+extern uint8_t UENUM;
+uint8_t hostGetUeintx();
+#define UEINTX	hostGetUeintx()
+#define RWAL	5
+#define cli()
+
+class USBDevice_ {
+	public:
+		bool configured();
+};
+extern USBDevice_ USBDevice;
+
+// The USB host side for the fake HID libraries
+int hostSendReport(uint8_t ep, const void *data, int size);
+uint8_t hostGetLeds();
+
+class HardwareSerial {
+	public:
+		void begin(unsigned long speed) { (void)speed; }
+		int available();
+		int read();
+		size_t write(const uint8_t *data, size_t size);
+};
+extern HardwareSerial Serial1;
@@ -0,0 +1,136 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+
+#pragma once
+
+// Фейк HID-Project с той же семантикой add()/remove()/press()/release(),
+// что и у настоящей библиотеки (с патчем hid-win98.patch). Отчеты уходят
+// фейковому хосту, см. HOST::usbGetReports()
+
+#include <Arduino.h>
+
+
+enum KeyboardKeycode : uint8_t {
+	KEY_RESERVED = 0,
+	KEY_LEFT_CTRL = 0xE0,
+	KEY_RIGHT_GUI = 0xE7,
+};
+
+#define LED_NUM_LOCK	0x01
+#define LED_CAPS_LOCK	0x02
+#define LED_SCROLL_LOCK	0x04
+
+#define MOUSE_LEFT		0x01
+#define MOUSE_RIGHT		0x02
+#define MOUSE_MIDDLE	0x04
+#define MOUSE_PREV		0x08
+#define MOUSE_NEXT		0x10
+
+#define HOST_KEYBOARD_EP	1
+#define HOST_MOUSE_EP		2
+#define HOST_NKRO_KEYS		0x80 // Bitmap for usages 0x00...0x7F
+
+
+class HostHidDevice_ {
+	public:
+		HostHidDevice_(uint8_t ep) : _ep(ep) {}
+		uint8_t getPluggedEndpoint() { return _ep; }
+
+	protected:
+		int sendReport(const void *data, int size);
+
+	private:
+		uint8_t _ep;
+};
+
+class BootKeyboard_ : public HostHidDevice_ {
+	public:
+		BootKeyboard_() : HostHidDevice_(HOST_KEYBOARD_EP) {}
+		void begin() {}
+		size_t add(KeyboardKeycode key);
+		size_t remove(KeyboardKeycode key);
+		size_t releaseAll() { memset(&_report, 0, sizeof(_report)); return send(); }
+		int send() { return sendReport(&_report, sizeof(_report)); }
+		uint8_t getLeds();
+
+	private:
+		struct {
+			uint8_t mods;
+			uint8_t reserved;
+			uint8_t keys[6];
+		} _report = {0, 0, {0}};
+};
+
+class SingleNKROKeyboard_ : public HostHidDevice_ {
+	public:
+		SingleNKROKeyboard_() : HostHidDevice_(HOST_KEYBOARD_EP) {}
+		void begin() {}
+		size_t add(KeyboardKeycode key) { return _set(key, true); }
+		size_t remove(KeyboardKeycode key) { return _set(key, false); }
+		size_t releaseAll() { memset(&_report, 0, sizeof(_report)); return send(); }
+		int send() { return sendReport(&_report, sizeof(_report)); }
+		uint8_t getLeds();
+
+	private:
+		size_t _set(KeyboardKeycode key, bool state);
+
+		struct {
+			uint8_t mods;
+			uint8_t bitmap[HOST_NKRO_KEYS / 8];
+		} _report = {0, {0}};
+};
+
+class SingleAbsoluteMouse_ : public HostHidDevice_ {
+	public:
+		SingleAbsoluteMouse_() : HostHidDevice_(HOST_MOUSE_EP) {}
+		void begin() { releaseAll(); }
+		void setWin98FixEnabled(bool enabled) { _win98_fix = enabled; }
+		void releaseAll() { _buttons = 0; moveTo(_x, _y, 0); }
+		void press(uint8_t buttons) { _setButtons(_buttons | buttons); }
+		void release(uint8_t buttons) { _setButtons(_buttons & ~buttons); }
+		void move(int x, int y, signed char wheel);
+		void moveTo(int x, int y, signed char wheel = 0);
+
+	private:
+		void _setButtons(uint8_t buttons);
+
+		int _x = 0;
+		int _y = 0;
+		uint8_t _buttons = 0;
+		bool _win98_fix = false;
+};
+
+class BootMouse_ : public HostHidDevice_ {
+	public:
+		BootMouse_() : HostHidDevice_(HOST_MOUSE_EP) {}
+		void begin() { releaseAll(); }
+		void releaseAll() { _buttons = 0; move(0, 0, 0); }
+		void press(uint8_t buttons) { _setButtons(_buttons | buttons); }
+		void release(uint8_t buttons) { _setButtons(_buttons & ~buttons); }
+		void move(signed char x, signed char y, signed char wheel);
+
+	private:
+		void _setButtons(uint8_t buttons);
+
+		uint8_t _buttons = 0;
+};
@@ -0,0 +1,113 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#pragma once
+
+// Фейк USBComposite_stm32f1 для lib/drivers-stm32 с той же семантикой press()/release()/move(),
+// что и у настоящей библиотеки. Отчеты без report ID и в той же раскладке, что у фейка
+// HID-Project, чтобы их можно было сравнивать: клавиатура {mods, 0, keys[6]},
+// абсолютная мышь {buttons, x, y, wheel}, относительная {buttons, x, y, wheel}.
+// Координаты абсолютной мыши уходят как есть, библиотека их не масштабирует.
+
+#include <Arduino.h>
+
+
+typedef uint8_t uint8;
+typedef int8_t int8;
+typedef int16_t int16;
+
+#define HOST_KEYBOARD_EP	1 // Like in the HID-Project fake
+#define HOST_MOUSE_EP		2
+
+#define KEY_HID_OFFSET	0x88 // Raw usages are shifted by this, 0x80...0x87 are the modifiers
+
+#define MOUSE_LEFT		0x01
+#define MOUSE_RIGHT		0x02
+#define MOUSE_MIDDLE	0x04
+
+#define HID_KEYBOARD_REPORT_DESCRIPTOR(...)		0x05, 0x01, 0x09, 0x06
+#define HID_ABS_MOUSE_REPORT_DESCRIPTOR(...)	0x05, 0x01, 0x09, 0x02
+#define HID_MOUSE_REPORT_DESCRIPTOR(...)		0x05, 0x01, 0x09, 0x02
+
+
+class USBCompositeDevice {
+	public:
+		operator bool() { return USBDevice.configured(); }
+};
+extern USBCompositeDevice USBComposite;
+
+class USBHID {
+	public:
+		void begin(const uint8_t *report_descriptor, uint16_t report_descriptor_length) {
+			(void)report_descriptor;
+			(void)report_descriptor_length;
+		}
+};
+
+class HIDKeyboard {
+	public:
+		HIDKeyboard(USBHID &hid) { (void)hid; }
+		void begin() {}
+		size_t press(uint8_t key);
+		size_t release(uint8_t key);
+		void releaseAll();
+		uint8_t getLEDs() { return hostGetLeds(); }
+
+	private:
+		void _sendReport();
+
+		struct {
+			uint8_t mods;
+			uint8_t reserved;
+			uint8_t keys[6];
+		} _report = {0, 0, {0}};
+};
+
+class HIDAbsMouse {
+	public:
+		HIDAbsMouse(USBHID &hid) { (void)hid; }
+		void press(uint8_t buttons) { _setButtons(_buttons | buttons); }
+		void release(uint8_t buttons) { _setButtons(_buttons & ~buttons); }
+		void move(int16 x, int16 y, int8 wheel = 0);
+
+	private:
+		void _setButtons(uint8_t buttons);
+		void _sendReport();
+
+		uint8_t _buttons = 0;
+		int16 _x = 0;
+		int16 _y = 0;
+		int8 _wheel = 0;
+};
+
+class HIDMouse {
+	public:
+		HIDMouse(USBHID &hid) { (void)hid; }
+		void press(uint8_t buttons) { _setButtons(_buttons | buttons); }
+		void release(uint8_t buttons) { _setButtons(_buttons & ~buttons); }
+		void move(int8 x, int8 y, int8 wheel = 0);
+
+	private:
+		void _setButtons(uint8_t buttons);
+
+		uint8_t _buttons = 0;
+};
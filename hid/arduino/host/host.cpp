@@ -0,0 +1,311 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+
+#include <vector>
+
+#include <Arduino.h>
+#include <HID-Project.h>
+
+#include "proto.h"
+#include "host.h"
+
+
+void setup();
+void loop();
+
+
+static bool _booted = false;
+static unsigned long _now = 0;
+static unsigned long _loops = 0;
+static unsigned long _loop_us = HOST_LOOP_US;
+
+static std::vector<uint8_t> _rx;
+static size_t _rx_index = 0;
+static std::vector<uint8_t> _tx;
+
+static bool _usb_configured = true;
+static bool _usb_polling[8] = {true, true, true, true, true, true, true, true};
+static uint8_t _usb_leds = 0;
+static HOST::Report _reports[HOST_LOG_SIZE];
+static size_t _reports_count = 0;
+static unsigned long _reports_total = 0;
+
+
+// -----------------------------------------------------------------------------
+unsigned long millis() {
+	return _now / 1000;
+}
+
+unsigned long micros() {
+	return _now;
+}
+
+uint8_t SREG = 0;
+uint8_t UENUM = 0;
+
+uint8_t hostGetUeintx() {
+	return (_usb_configured && _usb_polling[UENUM & 7] ? (1 << RWAL) : 0);
+}
+
+bool USBDevice_::configured() {
+	return _usb_configured;
+}
+
+USBDevice_ USBDevice;
+
+int HardwareSerial::available() {
+	return _rx.size() - _rx_index;
+}
+
+int HardwareSerial::read() {
+	if (_rx_index >= _rx.size()) {
+		return -1;
+	}
+	const uint8_t ch = _rx[_rx_index];
+	++_rx_index;
+	if (_rx_index == _rx.size()) {
+		_rx.clear();
+		_rx_index = 0;
+	}
+	return ch;
+}
+
+size_t HardwareSerial::write(const uint8_t *data, size_t size) {
+	_tx.insert(_tx.end(), data, data + size);
+	return size;
+}
+
+HardwareSerial Serial1;
+
+
+// -----------------------------------------------------------------------------
+int hostSendReport(uint8_t ep, const void *data, int size) {
+	// The real USB_Send() gives up on a dead endpoint after a timeout
+	if (!_usb_configured || !_usb_polling[ep & 7]) {
+		return -1;
+	}
+	if (_reports_count < HOST_LOG_SIZE) {
+		HOST::Report *const report = &_reports[_reports_count];
+		report->ts = _now;
+		report->ep = ep;
+		report->size = size;
+		memcpy(report->data, data, size);
+		++_reports_count;
+	}
+	++_reports_total;
+	return size;
+}
+
+uint8_t hostGetLeds() {
+	return _usb_leds;
+}
+
+int HostHidDevice_::sendReport(const void *data, int size) {
+	return hostSendReport(_ep, data, size);
+}
+
+size_t BootKeyboard_::add(KeyboardKeycode key) {
+	if (key >= KEY_LEFT_CTRL && key <= KEY_RIGHT_GUI) {
+		_report.mods |= (1 << (key - KEY_LEFT_CTRL));
+		return 1;
+	}
+	for (uint8_t index = 0; index < 6; ++index) {
+		if (_report.keys[index] == key) {
+			return 1;
+		}
+	}
+	for (uint8_t index = 0; index < 6; ++index) {
+		if (_report.keys[index] == KEY_RESERVED) {
+			_report.keys[index] = key;
+			return 1;
+		}
+	}
+	return 0; // 6KRO is full
+}
+
+size_t BootKeyboard_::remove(KeyboardKeycode key) {
+	if (key >= KEY_LEFT_CTRL && key <= KEY_RIGHT_GUI) {
+		_report.mods &= ~(1 << (key - KEY_LEFT_CTRL));
+		return 1;
+	}
+	for (uint8_t index = 0; index < 6; ++index) {
+		if (_report.keys[index] == key) {
+			_report.keys[index] = KEY_RESERVED;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+uint8_t BootKeyboard_::getLeds() {
+	return hostGetLeds();
+}
+
+size_t SingleNKROKeyboard_::_set(KeyboardKeycode key, bool state) {
+	if (key >= KEY_LEFT_CTRL && key <= KEY_RIGHT_GUI) {
+		const uint8_t bit = (1 << (key - KEY_LEFT_CTRL));
+		_report.mods = (state ? _report.mods | bit : _report.mods & ~bit);
+		return 1;
+	}
+	if (key < HOST_NKRO_KEYS) {
+		const uint8_t bit = (1 << (key % 8));
+		uint8_t *const byte = &_report.bitmap[key / 8];
+		*byte = (state ? *byte | bit : *byte & ~bit);
+		return 1;
+	}
+	return 0;
+}
+
+uint8_t SingleNKROKeyboard_::getLeds() {
+	return hostGetLeds();
+}
+
+static int16_t _qadd16(int16_t base, int16_t increment) {
+	const int32_t sum = (int32_t)base + increment;
+	return (sum > INT16_MAX ? INT16_MAX : (sum < INT16_MIN ? INT16_MIN : sum));
+}
+
+void SingleAbsoluteMouse_::move(int x, int y, signed char wheel) {
+	moveTo(_qadd16(_x, x), _qadd16(_y, y), wheel);
+}
+
+void SingleAbsoluteMouse_::moveTo(int x, int y, signed char wheel) {
+	_x = x;
+	_y = y;
+	int16_t report_x = ((int32_t)x + 32768) / 2;
+	int16_t report_y = ((int32_t)y + 32768) / 2;
+	if (_win98_fix) {
+		report_x <<= 1;
+		report_y <<= 1;
+	}
+	const uint8_t report[6] = {
+		_buttons,
+		(uint8_t)(report_x & 0xFF), (uint8_t)(report_x >> 8),
+		(uint8_t)(report_y & 0xFF), (uint8_t)(report_y >> 8),
+		(uint8_t)wheel,
+	};
+	sendReport(report, sizeof(report));
+}
+
+void SingleAbsoluteMouse_::_setButtons(uint8_t buttons) {
+	if (_buttons != buttons) {
+		_buttons = buttons;
+		moveTo(_x, _y, 0);
+	}
+}
+
+void BootMouse_::move(signed char x, signed char y, signed char wheel) {
+	const uint8_t report[4] = {_buttons, (uint8_t)x, (uint8_t)y, (uint8_t)wheel};
+	sendReport(report, sizeof(report));
+}
+
+void BootMouse_::_setButtons(uint8_t buttons) {
+	if (_buttons != buttons) {
+		_buttons = buttons;
+		move(0, 0, 0);
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+namespace HOST {
+	void setLoopUs(unsigned long us) {
+		_loop_us = us;
+	}
+
+	void run(unsigned long us) {
+		if (!_booted) {
+			setup();
+			_booted = true;
+		}
+		const unsigned long end_ts = _now + us;
+		while (_now < end_ts) {
+			loop();
+			_now += _loop_us;
+			++_loops;
+		}
+	}
+
+	void drain(unsigned long us) {
+		while (Serial1.available() > 0) {
+			run(_loop_us);
+		}
+		run(us);
+	}
+
+	unsigned long now() {
+		return _now;
+	}
+
+	unsigned long loops() {
+		return _loops;
+	}
+
+	void serialFeed(const uint8_t *data, size_t size) {
+		_rx.insert(_rx.end(), data, data + size);
+	}
+
+	void serialFeedFrame(uint8_t cmd, uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+		uint8_t frame[8] = {PROTO::MAGIC, cmd, a, b, c, d, 0, 0};
+		PROTO::split16(PROTO::crc16(frame, 6), &frame[6], &frame[7]);
+		serialFeed(frame, 8);
+	}
+
+	size_t serialPending() {
+		return _tx.size();
+	}
+
+	size_t serialTake(uint8_t *buf, size_t size) {
+		if (size > _tx.size()) {
+			size = _tx.size();
+		}
+		memcpy(buf, _tx.data(), size);
+		_tx.erase(_tx.begin(), _tx.begin() + size);
+		return size;
+	}
+
+	void usbSetConfigured(bool configured) {
+		_usb_configured = configured;
+	}
+
+	void usbSetPolling(uint8_t ep, bool polling) {
+		_usb_polling[ep & 7] = polling;
+	}
+
+	void usbSetLeds(uint8_t leds) {
+		_usb_leds = leds;
+	}
+
+	const Report *usbReports(size_t *count) {
+		*count = _reports_count;
+		return _reports;
+	}
+
+	unsigned long usbReportsTotal() {
+		return _reports_total;
+	}
+
+	void usbReportsClear() {
+		_reports_count = 0;
+	}
+}
@@ -0,0 +1,82 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+// Прошивка собирается как есть (../src/main.cpp и lib/drivers*), а тест или
+// бенчмарк крутит ее loop() через HOST::run() и смотрит, что вышло наружу.
+// Время виртуальное: одна итерация loop() - HOST_LOOP_US микросекунд.
+// Транспорт всегда Serial1, PS/2 нет: его драйвер живет в прерывании Timer3.
+// С HOST_STM32 вместо lib/drivers-avr собираются USB-драйверы lib/drivers-stm32.
+
+#define HOST_LOOP_US		10
+#define HOST_LOG_SIZE		1024 // Only the first reports are kept, the total is counted anyway
+#define HOST_REPORT_SIZE	32
+#ifdef HOST_STM32
+#	define HOST_STORAGE_SIZE		20 // Backup registers of STM32F103
+#	define HOST_STORAGE_WRITE_US	0
+#else
+#	define HOST_STORAGE_SIZE		1024 // ATmega32U4
+#	define HOST_STORAGE_WRITE_US	3400 // The EEPROM byte write time
+#endif
+
+
+namespace HOST {
+	struct Report {
+		unsigned long ts;
+		uint8_t ep;
+		uint8_t size;
+		uint8_t data[HOST_REPORT_SIZE];
+	};
+
+	// Firmware control, the first run() calls setup()
+	void setLoopUs(unsigned long us);
+	void run(unsigned long us);
+	void drain(unsigned long us); // Until the serial input is consumed, then the given time
+	unsigned long now();
+	unsigned long loops();
+
+	// Serial1
+	void serialFeed(const uint8_t *data, size_t size);
+	void serialFeedFrame(uint8_t cmd, uint8_t a, uint8_t b, uint8_t c, uint8_t d);
+	size_t serialPending();
+	size_t serialTake(uint8_t *buf, size_t size);
+
+	// USB host
+	void usbSetConfigured(bool configured);
+	void usbSetPolling(uint8_t ep, bool polling); // The endpoint is not writable if false
+	void usbSetLeds(uint8_t leds);
+	const Report *usbReports(size_t *count);
+	unsigned long usbReportsTotal();
+	void usbReportsClear();
+
+	// EEPROM and board, see factory.cpp
+	uint8_t *storageData();
+	void storageSetWriteUs(unsigned long us);
+	unsigned long storageWrites();
+	unsigned long boardResets();
+}
@@ -0,0 +1,363 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <HID-Project.h>
+
+#include "host.h"
+
+
+// Прошивка (та же сборка, что у тестов) за псевдотерминалом: kvmd с hid/type=serial
+// и device=<--link> видит обычную Arduino. Виртуальное время прошивки идет вслед
+// за настоящим. Ресет платы (PONG::RESET_REQUIRED и reset_self) - это execv()
+// самого себя с тем же pty, а EEPROM живет в файле из --storage.
+//
+//   hid_pty --link /tmp/kvmd-hid --record /tmp/reports.txt --latency-us 2000 --busy-ms 200/5000
+
+#define _POLL_MS	1
+#define _QUEUE_SIZE	256 // Responses in flight
+
+
+struct _Pending {
+	unsigned long ts; // Real microseconds since the start
+	uint8_t data[8];
+	size_t size;
+};
+
+static volatile sig_atomic_t _stop = 0;
+
+static int _fd = -1;
+static const char *_link_path = NULL;
+static const char *_storage_path = NULL;
+static FILE *_record = NULL;
+static unsigned long _latency_us = 0;
+static double _crc_error_rate = 0;
+static double _drop_rate = 0;
+static double _rx_noise_rate = 0;
+static unsigned long _busy_ms = 0;
+static unsigned long _busy_period_ms = 0;
+
+static _Pending _queue[_QUEUE_SIZE];
+static size_t _queue_head = 0;
+static size_t _queue_count = 0;
+
+static unsigned long _stat_rx = 0;
+static unsigned long _stat_tx = 0;
+static unsigned long _stat_injected = 0;
+
+
+static unsigned long _realUs() {
+	static struct timespec start = {0, 0};
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	if (start.tv_sec == 0 && start.tv_nsec == 0) {
+		start = ts;
+	}
+	return (ts.tv_sec - start.tv_sec) * 1000000UL + (ts.tv_nsec - start.tv_nsec) / 1000;
+}
+
+static bool _chance(double rate) {
+	return (rate > 0 && drand48() < rate);
+}
+
+static void _onSignal(int signum) {
+	(void)signum;
+	_stop = 1;
+}
+
+// -----------------------------------------------------------------------------
+static int _openPty() {
+	const int fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0) {
+		perror("Can't open pty");
+		exit(1);
+	}
+	const char *const path = ptsname(fd);
+	// Raw like the USB CDC or a UART, pyserial will set it again anyway
+	struct termios tio;
+	const int slave_fd = open(path, O_RDWR | O_NOCTTY);
+	if (slave_fd < 0 || tcgetattr(slave_fd, &tio) < 0) {
+		perror("Can't configure pty");
+		exit(1);
+	}
+	cfmakeraw(&tio);
+	tcsetattr(slave_fd, TCSANOW, &tio);
+	// Keep the slave open, otherwise the master gets EIO between the kvmd reconnects
+	(void)slave_fd;
+	return fd;
+}
+
+static void _link(const char *path) {
+	const char *const pts = ptsname(_fd);
+	unlink(path);
+	if (symlink(pts, path) < 0) {
+		perror("Can't create the link");
+		exit(1);
+	}
+	printf("%s -> %s\n", path, pts);
+	fflush(stdout);
+}
+
+static void _loadStorage() {
+	FILE *const fp = fopen(_storage_path, "rb");
+	if (fp != NULL) {
+		if (fread(HOST::storageData(), 1, HOST_STORAGE_SIZE, fp) != HOST_STORAGE_SIZE) {
+			fprintf(stderr, "Short storage file %s, the rest is erased\n", _storage_path);
+		}
+		fclose(fp);
+	}
+}
+
+static void _saveStorage() {
+	FILE *const fp = fopen(_storage_path, "wb");
+	if (fp == NULL || fwrite(HOST::storageData(), 1, HOST_STORAGE_SIZE, fp) != HOST_STORAGE_SIZE) {
+		perror("Can't save the storage");
+	}
+	if (fp != NULL) {
+		fclose(fp);
+	}
+}
+
+// -----------------------------------------------------------------------------
+static void _readInput() {
+	uint8_t buf[256];
+	ssize_t size;
+	while ((size = read(_fd, buf, sizeof(buf))) > 0) {
+		for (ssize_t index = 0; index < size; ++index) {
+			if (_chance(_rx_noise_rate)) {
+				buf[index] ^= 1 << (lrand48() % 8);
+				++_stat_injected;
+			}
+		}
+		HOST::serialFeed(buf, size);
+		_stat_rx += size;
+	}
+}
+
+static void _queueOutput(unsigned long now_us) {
+	uint8_t resp[8];
+	while (HOST::serialPending() >= 8) {
+		HOST::serialTake(resp, 8);
+		if (_chance(_drop_rate)) {
+			++_stat_injected;
+			continue;
+		}
+		if (_chance(_crc_error_rate)) {
+			resp[7] ^= 0xFF;
+			++_stat_injected;
+		}
+		if (_queue_count == _QUEUE_SIZE) {
+			fprintf(stderr, "The response queue is full, dropped\n");
+			continue;
+		}
+		_Pending *const item = &_queue[(_queue_head + _queue_count) % _QUEUE_SIZE];
+		item->ts = now_us + _latency_us;
+		memcpy(item->data, resp, 8);
+		item->size = 8;
+		++_queue_count;
+	}
+}
+
+static void _writeOutput(unsigned long now_us) {
+	while (_queue_count > 0 && _queue[_queue_head].ts <= now_us) {
+		const _Pending *const item = &_queue[_queue_head];
+		if (write(_fd, item->data, item->size) < 0 && errno != EAGAIN) {
+			perror("Can't write to pty");
+		}
+		_stat_tx += item->size;
+		_queue_head = (_queue_head + 1) % _QUEUE_SIZE;
+		--_queue_count;
+	}
+}
+
+static void _updateBusy(unsigned long now_us) {
+	// The host doesn't poll the endpoints: the firmware sees them as offline
+	if (_busy_ms == 0 || _busy_period_ms == 0) {
+		return;
+	}
+	const bool busy = ((now_us / 1000) % _busy_period_ms < _busy_ms);
+	HOST::usbSetPolling(HOST_KEYBOARD_EP, !busy);
+	HOST::usbSetPolling(HOST_MOUSE_EP, !busy);
+}
+
+static void _flushReports() {
+	size_t count;
+	const HOST::Report *const reports = HOST::usbReports(&count);
+	if (_record != NULL) {
+		for (size_t index = 0; index < count; ++index) {
+			fprintf(_record, "%lu %u", reports[index].ts, reports[index].ep);
+			for (uint8_t pos = 0; pos < reports[index].size; ++pos) {
+				fprintf(_record, " %02x", reports[index].data[pos]);
+			}
+			fputc('\n', _record);
+		}
+		fflush(_record);
+	}
+	HOST::usbReportsClear();
+}
+
+// -----------------------------------------------------------------------------
+static void _help() {
+	printf(
+		"Usage: hid_pty [options]\n"
+		"  --link PATH            Symlink to the pty slave for kvmd\n"
+		"  --storage FILE         EEPROM image, kept between the resets\n"
+		"  --record FILE          Append the USB reports: <us> <ep> <bytes...>\n"
+		"  --latency-us N         Hold every response for N microseconds\n"
+		"  --crc-error-rate P     Corrupt the CRC of the response with the probability P\n"
+		"  --drop-rate P          Don't send the response with the probability P\n"
+		"  --rx-noise-rate P      Flip a bit of the received byte with the probability P\n"
+		"  --busy-ms N/PERIOD     The host doesn't poll the endpoints N ms of every PERIOD ms\n"
+		"  --seed N               For the error injection\n"
+	);
+}
+
+int main(int argc, char **argv) {
+	const char *record_path = NULL;
+	long seed = 1;
+
+	const struct option opts[] = {
+		{"link",			required_argument,	NULL, 'l'},
+		{"storage",			required_argument,	NULL, 's'},
+		{"record",			required_argument,	NULL, 'r'},
+		{"latency-us",		required_argument,	NULL, 'L'},
+		{"crc-error-rate",	required_argument,	NULL, 'c'},
+		{"drop-rate",		required_argument,	NULL, 'd'},
+		{"rx-noise-rate",	required_argument,	NULL, 'n'},
+		{"busy-ms",			required_argument,	NULL, 'b'},
+		{"seed",			required_argument,	NULL, 'S'},
+		{"pty-fd",			required_argument,	NULL, 'F'}, // After the reset
+		{"help",			no_argument,		NULL, 'h'},
+		{NULL, 0, NULL, 0},
+	};
+	for (int ch; (ch = getopt_long(argc, argv, "h", opts, NULL)) >= 0;) {
+		switch (ch) {
+			case 'l': _link_path = optarg; break;
+			case 's': _storage_path = optarg; break;
+			case 'r': record_path = optarg; break;
+			case 'L': _latency_us = strtoul(optarg, NULL, 10); break;
+			case 'c': _crc_error_rate = strtod(optarg, NULL); break;
+			case 'd': _drop_rate = strtod(optarg, NULL); break;
+			case 'n': _rx_noise_rate = strtod(optarg, NULL); break;
+			case 'b':
+				if (sscanf(optarg, "%lu/%lu", &_busy_ms, &_busy_period_ms) != 2) {
+					_help();
+					return 1;
+				}
+				break;
+			case 'S': seed = strtol(optarg, NULL, 10); break;
+			case 'F': _fd = atoi(optarg); break;
+			case 'h': _help(); return 0;
+			default: _help(); return 1;
+		}
+	}
+	srand48(seed);
+
+	if (_fd < 0) {
+		_fd = _openPty();
+		if (_link_path != NULL) {
+			_link(_link_path);
+		} else {
+			printf("%s\n", ptsname(_fd));
+			fflush(stdout);
+		}
+	}
+	fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+	if (_storage_path != NULL) {
+		_loadStorage();
+	}
+	if (record_path != NULL && (_record = fopen(record_path, "a")) == NULL) {
+		perror("Can't open the record file");
+		return 1;
+	}
+
+	signal(SIGINT, _onSignal);
+	signal(SIGTERM, _onSignal);
+
+	unsigned long virt_us = 0;
+	while (!_stop) {
+		struct pollfd pfd = {_fd, POLLIN, 0};
+		poll(&pfd, 1, (_queue_count > 0 || HOST::serialPending() > 0 ? 0 : _POLL_MS));
+		const unsigned long now_us = _realUs();
+
+		_readInput();
+		_updateBusy(now_us);
+		if (now_us > virt_us) {
+			HOST::run(now_us - virt_us); // Catch up with the real time
+			virt_us = now_us;
+		}
+		_queueOutput(now_us);
+		_writeOutput(now_us);
+		_flushReports();
+
+		if (HOST::boardResets() > 0) {
+			// The new firmware instance with the same pty, like a real MCU reboot
+			_writeOutput(ULONG_MAX);
+			if (_storage_path != NULL) {
+				_saveStorage();
+			}
+			if (_record != NULL) {
+				fclose(_record);
+			}
+			fprintf(stderr, "Board reset\n");
+			char fd_arg[16];
+			snprintf(fd_arg, sizeof(fd_arg), "%d", _fd);
+			char **const args = (char **)calloc(argc + 3, sizeof(char *));
+			int count = 0;
+			for (int index = 0; index < argc; ++index) {
+				if (!strcmp(argv[index], "--pty-fd")) {
+					++index; // From the previous reset
+				} else {
+					args[count++] = argv[index];
+				}
+			}
+			args[count] = (char *)"--pty-fd";
+			args[count + 1] = fd_arg;
+			execvp(argv[0], args);
+			perror("Can't restart");
+			return 1;
+		}
+	}
+
+	if (_storage_path != NULL) {
+		_saveStorage();
+	}
+	fprintf(stderr, "rx=%lu tx=%lu injected=%lu reports=%lu\n", _stat_rx, _stat_tx, _stat_injected, HOST::usbReportsTotal());
+	if (_link_path != NULL) {
+		unlink(_link_path);
+	}
+	return 0;
+}
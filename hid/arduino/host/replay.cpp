@@ -0,0 +1,212 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <vector>
+
+#include "factory.h"
+#include "journal.h"
+#include "host.h"
+
+
+// Реплей потока кадров для ../../diff/hid_diff.py: на входе строки "<us> <8 байт hex>"
+// со смещением от старта, на выходе USB-отчеты в общем для всех прошивок виде:
+//
+//   <us> kbd <mods> <keys через запятую или ->
+//   <us> abs <buttons> <x> <y> <wheel>
+//   <us> rel <buttons> <dx> <dy> <wheel>
+//
+// Как и kvmd, следующий кадр уходит только после ответа на предыдущий, поэтому кадры
+// с одинаковым временем идут подряд с задержкой на обработку, а не пачкой в UART.
+// Выходы задаются до загрузки через журнал в EEPROM, как если бы их уже выбрали раньше.
+
+#define _STEP_US			1000 // Reports are taken between the steps, so the log never overflows
+#define _RESPONSE_STEP_US	10
+#define _RESPONSE_SIZE		4
+#define _RESPONSE_TIMEOUT_US	100000
+
+
+struct _Frame {
+	unsigned long ts;
+	uint8_t data[8];
+};
+
+static unsigned long _base_ts = 0;
+
+
+static void _help() {
+	printf("Usage: hid_replay [--outputs N] [--boot-us N] [--settle-us N] < frames.txt\n");
+}
+
+static std::vector<_Frame> _readFrames(FILE *file) {
+	std::vector<_Frame> frames;
+	char line[256];
+	for (unsigned number = 1; fgets(line, sizeof(line), file) != NULL; ++number) {
+		if (line[0] == '#' || line[0] == '\n') {
+			continue;
+		}
+		_Frame frame;
+		unsigned values[8];
+		if (sscanf(line, "%lu %2x%2x%2x%2x%2x%2x%2x%2x", &frame.ts,
+			&values[0], &values[1], &values[2], &values[3],
+			&values[4], &values[5], &values[6], &values[7]) != 9
+		) {
+			fprintf(stderr, "Invalid frame on line %u\n", number);
+			exit(1);
+		}
+		for (unsigned index = 0; index < 8; ++index) {
+			frame.data[index] = values[index];
+		}
+		frames.push_back(frame);
+	}
+	return frames;
+}
+
+static void _writeOutputs(uint8_t outputs) {
+	DRIVERS::Storage *const storage = DRIVERS::Factory::makeStorage(DRIVERS::NON_VOLATILE_STORAGE);
+	Journal journal;
+	journal.begin(storage);
+	journal.write(outputs);
+	HOST::storageSetWriteUs(0);
+	while (!journal.isSynced()) {
+		journal.periodic();
+	}
+	HOST::storageSetWriteUs(HOST_STORAGE_WRITE_US);
+	delete storage;
+}
+
+static void _printKeys(uint8_t mods, const uint8_t *keys, size_t size) {
+	printf("kbd %02x ", mods);
+	bool first = true;
+	for (unsigned code = 1; code < 256; ++code) {
+		// Sorted and without the slot order, like the host sees it
+		for (size_t index = 0; index < size; ++index) {
+			if (keys[index] == code) {
+				printf((first ? "%02x" : ",%02x"), code);
+				first = false;
+				break;
+			}
+		}
+	}
+	printf((first ? "-\n" : "\n"));
+}
+
+static void _flush(bool print) {
+	size_t count;
+	const HOST::Report *const reports = HOST::usbReports(&count);
+	for (size_t index = 0; print && index < count; ++index) {
+		const HOST::Report *const report = &reports[index];
+		const uint8_t *const data = report->data;
+		printf("%lu ", report->ts - _base_ts);
+		switch (report->size) {
+			case 4:
+				printf("rel %02x %d %d %d\n", data[0], (int8_t)data[1], (int8_t)data[2], (int8_t)data[3]);
+				break;
+			case 6:
+				printf("abs %02x %u %u %d\n", data[0],
+					(unsigned)(data[1] | (data[2] << 8)), (unsigned)(data[3] | (data[4] << 8)), (int8_t)data[5]);
+				break;
+			case 8:
+				_printKeys(data[0], data + 2, 6);
+				break;
+			default: { // NKRO: mods and the bitmap
+				uint8_t keys[HOST_REPORT_SIZE * 8];
+				size_t keys_count = 0;
+				for (unsigned code = 0; code < (report->size - 1U) * 8; ++code) {
+					if (data[1 + code / 8] & (1 << (code % 8))) {
+						keys[keys_count++] = code;
+					}
+				}
+				_printKeys(data[0], keys, keys_count);
+			}
+		}
+	}
+	HOST::usbReportsClear();
+}
+
+static void _runUntil(unsigned long ts) {
+	while (HOST::now() < ts) {
+		const unsigned long left = ts - HOST::now();
+		HOST::run(left < _STEP_US ? left : _STEP_US);
+		_flush(true);
+	}
+}
+
+static void _waitResponse() {
+	const unsigned long deadline = HOST::now() + _RESPONSE_TIMEOUT_US;
+	size_t received = 0;
+	while (received < _RESPONSE_SIZE && HOST::now() < deadline) {
+		HOST::run(_RESPONSE_STEP_US);
+		uint8_t buf[_RESPONSE_SIZE];
+		received += HOST::serialTake(buf, sizeof(buf)); // Only the fact of the response matters
+		_flush(true);
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+int main(int argc, char **argv) {
+	long outputs = -1;
+	unsigned long boot_us = 100000;
+	unsigned long settle_us = 100000;
+
+	const struct option opts[] = {
+		{"outputs",		required_argument,	NULL, 'o'},
+		{"boot-us",		required_argument,	NULL, 'b'},
+		{"settle-us",	required_argument,	NULL, 's'},
+		{"help",		no_argument,		NULL, 'h'},
+		{NULL, 0, NULL, 0},
+	};
+	for (int ch; (ch = getopt_long(argc, argv, "h", opts, NULL)) >= 0;) {
+		switch (ch) {
+			case 'o': outputs = strtol(optarg, NULL, 0); break;
+			case 'b': boot_us = strtoul(optarg, NULL, 10); break;
+			case 's': settle_us = strtoul(optarg, NULL, 10); break;
+			case 'h': _help(); return 0;
+			default: _help(); return 1;
+		}
+	}
+
+	const std::vector<_Frame> frames = _readFrames(stdin);
+
+	if (outputs >= 0) {
+		_writeOutputs(outputs);
+	}
+	HOST::run(boot_us);
+	_flush(false);
+	uint8_t junk[64];
+	while (HOST::serialTake(junk, sizeof(junk)) > 0);
+	_base_ts = HOST::now();
+
+	for (const _Frame &frame : frames) {
+		_runUntil(_base_ts + frame.ts);
+		HOST::serialFeed(frame.data, 8);
+		_waitResponse();
+	}
+	_runUntil(HOST::now() + settle_us);
+	return 0;
+}
@@ -0,0 +1,358 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <HID-Project.h>
+
+#include "factory.h"
+#include "stats.h"
+#include "proto.h"
+#include "journal.h"
+#include "host.h"
+
+
+#define KEY_A			1 // MCU codes from hid-keymap.h
+#define KEY_B			2
+#define KEY_SHIFT_LEFT	78
+
+#define CHECK(_expr) { \
+		if (!(_expr)) { \
+			fprintf(stderr, "    %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #_expr); \
+			exit(1); \
+		} \
+	}
+
+
+static uint8_t _request(uint8_t cmd, uint8_t a, uint8_t b, uint8_t c, uint8_t d, uint8_t *resp) {
+	HOST::serialFeedFrame(cmd, a, b, c, d);
+	HOST::drain(HOST_LOOP_US);
+	CHECK(HOST::serialTake(resp, 8) == 8);
+	CHECK(resp[0] == PROTO::MAGIC_RESP);
+	CHECK(PROTO::crc16(resp, 6) == PROTO::merge8(resp[6], resp[7]));
+	return resp[1];
+}
+
+static uint8_t _ping(uint8_t *resp) {
+	return _request(PROTO::CMD::PING, 0, 0, 0, 0, resp);
+}
+
+static uint32_t _getStat(uint8_t index) {
+	uint8_t resp[8];
+	CHECK(_request(PROTO::CMD::GET_STATS, index, 0, 0, 0, resp) == PROTO::RESP::STATS);
+	return ((uint32_t)resp[2] << 24) | ((uint32_t)resp[3] << 16) | ((uint32_t)resp[4] << 8) | (uint32_t)resp[5];
+}
+
+static void _start() {
+	HOST::run(100000);
+	HOST::usbReportsClear();
+	uint8_t junk[64];
+	while (HOST::serialTake(junk, sizeof(junk)) > 0);
+}
+
+static void _writeLegacyOutputs(uint8_t outputs) {
+	// The block of the firmwares before the journal
+	uint8_t *const data = HOST::storageData();
+	memset(data, 0, 8);
+	data[0] = PROTO::MAGIC;
+	data[1] = outputs;
+	PROTO::split16(PROTO::crc16(data, 6), &data[6], &data[7]);
+}
+
+static const HOST::Report *_reports(size_t expected) {
+	size_t count;
+	const HOST::Report *const reports = HOST::usbReports(&count);
+	CHECK(count == expected);
+	return reports;
+}
+
+static void _checkKbdReport(const HOST::Report *report, uint8_t mods, uint8_t key0, uint8_t key1) {
+	const uint8_t expected[8] = {mods, 0, key0, key1, 0, 0, 0, 0};
+	CHECK(report->ep == HOST_KEYBOARD_EP);
+	CHECK(report->size == 8);
+	CHECK(!memcmp(report->data, expected, 8));
+}
+
+
+// -----------------------------------------------------------------------------
+static void testPing() {
+	_start();
+	uint8_t resp[8];
+	CHECK(_ping(resp) == PROTO::PONG::OK);
+	CHECK(resp[2] == (PROTO::OUTPUTS1::DYNAMIC | PROTO::OUTPUTS1::KEYBOARD::USB | PROTO::OUTPUTS1::MOUSE::USB_ABS));
+	CHECK(resp[3] == (PROTO::OUTPUTS2::HAS_USB | PROTO::OUTPUTS2::HAS_USB_WIN98 | PROTO::OUTPUTS2::HAS_USB_NKRO));
+	CHECK(_getStat(DRIVERS::STAT_RX_FRAMES) == 2); // With the stats request itself
+}
+
+static void testCrcError() {
+	_start();
+	const uint8_t frame[8] = {PROTO::MAGIC, PROTO::CMD::PING, 0, 0, 0, 0, 0xDE, 0xAD};
+	HOST::serialFeed(frame, 8);
+	HOST::drain(HOST_LOOP_US);
+	uint8_t resp[8];
+	CHECK(HOST::serialTake(resp, 8) == 8);
+	CHECK(resp[1] == PROTO::RESP::CRC_ERROR);
+	CHECK(_getStat(DRIVERS::STAT_CRC_ERRORS) == 1);
+}
+
+static void testInvalidCommand() {
+	_start();
+	uint8_t resp[8];
+	CHECK(_request(0x7F, 0, 0, 0, 0, resp) == PROTO::RESP::INVALID_ERROR);
+	CHECK(_request(PROTO::CMD::REPEAT, 0, 0, 0, 0, resp) == PROTO::RESP::INVALID_ERROR);
+	CHECK(_getStat(DRIVERS::STAT_INVALID_COMMANDS) == 1);
+}
+
+static void testTimeout() {
+	_start();
+	const uint8_t part[3] = {PROTO::MAGIC, PROTO::CMD::PING, 0};
+	HOST::serialFeed(part, 3);
+	HOST::run(90000);
+	CHECK(HOST::serialPending() == 0);
+	HOST::run(20000); // CMD_SERIAL_TIMEOUT
+	uint8_t resp[8];
+	CHECK(HOST::serialTake(resp, 8) == 8);
+	CHECK(resp[1] == PROTO::RESP::TIMEOUT_ERROR);
+	CHECK(_ping(resp) == PROTO::PONG::OK); // The next frame is aligned again
+	CHECK(_getStat(DRIVERS::STAT_RX_TIMEOUTS) == 1);
+}
+
+static void testUsbKey() {
+	_start();
+	uint8_t resp[8];
+	_request(PROTO::CMD::KEYBOARD::KEY, KEY_SHIFT_LEFT, 1, 0, 0, resp);
+	_request(PROTO::CMD::KEYBOARD::KEY, KEY_A, 1, 0, 0, resp);
+	_request(PROTO::CMD::KEYBOARD::KEY, KEY_A, 0, 0, 0, resp);
+	_request(PROTO::CMD::KEYBOARD::KEY, KEY_SHIFT_LEFT, 0, 0, 0, resp);
+	const HOST::Report *const reports = _reports(4);
+	_checkKbdReport(&reports[0], 0x02, 0, 0);
+	_checkKbdReport(&reports[1], 0x02, 0x04, 0);
+	_checkKbdReport(&reports[2], 0x02, 0, 0);
+	_checkKbdReport(&reports[3], 0, 0, 0);
+}
+
+static void testUsbKey6kro() {
+	_start();
+	uint8_t resp[8];
+	for (uint8_t key = KEY_A; key < KEY_A + 7; ++key) {
+		_request(PROTO::CMD::KEYBOARD::KEY, key, 1, 0, 0, resp);
+	}
+	const HOST::Report *const reports = _reports(6); // The 7th key doesn't fit
+	CHECK(!memcmp(reports[5].data + 2, "\x04\x05\x06\x07\x08\x09", 6));
+	_request(PROTO::CMD::CLEAR_HID, 0, 0, 0, 0, resp);
+	_checkKbdReport(&_reports(8)[6], 0, 0, 0); // And the mouse
+}
+
+static void testUsbLeds() {
+	_start();
+	HOST::usbSetLeds(LED_CAPS_LOCK | LED_NUM_LOCK);
+	uint8_t resp[8];
+	CHECK(_ping(resp) == (PROTO::PONG::OK | PROTO::PONG::CAPS | PROTO::PONG::NUM));
+}
+
+static void testUsbKbdOffline() {
+	_start();
+	HOST::usbSetPolling(HOST_KEYBOARD_EP, false);
+	uint8_t resp[8];
+	CHECK(_ping(resp) == PROTO::PONG::OK); // The endpoint is probed only before sending
+	_request(PROTO::CMD::KEYBOARD::KEY, KEY_B, 1, 0, 0, resp);
+	_reports(0);
+	CHECK(_ping(resp) == (PROTO::PONG::OK | PROTO::PONG::KEYBOARD_OFFLINE));
+	CHECK(_getStat(DRIVERS::STAT_REPORT_FAILURES) == 1);
+
+	// The pressed key is not lost
+	HOST::usbSetPolling(HOST_KEYBOARD_EP, true);
+	HOST::run(100000);
+	CHECK(_ping(resp) == PROTO::PONG::OK);
+	_checkKbdReport(&_reports(1)[0], 0, 0x05, 0);
+}
+
+static void testUsbMouseOffline() {
+	_start();
+	HOST::usbSetPolling(HOST_MOUSE_EP, false);
+	uint8_t resp[8];
+	CHECK(_ping(resp) == PROTO::PONG::OK); // The cached flag is stale until the next send
+	_request(PROTO::CMD::MOUSE::MOVE, 0, 0, 0, 0, resp);
+	_reports(0);
+	CHECK(_getStat(DRIVERS::STAT_REPORT_FAILURES) == 1); // Dropped by the probe, without USB_Send()
+	CHECK(_ping(resp) == (PROTO::PONG::OK | PROTO::PONG::MOUSE_OFFLINE));
+
+	HOST::usbSetPolling(HOST_MOUSE_EP, true);
+	HOST::run(60000);
+	CHECK(_ping(resp) == PROTO::PONG::OK);
+	_request(PROTO::CMD::MOUSE::MOVE, 0, 0, 0, 0, resp);
+	HOST::run(2000);
+	_reports(1);
+}
+
+static void testUsbMouseAbs() {
+	_start();
+	uint8_t resp[8];
+	_request(PROTO::CMD::MOUSE::MOVE, 0x80, 0x00, 0x7F, 0xFF, resp); // -32768, 32767
+	_request(PROTO::CMD::MOUSE::BUTTON, PROTO::CMD::MOUSE::LEFT::SELECT | PROTO::CMD::MOUSE::LEFT::STATE, 0, 0, 0, resp);
+	_request(PROTO::CMD::MOUSE::WHEEL, 0, (uint8_t)-1, 0, 0, resp);
+	const HOST::Report *const reports = _reports(3);
+	CHECK(reports[0].ep == HOST_MOUSE_EP);
+	CHECK(!memcmp(reports[0].data, "\x00\x00\x00\xFF\x7F\x00", 6));
+	CHECK(!memcmp(reports[1].data, "\x01\x00\x00\xFF\x7F\x00", 6));
+	CHECK(!memcmp(reports[2].data, "\x01\x00\x00\xFF\x7F\xFF", 6));
+}
+
+static void testUsbMouseWin98() {
+	_writeLegacyOutputs(PROTO::OUTPUTS1::KEYBOARD::USB | PROTO::OUTPUTS1::MOUSE::USB_WIN98);
+	_start();
+	uint8_t resp[8];
+	CHECK(_ping(resp) == PROTO::PONG::OK);
+	CHECK((resp[2] & PROTO::OUTPUTS1::MOUSE::MASK) == PROTO::OUTPUTS1::MOUSE::USB_WIN98);
+	_request(PROTO::CMD::MOUSE::MOVE, 0, 0, 0, 0, resp);
+	CHECK(!memcmp(_reports(1)[0].data, "\x00\x00\x80\x00\x80\x00", 6)); // 0x4000 << 1
+}
+
+static void testSetMouseRequiresReset() {
+	_start();
+	uint8_t resp[8];
+	_request(PROTO::CMD::SET_MOUSE, PROTO::OUTPUTS1::MOUSE::USB_REL, 0, 0, 0, resp);
+	CHECK(_ping(resp) == (PROTO::PONG::OK | PROTO::PONG::RESET_REQUIRED));
+	CHECK((resp[2] & PROTO::OUTPUTS1::MOUSE::MASK) == PROTO::OUTPUTS1::MOUSE::USB_ABS); // Until the reset
+	CHECK(HOST::boardResets() == 0);
+	CHECK(_getStat(DRIVERS::STAT_RESET_REQUESTS) == 1);
+
+	HOST::run(600000); // RESET_TIMEOUT and the journal
+	_ping(resp);
+	CHECK(HOST::boardResets() == 1);
+
+	// The next boot will see it
+	DRIVERS::Storage *const storage = DRIVERS::Factory::makeStorage(DRIVERS::NON_VOLATILE_STORAGE);
+	Journal journal;
+	journal.begin(storage);
+	CHECK(journal.read() == (PROTO::OUTPUTS1::KEYBOARD::USB | PROTO::OUTPUTS1::MOUSE::USB_REL));
+	delete storage;
+}
+
+static void testUsbMouseRel() {
+	_writeLegacyOutputs(PROTO::OUTPUTS1::KEYBOARD::USB_NKRO | PROTO::OUTPUTS1::MOUSE::USB_REL);
+	_start();
+	uint8_t resp[8];
+	CHECK(_ping(resp) == PROTO::PONG::OK);
+	CHECK(resp[2] == (PROTO::OUTPUTS1::DYNAMIC | PROTO::OUTPUTS1::KEYBOARD::USB_NKRO | PROTO::OUTPUTS1::MOUSE::USB_REL));
+	_request(PROTO::CMD::MOUSE::RELATIVE, 5, (uint8_t)-3, 0, 0, resp);
+	_request(PROTO::CMD::KEYBOARD::KEY, KEY_A, 1, 0, 0, resp);
+	const HOST::Report *const reports = _reports(2);
+	CHECK(reports[0].ep == HOST_MOUSE_EP);
+	CHECK(!memcmp(reports[0].data, "\x00\x05\xFD\x00", 4));
+	CHECK(reports[1].ep == HOST_KEYBOARD_EP);
+	CHECK(reports[1].size == 17);
+	CHECK(reports[1].data[1] == 0x10); // Usage 0x04 in the bitmap
+}
+
+static void testJournalWear() {
+	_start();
+	uint8_t resp[8];
+	for (unsigned count = 0; count < 40; ++count) {
+		const uint8_t mouse = (count & 1 ? PROTO::OUTPUTS1::MOUSE::USB_ABS : PROTO::OUTPUTS1::MOUSE::USB_REL);
+		_request(PROTO::CMD::SET_MOUSE, mouse, 0, 0, 0, resp);
+		HOST::run(20000); // 4 bytes, ~3.4ms each
+	}
+	// Every change goes to the next slot of 32, the legacy block is untouched
+	const uint8_t *const data = HOST::storageData();
+	for (unsigned index = 0; index < 8; ++index) {
+		CHECK(data[index] == 0xFF);
+	}
+	for (unsigned index = 8; index < 8 + 32 * 4; ++index) {
+		CHECK(data[index] != 0xFF || index % 4 == 1); // The value may be 0xFF, the seq and crc are unlikely to
+	}
+	CHECK(HOST::storageWrites() <= 40 * 4 + 4); // Plus the initial outputs
+}
+
+static void testJournalMigratesLegacy() {
+	_writeLegacyOutputs(PROTO::OUTPUTS1::KEYBOARD::USB | PROTO::OUTPUTS1::MOUSE::USB_REL);
+	_start();
+	HOST::run(20000); // 4 bytes, ~3.4ms each
+	memset(HOST::storageData(), 0xFF, 8); // Without the legacy block the journal has it anyway
+	DRIVERS::Storage *const storage = DRIVERS::Factory::makeStorage(DRIVERS::NON_VOLATILE_STORAGE);
+	Journal journal;
+	journal.begin(storage);
+	CHECK(journal.read() == (PROTO::OUTPUTS1::KEYBOARD::USB | PROTO::OUTPUTS1::MOUSE::USB_REL));
+	delete storage;
+}
+
+static void testRecorder() {
+	_start();
+	uint8_t resp[8];
+	_request(PROTO::CMD::KEYBOARD::KEY, KEY_A, 1, 0, 0, resp);
+	CHECK(_request(PROTO::CMD::GET_RECORD, 0, 0, 1, 0, resp) == PROTO::RESP::RECORD);
+	CHECK(resp[2] == DRIVERS::REC_BOOT);
+	CHECK(_request(PROTO::CMD::GET_RECORD, 0, 0, 3, 0, resp) == PROTO::RESP::RECORD);
+	CHECK(PROTO::merge8(resp[2], resp[3]) >= 3); // Boot, the first PONG and the key
+}
+
+
+// -----------------------------------------------------------------------------
+int main() {
+	// Каждый тест в своем процессе: у прошивки статическое состояние и один setup()
+#	define TEST(_name) {#_name, _name}
+	const struct {
+		const char *name;
+		void (*func)();
+	} tests[] = {
+		TEST(testPing),
+		TEST(testCrcError),
+		TEST(testInvalidCommand),
+		TEST(testTimeout),
+		TEST(testUsbKey),
+		TEST(testUsbKey6kro),
+		TEST(testUsbLeds),
+		TEST(testUsbKbdOffline),
+		TEST(testUsbMouseOffline),
+		TEST(testUsbMouseAbs),
+		TEST(testUsbMouseWin98),
+		TEST(testSetMouseRequiresReset),
+		TEST(testUsbMouseRel),
+		TEST(testJournalWear),
+		TEST(testJournalMigratesLegacy),
+		TEST(testRecorder),
+	};
+#	undef TEST
+
+	unsigned failed = 0;
+	for (size_t index = 0; index < sizeof(tests) / sizeof(tests[0]); ++index) {
+		fflush(stdout);
+		const pid_t pid = fork();
+		if (pid == 0) {
+			tests[index].func();
+			exit(0);
+		}
+		int status = 0;
+		waitpid(pid, &status, 0);
+		const bool ok = (WIFEXITED(status) && WEXITSTATUS(status) == 0);
+		printf("%s %s\n", (ok ? "ok  " : "FAIL"), tests[index].name);
+		failed += !ok;
+	}
+	printf("%u failed\n", failed);
+	return (failed > 0);
+}
@@ -0,0 +1,116 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#include <USBComposite.h>
+
+
+USBCompositeDevice USBComposite;
+
+
+// -----------------------------------------------------------------------------
+size_t HIDKeyboard::press(uint8_t key) {
+	// Like the Arduino Keyboard library the original is derived from:
+	// the report is not sent if there is no free slot
+	if (key >= KEY_HID_OFFSET) {
+		key -= KEY_HID_OFFSET;
+	} else if (key >= 0x80) {
+		_report.mods |= (1 << (key - 0x80));
+		key = 0;
+	}
+	uint8_t index = 0;
+	for (; index < 6 && _report.keys[index] != key; ++index);
+	if (index == 6) {
+		for (index = 0; index < 6 && _report.keys[index] != 0; ++index);
+		if (index == 6) {
+			return 0;
+		}
+		_report.keys[index] = key;
+	}
+	_sendReport();
+	return 1;
+}
+
+size_t HIDKeyboard::release(uint8_t key) {
+	if (key >= KEY_HID_OFFSET) {
+		key -= KEY_HID_OFFSET;
+	} else if (key >= 0x80) {
+		_report.mods &= ~(1 << (key - 0x80));
+		key = 0;
+	}
+	for (uint8_t index = 0; index < 6; ++index) {
+		if (key != 0 && _report.keys[index] == key) {
+			_report.keys[index] = 0;
+		}
+	}
+	_sendReport();
+	return 1;
+}
+
+void HIDKeyboard::releaseAll() {
+	memset(&_report, 0, sizeof(_report));
+	_sendReport();
+}
+
+void HIDKeyboard::_sendReport() {
+	hostSendReport(HOST_KEYBOARD_EP, &_report, sizeof(_report));
+}
+
+
+// -----------------------------------------------------------------------------
+void HIDAbsMouse::move(int16 x, int16 y, int8 wheel) {
+	_x = x;
+	_y = y;
+	_wheel = wheel;
+	_sendReport();
+}
+
+void HIDAbsMouse::_setButtons(uint8_t buttons) {
+	if (_buttons != buttons) {
+		_buttons = buttons;
+		_wheel = 0;
+		_sendReport();
+	}
+}
+
+void HIDAbsMouse::_sendReport() {
+	const uint8_t report[6] = {
+		_buttons,
+		(uint8_t)(_x & 0xFF), (uint8_t)((uint16_t)_x >> 8),
+		(uint8_t)(_y & 0xFF), (uint8_t)((uint16_t)_y >> 8),
+		(uint8_t)_wheel,
+	};
+	hostSendReport(HOST_MOUSE_EP, report, sizeof(report));
+}
+
+
+// -----------------------------------------------------------------------------
+void HIDMouse::move(int8 x, int8 y, int8 wheel) {
+	const uint8_t report[4] = {_buttons, (uint8_t)x, (uint8_t)y, (uint8_t)wheel};
+	hostSendReport(HOST_MOUSE_EP, report, sizeof(report));
+}
+
+void HIDMouse::_setButtons(uint8_t buttons) {
+	if (_buttons != buttons) {
+		_buttons = buttons;
+		move(0, 0, 0);
+	}
+}
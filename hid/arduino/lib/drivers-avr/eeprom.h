@@ -36,5 +36,17 @@ namespace DRIVERS {
 		void updateBlock(const void *src, void *dest, size_t size) override {
 			eeprom_update_block(src, dest, size);
 		}
+
+		size_t getSize() override {
+			return E2END + 1;
+		}
+
+		bool isReady() override {
+			return eeprom_is_ready();
+		}
+
+		bool hasWriteLatency() override {
+			return true;
+		}
 	};
 }
@@ -40,6 +40,11 @@ namespace DRIVERS {
 				return new UsbKeyboard();
 #			endif
 
+#			if defined(HID_WITH_USB) && defined(HID_WITH_USB_NKRO)
+			case USB_KEYBOARD_NKRO:
+				return new UsbKeyboardNkro();
+#			endif
+
 #			ifdef HID_WITH_PS2
 			case PS2_KEYBOARD:
 				return new Ps2Keyboard();
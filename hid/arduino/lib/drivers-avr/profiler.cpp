@@ -0,0 +1,57 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#include "profiler.h"
+
+#ifdef HID_PROFILE
+
+#include <Arduino.h>
+
+#ifndef TCNT1
+#	error "Profiler requires Timer1"
+#endif
+
+
+// Timer1 is free: the PS/2 device uses Timer3 and Arduino core doesn't touch it
+// without analogWrite() on pins 9-11. 16 bits at clk/64 is 4us per tick
+// at 16MHz and ~262ms before the wrap, which is more than any sane iteration.
+#define _PRESCALER 64
+
+
+namespace DRIVERS {
+	void profilerBegin() {
+		TCCR1A = 0;
+		TCCR1B = (1 << CS11) | (1 << CS10); // Normal mode, clk/64
+		TCNT1 = 0;
+	}
+
+	uint32_t profilerNow() {
+		return TCNT1; // 16-bit read is atomic with TEMP register, interrupts don't touch Timer1
+	}
+
+	uint32_t profilerElapsedUs(uint32_t start) {
+		const uint16_t ticks = (uint16_t)TCNT1 - (uint16_t)start;
+		return (uint32_t)ticks * _PRESCALER / (F_CPU / 1000000);
+	}
+}
+
+#endif
@@ -0,0 +1,343 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#include "dev.h"
+
+#ifdef HID_WITH_PS2
+
+#include <Arduino.h>
+#include <util/atomic.h>
+#include <digitalWriteFast.h>
+
+#include "stats.h"
+
+#ifndef TIMSK3
+#	error "PS/2 requires Timer3"
+#endif
+
+
+// Один тик - четверть периода clock: 80us, ~12.5kHz
+#define _TICK_US	20
+#define _GAP_TICKS	5
+#define _QUEUE_SIZE	64
+#define _REPLY_SIZE	4
+
+#define _CLOCK_LOW		{ digitalWriteFast(HID_PS2_KBD_CLOCK_PIN, LOW); pinModeFast(HID_PS2_KBD_CLOCK_PIN, OUTPUT); }
+#define _CLOCK_RELEASE	{ pinModeFast(HID_PS2_KBD_CLOCK_PIN, INPUT); digitalWriteFast(HID_PS2_KBD_CLOCK_PIN, HIGH); }
+#define _DATA_LOW		{ digitalWriteFast(HID_PS2_KBD_DATA_PIN, LOW); pinModeFast(HID_PS2_KBD_DATA_PIN, OUTPUT); }
+#define _DATA_RELEASE	{ pinModeFast(HID_PS2_KBD_DATA_PIN, INPUT); digitalWriteFast(HID_PS2_KBD_DATA_PIN, HIGH); }
+#define _CLOCK_IS_HIGH	digitalReadFast(HID_PS2_KBD_CLOCK_PIN)
+#define _DATA_IS_HIGH	digitalReadFast(HID_PS2_KBD_DATA_PIN)
+
+#define _TIMER_START	{ TCNT3 = 0; TIFR3 = (1 << OCF3A); TIMSK3 |= (1 << OCIE3A); }
+#define _TIMER_STOP		{ TIMSK3 &= ~(1 << OCIE3A); }
+
+enum _State : uint8_t {
+	_STATE_IDLE = 0, // Таймер остановлен, линии смотрит periodic()
+	_STATE_GAP,
+	_STATE_TX,
+	_STATE_RX,
+	_STATE_ACK,
+};
+
+static volatile uint8_t _state = _STATE_IDLE;
+static volatile uint8_t _phase = 0;
+static volatile uint8_t _bit = 0;
+static volatile uint16_t _frame = 0;
+
+static volatile uint8_t _queue[_QUEUE_SIZE];
+static volatile uint8_t _queue_head = 0;
+static volatile uint8_t _queue_count = 0;
+
+static volatile uint8_t _replies[_REPLY_SIZE];
+static volatile uint8_t _replies_head = 0;
+static volatile uint8_t _replies_count = 0;
+
+static volatile bool _tx_is_reply = false;
+static volatile bool _tx_drop = false; // The source was cleared during the transmission
+static volatile uint8_t _last_tx = 0;
+
+static volatile uint8_t _rx_data = 0;
+static volatile uint8_t _rx_status = 0; // 0 - nothing, 1 - ok, 2 - error
+
+
+static bool _loadNext() {
+	uint8_t data;
+	if (_replies_count > 0) {
+		data = _replies[_replies_head];
+		_tx_is_reply = true;
+	} else if (_queue_count > 0) {
+		data = _queue[_queue_head];
+		_tx_is_reply = false;
+	} else {
+		return false;
+	}
+	_tx_drop = false;
+	// Start, data LSB first, odd parity, stop
+	_frame = ((uint16_t)1 << 10) | ((uint16_t)!__builtin_parity(data) << 9) | ((uint16_t)data << 1);
+	return true;
+}
+
+static void _commitTx() {
+	const uint8_t data = (_frame >> 1) & 0xFF;
+	_last_tx = data;
+	if (!_tx_drop) {
+		if (_tx_is_reply) {
+			_replies_head = (_replies_head + 1) % _REPLY_SIZE;
+			--_replies_count;
+		} else {
+			_queue_head = (_queue_head + 1) % _QUEUE_SIZE;
+			--_queue_count;
+		}
+	}
+}
+
+static void _commitRx() {
+	const uint8_t data = (_frame & 0xFF);
+	const bool parity = (_frame >> 8) & 1;
+	const bool stop = (_frame >> 9) & 1;
+	_rx_data = data;
+	_rx_status = (stop && parity != (bool)__builtin_parity(data) ? 1 : 2);
+}
+
+static void _goIdle() {
+	_CLOCK_RELEASE;
+	_DATA_RELEASE;
+	_state = _STATE_IDLE;
+	_TIMER_STOP;
+}
+
+static void _goGap() {
+	_state = _STATE_GAP;
+	_phase = 0;
+}
+
+static void _goRx() {
+	_state = _STATE_RX;
+	_phase = 0;
+	_bit = 0;
+	_frame = 0;
+}
+
+
+void Ps2Dev::begin() {
+	_goIdle();
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		_queue_count = 0;
+		_replies_count = 0;
+		_rx_status = 0;
+	}
+	TCCR3A = 0;
+	TCCR3B = (1 << WGM32) | (1 << CS31); // CTC, clk/8
+	OCR3A = (F_CPU / 8 / 1000000) * _TICK_US - 1;
+}
+
+void Ps2Dev::end() {
+	_goIdle();
+	TCCR3B = 0;
+}
+
+void Ps2Dev::periodic() {
+	if (_state != _STATE_IDLE) {
+		_inhibited = false;
+		return;
+	}
+	if (!_CLOCK_IS_HIGH) {
+		// Host RTS тоже начинается с clock low, так что само по себе это еще не inhibit:
+		// считаем его, только если он задержал передачу или закончился без RTS
+		if (!_inhibited) {
+			_inhibited = true;
+			_inhibit_counted = false;
+			_inhibit_ts = millis();
+		}
+		if (!_inhibit_counted && (_replies_count > 0 || _queue_count > 0)) {
+			DRIVERS::statsInc(DRIVERS::STAT_PS2_INHIBITS);
+			_inhibit_counted = true;
+		}
+		return;
+	}
+	if (_inhibited) {
+		_inhibited = false;
+		if (!_inhibit_counted && _DATA_IS_HIGH) {
+			DRIVERS::statsInc(DRIVERS::STAT_PS2_INHIBITS);
+		}
+	}
+	if (!_DATA_IS_HIGH) { // Request-to-send от хоста
+		_goRx();
+		_TIMER_START;
+	} else if (_replies_count > 0 || _queue_count > 0) {
+		_goGap();
+		_TIMER_START;
+	}
+}
+
+bool Ps2Dev::write(const uint8_t *data, uint8_t size) {
+	bool ok = false;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (_QUEUE_SIZE - _queue_count >= size) {
+			for (uint8_t index = 0; index < size; ++index) {
+				_queue[(_queue_head + _queue_count) % _QUEUE_SIZE] = data[index];
+				++_queue_count;
+			}
+			ok = true;
+		}
+	}
+	return ok;
+}
+
+void Ps2Dev::reply(const uint8_t *data, uint8_t size) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (_state == _STATE_TX && _tx_is_reply) {
+			_tx_drop = true;
+		}
+		_replies_head = 0;
+		_replies_count = 0;
+		for (; _replies_count < size && _replies_count < _REPLY_SIZE; ++_replies_count) {
+			_replies[_replies_count] = data[_replies_count];
+		}
+	}
+}
+
+void Ps2Dev::resend() {
+	const uint8_t data = _last_tx;
+	reply(&data, 1);
+}
+
+void Ps2Dev::clear() {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (_state == _STATE_TX && !_tx_is_reply) {
+			_tx_drop = true;
+		}
+		_queue_count = 0;
+	}
+}
+
+bool Ps2Dev::read(uint8_t *data, bool *ok) {
+	bool has = false;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (_rx_status != 0) {
+			*data = _rx_data;
+			*ok = (_rx_status == 1);
+			_rx_status = 0;
+			has = true;
+		}
+	}
+	return has;
+}
+
+uint8_t Ps2Dev::getQueued() {
+	return _queue_count;
+}
+
+uint8_t Ps2Dev::getInhibitTime() {
+	if (!_inhibited) {
+		return 0;
+	}
+	const unsigned long time = (millis() - _inhibit_ts) / 10;
+	return (time > 255 ? 255 : time);
+}
+
+
+ISR(TIMER3_COMPA_vect) {
+	switch (_state) {
+		case _STATE_GAP:
+			if (!_CLOCK_IS_HIGH) {
+				_goIdle(); // Inhibit, periodic() подождет, пока хост отпустит clock
+			} else if (!_DATA_IS_HIGH) {
+				_goRx();
+			} else if (++_phase >= _GAP_TICKS) {
+				if (_loadNext()) {
+					_state = _STATE_TX;
+					_phase = 0;
+					_bit = 0;
+				} else {
+					_goIdle();
+				}
+			}
+			break;
+
+		case _STATE_TX:
+			switch (_phase) {
+				case 0:
+					if (!_CLOCK_IS_HIGH) {
+						_goIdle(); // Байт остался в очереди и уйдет заново
+						return;
+					}
+					if ((_frame >> _bit) & 1) {
+						_DATA_RELEASE;
+					} else {
+						_DATA_LOW;
+					}
+					break;
+				case 1: _CLOCK_LOW; break;
+				case 3:
+					_CLOCK_RELEASE;
+					if (++_bit == 11) {
+						_commitTx();
+						_goGap();
+						return;
+					}
+					break;
+			}
+			_phase = (_phase + 1) & 3;
+			break;
+
+		case _STATE_RX:
+			switch (_phase) {
+				case 0: _CLOCK_LOW; break;
+				case 2: _CLOCK_RELEASE; break;
+				case 3:
+					if (!_CLOCK_IS_HIGH) {
+						_goIdle(); // Хост передумал
+						return;
+					}
+					// 8 data bits, parity, stop
+					_frame |= (uint16_t)_DATA_IS_HIGH << _bit;
+					if (++_bit == 10) {
+						_state = _STATE_ACK;
+					}
+					break;
+			}
+			_phase = (_phase + 1) & 3;
+			break;
+
+		case _STATE_ACK:
+			switch (_phase) {
+				case 0: _DATA_LOW; break;
+				case 1: _CLOCK_LOW; break;
+				case 3:
+					_CLOCK_RELEASE;
+					_DATA_RELEASE;
+					_commitRx();
+					_goGap();
+					return;
+			}
+			_phase = (_phase + 1) & 3;
+			break;
+
+		default:
+			_goIdle();
+			break;
+	}
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#pragma once
+
+#include <stdint.h>
+
+// #define HID_PS2_KBD_CLOCK_PIN	7
+// #define HID_PS2_KBD_DATA_PIN		5
+
+
+class Ps2Dev {
+	// https://www.burtonsys.com/ps2_chapweske.htm
+	// Линии дергает прерывание Timer3, а main loop только кладет байты в очередь
+	// и разбирает команды хоста. Если хост прижал clock посреди байта,
+	// передача обрывается и байт уходит заново, когда линию отпустят.
+
+	public:
+		void begin();
+		void end();
+		void periodic();
+
+		/**
+		* Queues a whole scancode sequence or nothing if it doesn't fit
+		*/
+		bool write(const uint8_t *data, uint8_t size);
+
+		/**
+		* Replaces pending replies, they are sent before the scancodes
+		*/
+		void reply(const uint8_t *data, uint8_t size);
+		void resend();
+		void clear();
+
+		/**
+		* Returns false if the host sent nothing, ok is false on parity/framing errors
+		*/
+		bool read(uint8_t *data, bool *ok);
+
+		uint8_t getQueued();
+
+		/**
+		* How long the host holds the clock line low right now, in 10ms units
+		*/
+		uint8_t getInhibitTime();
+
+	private:
+		bool _inhibited = false;
+		bool _inhibit_counted = false;
+		unsigned long _inhibit_ts = 0;
+};
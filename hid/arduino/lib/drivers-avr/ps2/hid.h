@@ -23,53 +23,78 @@
 #pragma once
 
 #include <Arduino.h>
-#include <ps2dev.h>
 
 #include "keyboard.h"
+#include "tools.h"
+#include "stats.h"
+#include "trace.h"
 #include "keymap.h"
-
-// #define HID_PS2_KBD_CLOCK_PIN	7
-// #define HID_PS2_KBD_DATA_PIN		5
+#include "dev.h"
 
 
 class Ps2Keyboard : public DRIVERS::Keyboard {
 	// https://wiki.osdev.org/PS/2_Keyboard
 
 	public:
-		Ps2Keyboard() : DRIVERS::Keyboard(DRIVERS::PS2_KEYBOARD), _dev(HID_PS2_KBD_CLOCK_PIN, HID_PS2_KBD_DATA_PIN) {}
+		Ps2Keyboard() : DRIVERS::Keyboard(DRIVERS::PS2_KEYBOARD) {}
+
+		~Ps2Keyboard() {
+			_dev.end();
+		}
 
 		void begin() override {
-			_dev.keyboard_init();
+			_dev.begin();
+			_setDefaults();
+			const uint8_t bat = 0xAA;
+			_dev.reply(&bat, 1);
 		}
 
 		void periodic() override {
-			_dev.keyboard_handle(&_leds);
+			_dev.periodic();
+			uint8_t cmd;
+			bool ok;
+			while (_dev.read(&cmd, &ok)) {
+				_handleCommand(cmd, ok);
+			}
+			_flushBreaks();
+			_periodicRepeat();
+		}
+
+		void clear() override {
+			_repeat_code = 0;
 		}
 
 		void sendKey(uint8_t code, bool state) override {
-			Ps2KeyType ps2_type;
-			uint8_t ps2_code;
-
-			keymapPs2(code, &ps2_type, &ps2_code);
-			if (ps2_type != PS2_KEY_TYPE_UNKNOWN) {
-				// Не отправлялась часть нажатий. Когда clock на нуле, комп не принимает ничего от клавы.
-				// Этот костыль понижает процент пропущенных нажатий.
-				while (digitalRead(HID_PS2_KBD_CLOCK_PIN) == 0) {};
-				if (state) {
-					switch (ps2_type) {
-						case PS2_KEY_TYPE_REG: _dev.keyboard_press(ps2_code); break;
-						case PS2_KEY_TYPE_SPEC: _dev.keyboard_press_special(ps2_code); break;
-						case PS2_KEY_TYPE_PRINT: _dev.keyboard_press_printscreen(); break;
-						case PS2_KEY_TYPE_PAUSE: _dev.keyboard_pausebreak(); break;
-						case PS2_KEY_TYPE_UNKNOWN: break;
+			const Ps2KeyType ps2_type = keymapPs2Type(code);
+			if (ps2_type == PS2_KEY_TYPE_UNKNOWN || !_enabled) {
+				return;
+			}
+
+			if (!state && code == _repeat_code) {
+				_repeat_code = 0;
+			}
+
+			// Отпускание не теряется: если очередь полна, оно ждет в битмапе и уходит
+			// из periodic(), а новые нажатия не обгоняют его, пока битмап не опустеет
+			const bool flushed = _flushBreaks();
+			uint8_t seq[HID_KEYMAP_PS2_MAKE_MAX];
+			const uint8_t size = keymapPs2Sequence(code, state, seq);
+			if (size > 0) {
+				if ((flushed || !state) && _dev.write(seq, size)) {
+					DRIVERS::traceSubmitted(); // Queued, Timer3 starts sending after the gap unless the host inhibits
+					_setBreakPending(code, false);
+					if (state) {
+						// Как настоящая клавиатура: повторяется последняя нажатая клавиша,
+						// пока ее не отпустят, с задержкой и частотой из команды 0xF3.
+						// Потерянное нажатие не повторяем, иначе хост получил бы make без break.
+						_repeat_code = ((ps2_type == PS2_KEY_TYPE_REG || ps2_type == PS2_KEY_TYPE_SPEC) ? code : 0);
+						_repeat_ts = micros();
+						_repeat_delayed = false;
 					}
 				} else {
-					switch (ps2_type) {
-						case PS2_KEY_TYPE_REG: _dev.keyboard_release(ps2_code); break;
-						case PS2_KEY_TYPE_SPEC: _dev.keyboard_release_special(ps2_code); break;
-						case PS2_KEY_TYPE_PRINT: _dev.keyboard_release_printscreen(); break;
-						case PS2_KEY_TYPE_PAUSE: break;
-						case PS2_KEY_TYPE_UNKNOWN: break;
+					DRIVERS::statsInc(DRIVERS::STAT_REPORT_FAILURES);
+					if (!state) {
+						_setBreakPending(code, true);
 					}
 				}
 			}
@@ -80,7 +105,6 @@ class Ps2Keyboard : public DRIVERS::Keyboard {
 		}
 
 		KeyboardLedsState getLeds() override {
-			periodic();
 			KeyboardLedsState result = {
 				.caps = _leds & 0b00000100,
 				.scroll = _leds & 0b00000001,
@@ -89,7 +113,144 @@ class Ps2Keyboard : public DRIVERS::Keyboard {
 			return result;
 		}
 
+		uint8_t getQueueDepth() override {
+			return _dev.getQueued();
+		}
+
+		uint8_t getInhibitTime() override {
+			return _dev.getInhibitTime();
+		}
+
 	private:
-		PS2dev _dev;
+		bool _flushBreaks() {
+			// Returns true if no breaks are pending
+			if (!_breaks_pending) {
+				return true;
+			}
+			for (uint8_t code = 0; code < HID_KEYMAP_SIZE; ++code) {
+				if (_pending_breaks[code / 8] & (1 << (code % 8))) {
+					uint8_t seq[HID_KEYMAP_PS2_MAKE_MAX];
+					const uint8_t size = keymapPs2Sequence(code, false, seq);
+					if (!_dev.write(seq, size)) {
+						return false;
+					}
+					_setBreakPending(code, false);
+				}
+			}
+			_breaks_pending = false;
+			return true;
+		}
+
+		void _setBreakPending(uint8_t code, bool pending) {
+			if (pending) {
+				_pending_breaks[code / 8] |= (1 << (code % 8));
+				_breaks_pending = true;
+			} else {
+				_pending_breaks[code / 8] &= ~(1 << (code % 8));
+			}
+		}
+
+		void _periodicRepeat() {
+			if (_repeat_code == 0) {
+				return;
+			}
+			// Delay: (1 + bits 5-6) * 250ms, period: (8 + bits 0-2) * 2^(bits 3-4) * 4.17ms
+			unsigned long timeout = ((_typematic >> 5) & 0b11) * 250000UL + 250000UL;
+			if (_repeat_delayed) {
+				timeout = (8 + (_typematic & 0b111)) * (1UL << ((_typematic >> 3) & 0b11)) * 4170UL;
+			}
+			if (is_micros_timed_out(_repeat_ts, timeout)) {
+				// Повторы не копятся, пока хост не забрал предыдущие байты
+				if (_dev.getQueued() == 0) {
+					uint8_t seq[HID_KEYMAP_PS2_MAKE_MAX];
+					const uint8_t size = keymapPs2Sequence(_repeat_code, true, seq);
+					_dev.write(seq, size);
+				}
+				_repeat_ts = micros();
+				_repeat_delayed = true;
+			}
+		}
+
+		void _setDefaults() {
+			_typematic = 0x2B; // 10.9 cps, 500ms
+			_param_cmd = 0;
+			_repeat_code = 0;
+			memset(_pending_breaks, 0, sizeof(_pending_breaks)); // The host has forgotten all keys anyway
+			_breaks_pending = false;
+		}
+
+		void _reply(uint8_t data) {
+			_dev.reply(&data, 1);
+		}
+
+		void _handleCommand(uint8_t cmd, bool ok) {
+			if (!ok) {
+				_reply(0xFE); // Resend
+				return;
+			}
+
+			if (_param_cmd != 0 && cmd < 0x80) { // Параметры меньше команд, а команда отменяет ожидание параметра
+				const uint8_t param_cmd = _param_cmd;
+				_param_cmd = 0;
+				switch (param_cmd) {
+					case 0xED: _leds = cmd; break;
+					case 0xF3: _typematic = cmd; break;
+					case 0xF0:
+						if (cmd == 0) {
+							const uint8_t reply[] = {0xFA, 0x02}; // Only the scancode set 2 is supported
+							_dev.reply(reply, 2);
+							return;
+						}
+						break;
+				}
+				_reply(0xFA);
+				return;
+			}
+			_param_cmd = 0;
+
+			switch (cmd) {
+				case 0xFF: { // Reset
+					_dev.clear();
+					_setDefaults();
+					_enabled = true;
+					_leds = 0;
+					const uint8_t reply[] = {0xFA, 0xAA};
+					_dev.reply(reply, 2);
+					break;
+				}
+				case 0xFE: _dev.resend(); break;
+				case 0xF6: _dev.clear(); _setDefaults(); _reply(0xFA); break; // Set defaults
+				case 0xF5: _dev.clear(); _setDefaults(); _enabled = false; _reply(0xFA); break; // Disable scanning
+				case 0xF4: _dev.clear(); _enabled = true; _reply(0xFA); break; // Enable scanning
+				case 0xED: // Set LEDs
+				case 0xF3: // Set typematic
+				case 0xF0: // Scancode set
+					_param_cmd = cmd;
+					_reply(0xFA);
+					break;
+				case 0xF2: { // Identify
+					const uint8_t reply[] = {0xFA, 0xAB, 0x83};
+					_dev.reply(reply, 3);
+					break;
+				}
+				case 0xEE: _reply(0xEE); break; // Echo
+				case 0xF7: case 0xF8: case 0xF9: case 0xFA: case 0xFB: case 0xFC: case 0xFD:
+					_reply(0xFA); // Scancode set 3 only, ignored
+					break;
+				default: _reply(0xFE); break;
+			}
+		}
+
+		Ps2Dev _dev;
 		uint8_t _leds = 0;
+		uint8_t _typematic = 0;
+		uint8_t _param_cmd = 0;
+		bool _enabled = true;
+
+		uint8_t _repeat_code = 0; // MCU code, zero if nothing to repeat
+		unsigned long _repeat_ts = 0;
+		bool _repeat_delayed = false; // The first repeat is already sent
+
+		uint8_t _pending_breaks[(HID_KEYMAP_SIZE + 7) / 8] = {0}; // MCU codes of the releases which didn't fit
+		bool _breaks_pending = false;
 };
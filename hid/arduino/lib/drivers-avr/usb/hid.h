@@ -28,6 +28,8 @@
 #include "keyboard.h"
 #include "mouse.h"
 #include "tools.h"
+#include "stats.h"
+#include "trace.h"
 #include "usb-keymap.h"
 #ifdef AUM
 #	include "aum.h"
@@ -39,13 +41,23 @@ using namespace DRIVERS;
 #ifdef HID_USB_CHECK_ENDPOINT
 // https://github.com/arduino/ArduinoCore-avr/blob/2f67c916f6ab6193c404eebe22efe901e0f9542d/cores/arduino/USBCore.cpp#L249
 // https://sourceforge.net/p/arduinomidilib/svn/41/tree/branch/3.1/Teensy/teensy_core/usb_midi/usb_api.cpp#l103
+// The online state is cached: PONG reads the flag, the endpoint is probed only
+// right before sending (to avoid the blocking USB_Send() on a dead endpoint)
+// and periodically while offline. While online, the periodic check only looks
+// at the bus state which doesn't require the endpoint selection.
 #	ifdef AUM
-#		define CHECK_AUM_USB { if (!aumIsUsbConnected()) { return true; } }
+#		define CHECK_AUM_USB { if (!aumIsUsbConnected()) { _online = false; return false; } }
 #	else
 #		define CHECK_AUM_USB
 #	endif
 #	define CLS_IS_OFFLINE(_hid) \
 		bool isOffline() override { \
+			return !_online; \
+		} \
+	private: \
+		bool _online = true; \
+		unsigned long _online_ts = 0; \
+		bool _probeOnline() { \
 			CHECK_AUM_USB; \
 			uint8_t ep = _hid.getPluggedEndpoint(); \
 			uint8_t intr_state = SREG; \
@@ -53,26 +65,43 @@ using namespace DRIVERS;
 			UENUM = ep & 7; \
 			bool rw_allowed = UEINTX & (1 << RWAL); \
 			SREG = intr_state; \
-			if (rw_allowed) { \
-				return false; \
+			_online = rw_allowed; \
+			return _online; \
+		} \
+		bool _checkOnline() { \
+			if (_online) { \
+				CHECK_AUM_USB; \
+				_online = USBDevice.configured(); \
+				return _online; \
 			} \
-			return true; \
-		}
-#	define CHECK_HID_EP { if (isOffline()) return; }
+			return _probeOnline(); \
+		} \
+		void _periodicOnline() { \
+			if (is_micros_timed_out(_online_ts, 50000)) { \
+				_checkOnline(); \
+				_online_ts = micros(); \
+			} \
+		} \
+	public:
+#	define CHECK_HID_EP { if (!_probeOnline()) { DRIVERS::statsInc(DRIVERS::STAT_REPORT_FAILURES); return; } }
 
 #else
 #	define CLS_IS_OFFLINE(_hid) \
 		bool isOffline() override { \
 			return false; \
-		}
+		} \
+	private: \
+		void _periodicOnline() {} \
+	public:
 #	define CHECK_HID_EP
 
 #endif
 
 
-class UsbKeyboard : public DRIVERS::Keyboard {
+template <class T>
+class UsbKeyboardBase : public DRIVERS::Keyboard {
 	public:
-		UsbKeyboard() : DRIVERS::Keyboard(DRIVERS::USB_KEYBOARD) {}
+		UsbKeyboardBase(DRIVERS::type _type) : DRIVERS::Keyboard(_type) {}
 
 		void begin() override {
 			_kbd.begin();
@@ -83,7 +112,7 @@ class UsbKeyboard : public DRIVERS::Keyboard {
 			static unsigned long prev_ts = 0;
 			if (is_micros_timed_out(prev_ts, 50000)) {
 				static bool prev_online = true;
-				bool online = !isOffline();
+				bool online = _checkOnline();
 				if (!_sent || (online && !prev_online)) {
 					_sendCurrent();
 				}
@@ -119,12 +148,12 @@ class UsbKeyboard : public DRIVERS::Keyboard {
 		}
 
 	private:
-		BootKeyboard_ _kbd;
+		T _kbd;
 		bool _sent = true;
 
 		void _sendCurrent() {
 #			ifdef HID_USB_CHECK_ENDPOINT
-			if (isOffline()) {
+			if (!_probeOnline()) {
 				_sent = false;
 			} else {
 #			endif
@@ -132,9 +161,28 @@ class UsbKeyboard : public DRIVERS::Keyboard {
 #			ifdef HID_USB_CHECK_ENDPOINT
 			}
 #			endif
+			if (_sent) {
+				DRIVERS::traceSubmitted();
+			} else {
+				DRIVERS::statsInc(DRIVERS::STAT_REPORT_FAILURES);
+			}
 		}
 };
 
+class UsbKeyboard : public UsbKeyboardBase<BootKeyboard_> {
+	public:
+		UsbKeyboard() : UsbKeyboardBase(DRIVERS::USB_KEYBOARD) {}
+};
+
+#ifdef HID_WITH_USB_NKRO
+// The bitmap report, no 6KRO limit. Note that HID-Project doesn't support
+// boot protocol for it, so BIOS will not see this keyboard.
+class UsbKeyboardNkro : public UsbKeyboardBase<SingleNKROKeyboard_> {
+	public:
+		UsbKeyboardNkro() : UsbKeyboardBase(DRIVERS::USB_KEYBOARD_NKRO) {}
+};
+#endif
+
 #define CLS_SEND_BUTTONS \
 		void sendButtons( \
 			bool left_select, bool left_state, \
@@ -159,6 +207,10 @@ class UsbMouseAbsolute : public DRIVERS::Mouse {
 			_mouse.setWin98FixEnabled(getType() == DRIVERS::USB_MOUSE_ABSOLUTE_WIN98);
 		}
 
+		void periodic() override {
+			_periodicOnline();
+		}
+
 		void clear() override {
 			_mouse.releaseAll();
 		}
@@ -168,12 +220,14 @@ class UsbMouseAbsolute : public DRIVERS::Mouse {
 		void sendMove(int x, int y) override {
 			CHECK_HID_EP;
 			_mouse.moveTo(x, y);
+			DRIVERS::traceSubmitted();
 		}
 
 		void sendWheel(int delta_y) override {
 			// delta_x is not supported by hid-project now
 			CHECK_HID_EP;
 			_mouse.move(0, 0, delta_y);
+			DRIVERS::traceSubmitted();
 		}
 
 		CLS_IS_OFFLINE(_mouse)
@@ -185,6 +239,7 @@ class UsbMouseAbsolute : public DRIVERS::Mouse {
 			CHECK_HID_EP;
 			if (state) _mouse.press(button);
 			else _mouse.release(button);
+			DRIVERS::traceSubmitted();
 		}
 };
 
@@ -196,6 +251,10 @@ class UsbMouseRelative : public DRIVERS::Mouse {
 			_mouse.begin();
 		}
 
+		void periodic() override {
+			_periodicOnline();
+		}
+
 		void clear() override {
 			_mouse.releaseAll();
 		}
@@ -205,12 +264,14 @@ class UsbMouseRelative : public DRIVERS::Mouse {
 		void sendRelative(int x, int y) override {
 			CHECK_HID_EP;
 			_mouse.move(x, y, 0);
+			DRIVERS::traceSubmitted();
 		}
 
 		void sendWheel(int delta_y) override {
 			// delta_x is not supported by hid-project now
 			CHECK_HID_EP;
 			_mouse.move(0, 0, delta_y);
+			DRIVERS::traceSubmitted();
 		}
 
 		CLS_IS_OFFLINE(_mouse)
@@ -222,6 +283,7 @@ class UsbMouseRelative : public DRIVERS::Mouse {
 			CHECK_HID_EP;
 			if (state) _mouse.press(button);
 			else _mouse.release(button);
+			DRIVERS::traceSubmitted();
 		}
 };
 
@@ -33,20 +33,48 @@ namespace DRIVERS {
 			_rtc.enableClockInterface();
 		}
 
+		// Регистры 16-битные, в каждом два байта, младший первым
 		void readBlock(void *dest, const void *src, size_t size) override {
 			uint8_t *dest_ = reinterpret_cast<uint8_t*>(dest);
-			for(size_t index = 0; index < size; ++index) {
-				dest_[index] = _rtc.getBackupRegister(reinterpret_cast<uintptr_t>(src) + index + 1);
+			const uintptr_t addr = reinterpret_cast<uintptr_t>(src);
+			uint16_t word = 0;
+			for (size_t index = 0; index < size; ++index) {
+				const uintptr_t byte = addr + index;
+				if (index == 0 || !(byte & 1)) {
+					word = _rtc.getBackupRegister(byte / 2 + 1);
+				}
+				dest_[index] = (byte & 1 ? word >> 8 : word & 0xFF);
 			}
 		}
 
 		void updateBlock(const void *src, void *dest, size_t size) override {
 			const uint8_t *src_ = reinterpret_cast<const uint8_t*>(src);
-			for(size_t index = 0; index < size; ++index) {
-				_rtc.setBackupRegister(reinterpret_cast<uintptr_t>(dest) + index + 1, src_[index]);
+			const uintptr_t addr = reinterpret_cast<uintptr_t>(dest);
+			size_t index = 0;
+			while (index < size) {
+				const uintptr_t byte = addr + index;
+				const uint8_t reg = byte / 2 + 1;
+				uint16_t word;
+				if (!(byte & 1) && index + 1 < size) {
+					word = src_[index] | (src_[index + 1] << 8);
+					index += 2;
+				} else {
+					word = _rtc.getBackupRegister(reg); // Half of the register is not ours
+					if (byte & 1) {
+						word = (word & 0x00FF) | (src_[index] << 8);
+					} else {
+						word = (word & 0xFF00) | src_[index];
+					}
+					index += 1;
+				}
+				_rtc.setBackupRegister(reg, word);
 			}
 		}
 
+		size_t getSize() override {
+			return 20; // 10 data registers on the medium-density F103
+		}
+
 		private:
 			STM32F1_RTC _rtc;
 	};
@@ -0,0 +1,55 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#include "profiler.h"
+
+#ifdef HID_PROFILE
+
+#include <Arduino.h>
+
+
+// DWT cycle counter: 32 bits at 72MHz is ~59s before the wrap.
+// libmaple has no CMSIS core headers, so the Cortex-M3 registers are here.
+#define _DEMCR			(*(volatile uint32_t *)0xE000EDFC)
+#define _DEMCR_TRCENA	(1 << 24)
+#define _DWT_CTRL		(*(volatile uint32_t *)0xE0001000)
+#define _DWT_CYCCNTENA	(1 << 0)
+#define _DWT_CYCCNT		(*(volatile uint32_t *)0xE0001004)
+
+
+namespace DRIVERS {
+	void profilerBegin() {
+		_DEMCR |= _DEMCR_TRCENA;
+		_DWT_CYCCNT = 0;
+		_DWT_CTRL |= _DWT_CYCCNTENA;
+	}
+
+	uint32_t profilerNow() {
+		return _DWT_CYCCNT;
+	}
+
+	uint32_t profilerElapsedUs(uint32_t start) {
+		return (_DWT_CYCCNT - start) / (F_CPU / 1000000);
+	}
+}
+
+#endif
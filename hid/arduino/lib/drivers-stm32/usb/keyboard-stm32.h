@@ -26,6 +26,7 @@
 
 #include "tools.h"
 #include "keyboard.h"
+#include "trace.h"
 #include "usb-keymap.h"
 #include "hid-wrapper-stm32.h"
 
@@ -69,6 +70,7 @@ namespace DRIVERS {
 				} else {
 					_keyboard.release(usb_code);
 				}
+				traceSubmitted();
 			}
 
 			bool isOffline() override {
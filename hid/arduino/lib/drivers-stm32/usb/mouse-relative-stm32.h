@@ -25,6 +25,7 @@
 #include <USBComposite.h>
 
 #include "mouse.h"
+#include "trace.h"
 #include "hid-wrapper-stm32.h"
 
 
@@ -59,6 +60,7 @@ namespace DRIVERS {
 						if (x_low##_select) { \
 							if (x_low##_state) _mouse.press(MOUSE_##x_up); \
 							else _mouse.release(MOUSE_##x_up); \
+							traceSubmitted(); \
 						} \
 					}
 				SEND_BUTTON(left, LEFT);
@@ -69,10 +71,12 @@ namespace DRIVERS {
 
 			void sendRelative(int x, int y) override {
 				_mouse.move(x, y);
+				traceSubmitted();
 			}
 
 			void sendWheel(int delta_y) override {
 				_mouse.move(0, 0, delta_y);
+				traceSubmitted();
 			}
 
 			bool isOffline() override {
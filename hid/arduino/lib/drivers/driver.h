@@ -32,6 +32,7 @@ namespace DRIVERS {
 		USB_MOUSE_RELATIVE,
 		USB_MOUSE_ABSOLUTE_WIN98,
 		USB_KEYBOARD,
+		USB_KEYBOARD_NKRO,
 		PS2_KEYBOARD,
 		NON_VOLATILE_STORAGE,
 		BOARD,
@@ -41,6 +42,7 @@ namespace DRIVERS {
 	class Driver {
 	public:
 		Driver(type _type) : _type(_type) {}
+		virtual ~Driver() {}
 		uint8_t getType() { return _type; }
 
 	private:
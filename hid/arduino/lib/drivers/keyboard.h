@@ -64,5 +64,19 @@ namespace DRIVERS {
 			KeyboardLedsState result = {0};
 			return result;
 		}
+
+		/**
+		* Bytes waiting for the host
+		*/
+		virtual uint8_t getQueueDepth() {
+			return 0;
+		}
+
+		/**
+		* How long the host holds the line, 10ms units
+		*/
+		virtual uint8_t getInhibitTime() {
+			return 0;
+		}
 	};
 }
@@ -0,0 +1,49 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#include "profiler.h"
+
+#ifdef HID_PROFILE
+
+
+namespace DRIVERS {
+	static uint32_t _hists[PROBES_COUNT][PROFILE_BUCKETS] = {{0}};
+
+	void profilerAdd(probe index, uint32_t us) {
+		uint8_t bucket = 0;
+		for (; us > 0 && bucket < PROFILE_BUCKETS - 1; us >>= 1) {
+			++bucket;
+		}
+		uint32_t *count = &_hists[index][bucket];
+		if (*count < 0xFFFFFFFF) {
+			++*count;
+		}
+	}
+
+	uint32_t profilerGet(uint8_t index, uint8_t bucket) {
+		const uint32_t value = _hists[index][bucket];
+		_hists[index][bucket] = 0; // The host sums it up, here is only the delta since the previous read
+		return value;
+	}
+}
+
+#endif
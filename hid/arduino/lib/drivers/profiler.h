@@ -0,0 +1,62 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#pragma once
+
+#include <stdint.h>
+
+
+namespace DRIVERS {
+	// The order is the protocol, see PROTO::CMD::GET_PROFILE
+	enum probe {
+		PROBE_LOOP = 0,
+		PROBE_USB,
+		PROBE_PS2,
+		PROBE_STORAGE,
+		PROBE_TRANSPORT,
+		PROBES_COUNT,
+	};
+
+	// Log2 histograms in microseconds: the bucket 0 is under 1us,
+	// the bucket N is [2^(N-1), 2^N), the last one also holds everything longer
+	const uint8_t PROFILE_BUCKETS = 16;
+
+#	ifdef HID_PROFILE
+	// The cycle counter is platform-specific, see drivers-avr and drivers-stm32
+	void profilerBegin();
+	uint32_t profilerNow();
+	uint32_t profilerElapsedUs(uint32_t start);
+
+	void profilerAdd(probe index, uint32_t us);
+	uint32_t profilerGet(uint8_t index, uint8_t bucket); // Zeroes the bucket
+#	endif
+}
+
+#ifdef HID_PROFILE
+#	define PROFILE_RUN(_probe, _call) { \
+		const uint32_t start_ = DRIVERS::profilerNow(); \
+		_call; \
+		DRIVERS::profilerAdd(_probe, DRIVERS::profilerElapsedUs(start_)); \
+	}
+#else
+#	define PROFILE_RUN(_probe, _call) { _call; }
+#endif
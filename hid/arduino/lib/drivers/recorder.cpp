@@ -0,0 +1,61 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#include <Arduino.h>
+
+#include "recorder.h"
+
+
+namespace DRIVERS {
+	static struct {
+		uint32_t ts;
+		uint32_t data; // Type and three bytes
+	} _ring[HID_RECORDER_SIZE];
+
+	static uint16_t _next_seq = 0;
+	static uint16_t _count = 0;
+
+	void recorderAdd(record type, uint8_t a, uint8_t b, uint8_t c) {
+		const uint8_t index = _next_seq & (HID_RECORDER_SIZE - 1);
+		_ring[index].ts = micros();
+		_ring[index].data = ((uint32_t)type << 24) | ((uint32_t)a << 16) | ((uint16_t)b << 8) | c;
+		++_next_seq;
+		if (_count < HID_RECORDER_SIZE) {
+			++_count;
+		}
+	}
+
+	bool recorderGet(uint16_t seq, uint8_t half, uint32_t *value) {
+		switch (half) {
+			case 0: case 1: break;
+			case 2: *value = micros(); return true;
+			case 3: *value = ((uint32_t)_next_seq << 16) | _count; return true;
+			default: return false;
+		}
+		if ((uint16_t)(_next_seq - seq - 1) >= _count) {
+			return false; // Not written yet or already overwritten
+		}
+		const uint8_t index = seq & (HID_RECORDER_SIZE - 1);
+		*value = (half == 0 ? _ring[index].ts : _ring[index].data);
+		return true;
+	}
+}
@@ -0,0 +1,60 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#pragma once
+
+#include <stdint.h>
+
+#ifndef HID_RECORDER_SIZE
+#	ifdef __AVR__
+#		define HID_RECORDER_SIZE 32 // Power of two, 8 bytes per entry
+#	else
+#		define HID_RECORDER_SIZE 128
+#	endif
+#endif
+
+
+namespace DRIVERS {
+	// The order is the protocol, see PROTO::CMD::GET_RECORD
+	enum record {
+		REC_BOOT = 1,
+		REC_CMD, // Command, two first args
+		REC_RESP, // Code or PONG bytes 1-3, PONG only when changed
+		REC_ONLINE, // Endpoint from recordEndpoint, online flag
+		REC_STAT, // Counter from DRIVERS::stat, except STAT_RX_FRAMES
+	};
+
+	enum recordEndpoint {
+		REC_EP_USB_KEYBOARD = 0,
+		REC_EP_USB_MOUSE,
+		REC_EP_PS2_KEYBOARD,
+		REC_EP_PS2_MOUSE,
+	};
+
+	void recorderAdd(record type, uint8_t a, uint8_t b, uint8_t c);
+
+	/**
+	* Halves 0 and 1 are the timestamp in microseconds and the type with data of the entry seq.
+	* Halves 2 and 3 are the current timestamp and the next seq with the number of entries.
+	*/
+	bool recorderGet(uint16_t seq, uint8_t half, uint32_t *value);
+}
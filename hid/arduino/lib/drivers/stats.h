@@ -0,0 +1,60 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#pragma once
+
+#include <stdint.h>
+
+#include "recorder.h"
+
+
+namespace DRIVERS {
+	// The order is the protocol, see PROTO::CMD::GET_STATS
+	enum stat {
+		STAT_RX_FRAMES = 0,
+		STAT_CRC_ERRORS,
+		STAT_INVALID_COMMANDS,
+		STAT_RX_TIMEOUTS,
+		STAT_REPORT_FAILURES,
+		STAT_PS2_INHIBITS,
+		STAT_RESET_REQUESTS,
+		STAT_LOOP_MAX_US, // Zeroed on read
+		STATS_COUNT,
+	};
+
+	extern uint32_t stats[STATS_COUNT];
+
+	inline void statsInc(stat index) {
+		++stats[index];
+		if (index != STAT_RX_FRAMES) {
+			recorderAdd(REC_STAT, index, 0, 0);
+		}
+	}
+
+	inline void statsMax(stat index, uint32_t value) {
+		if (stats[index] < value) {
+			stats[index] = value;
+		}
+	}
+
+	uint32_t statsGet(uint8_t index);
+}
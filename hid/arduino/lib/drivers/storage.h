@@ -31,5 +31,23 @@ namespace DRIVERS {
 		using Driver::Driver;
 		virtual void readBlock(void *dest, const void *src, size_t size) {}
 		virtual void updateBlock(const void *src, void *dest, size_t size) {}
+
+		virtual size_t getSize() {
+			return 0;
+		}
+
+		/**
+		* False if updateBlock() would wait for the previous write
+		*/
+		virtual bool isReady() {
+			return true;
+		}
+
+		/**
+		* True if every written byte takes time (EEPROM), so the writes should be spread
+		*/
+		virtual bool hasWriteLatency() {
+			return false;
+		}
 	};
 }
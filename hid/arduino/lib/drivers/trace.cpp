@@ -0,0 +1,60 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#include <Arduino.h>
+
+#include "trace.h"
+
+
+namespace DRIVERS {
+	static unsigned long _rx_ts = 0;
+	static uint16_t _apply_us = 0;
+	static uint16_t _report_us = TRACE_PENDING;
+	static bool _armed = false;
+
+	static uint16_t _clampUs(unsigned long us) {
+		return (us >= TRACE_PENDING ? TRACE_PENDING - 1 : us);
+	}
+
+	void traceBegin() {
+		_rx_ts = micros();
+		_apply_us = 0;
+		_report_us = TRACE_PENDING;
+		_armed = true;
+	}
+
+	void traceApplied() {
+		_apply_us = _clampUs(micros() - _rx_ts);
+	}
+
+	void traceSubmitted() {
+		// USB reports are sent right from the command handler, so it may come before traceApplied()
+		if (_armed) {
+			_report_us = _clampUs(micros() - _rx_ts);
+			_armed = false;
+		}
+	}
+
+	uint32_t traceGet() {
+		return ((uint32_t)_apply_us << 16) | _report_us;
+	}
+}
@@ -44,6 +44,7 @@ elif env.GetProjectOption("platform") == "atmelavr":
     _libs = _get_libs()
     _patch(_libs["HID-Project"], "patches/hid-shut-up.patch")
     _patch(_libs["HID-Project"], "patches/hid-no-singletones.patch")
+    _patch(_libs["HID-Project"], "patches/hid-no-nkro-singletone.patch")
     _patch(_libs["HID-Project"], "patches/hid-win98.patch")
 else:
     assert(False)
@@ -0,0 +1,167 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#pragma once
+
+#include "storage.h"
+#include "proto.h"
+
+
+class Journal {
+	// После старого 8-байтного блока лежит кольцо 4-байтных записей {seq, value, crc16}.
+	// Каждое изменение пишется в следующий слот, а последняя целая запись не трогается,
+	// так что оборванная запись просто не пройдет CRC. В EEPROM запись идет по байту за вызов
+	// periodic() и только если память готова, поэтому loop() никогда ее не ждет.
+	// Память без задержки (бэкап-регистры STM32) получает всю запись одним блоком.
+
+	public:
+		void begin(DRIVERS::Storage *storage) {
+			_storage = storage;
+			const size_t size = _storage->getSize();
+			_count = 0;
+			if (size >= _OFFSET + _RECORD_SIZE) {
+				_count = (size - _OFFSET) / _RECORD_SIZE;
+				if (_count > _MAX_RECORDS) {
+					_count = _MAX_RECORDS;
+				}
+			}
+			_slot = _count - 1;
+			_seq = 0xFF;
+			_value = -1;
+
+			for (uint8_t index = 0; index < _count; ++index) {
+				uint8_t seq;
+				uint8_t value;
+				if (!_readRecord(index, &seq, &value)) {
+					continue;
+				}
+				uint8_t next_seq;
+				uint8_t next_value;
+				const uint8_t next = (index + 1) % _count;
+				if (_count > 1 && _readRecord(next, &next_seq, &next_value) && next_seq == (uint8_t)(seq + 1)) {
+					continue;
+				}
+				_slot = index;
+				_seq = seq;
+				_value = value;
+				break;
+			}
+
+			if (_value < 0) {
+				_value = _readLegacy();
+				_dirty = (_value >= 0); // Move it to the journal
+			}
+		}
+
+		/**
+		* Returns -1 if there is no valid record
+		*/
+		int read() {
+			return _value;
+		}
+
+		void write(uint8_t value) {
+			if (_value != value) {
+				_value = value;
+				_dirty = true;
+			}
+		}
+
+		void periodic() {
+			if (_count == 0) {
+				_dirty = false;
+				return;
+			}
+			if (!_writing) {
+				if (!_dirty) {
+					return;
+				}
+				_record[0] = _seq + 1;
+				_record[1] = _value;
+				PROTO::split16(_crc(_record[0], _record[1]), &_record[2], &_record[3]);
+				_pos = 0;
+				_writing = true;
+				_dirty = false;
+			}
+			if (!_storage->isReady()) {
+				return;
+			}
+			const uint8_t next = (_slot + 1) % _count;
+			const uint8_t size = (_storage->hasWriteLatency() ? 1 : _RECORD_SIZE - _pos);
+			_storage->updateBlock(&_record[_pos], _getAddr(next, _pos), size);
+			_pos += size;
+			if (_pos == _RECORD_SIZE) {
+				_slot = next;
+				_seq = _record[0];
+				_writing = false;
+			}
+		}
+
+		bool isSynced() {
+			return (!_dirty && !_writing);
+		}
+
+	private:
+		static const size_t _OFFSET = 8;
+		static const uint8_t _RECORD_SIZE = 4;
+		static const uint8_t _MAX_RECORDS = 32;
+
+		void *_getAddr(uint8_t slot, uint8_t pos) {
+			return reinterpret_cast<void *>(_OFFSET + slot * _RECORD_SIZE + pos);
+		}
+
+		uint16_t _crc(uint8_t seq, uint8_t value) {
+			const uint8_t data[3] = {PROTO::MAGIC, seq, value};
+			return PROTO::crc16(data, 3);
+		}
+
+		bool _readRecord(uint8_t slot, uint8_t *seq, uint8_t *value) {
+			uint8_t data[_RECORD_SIZE];
+			_storage->readBlock(data, _getAddr(slot, 0), _RECORD_SIZE);
+			if (_crc(data[0], data[1]) != PROTO::merge8(data[2], data[3])) {
+				return false;
+			}
+			*seq = data[0];
+			*value = data[1];
+			return true;
+		}
+
+		int _readLegacy() {
+			// Блок, который писали прошивки до журнала
+			uint8_t data[8] = {0};
+			_storage->readBlock(data, 0, 8);
+			if (data[0] != PROTO::MAGIC || PROTO::crc16(data, 6) != PROTO::merge8(data[6], data[7])) {
+				return -1;
+			}
+			return data[1];
+		}
+
+		DRIVERS::Storage *_storage = nullptr;
+		uint8_t _count = 0;
+		uint8_t _slot = 0;
+		uint8_t _seq = 0;
+		int _value = -1;
+		bool _dirty = false;
+		bool _writing = false;
+		uint8_t _record[_RECORD_SIZE];
+		uint8_t _pos = 0;
+};
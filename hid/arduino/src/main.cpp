@@ -23,6 +23,10 @@
 #include <Arduino.h>
 
 #include "tools.h"
+#include "stats.h"
+#include "profiler.h"
+#include "trace.h"
+#include "recorder.h"
 #include "proto.h"
 #include "board.h"
 #include "outputs.h"
@@ -34,6 +38,7 @@
 static DRIVERS::Connection *_conn;
 static DRIVERS::Board *_board;
 static Outputs _out;
+static uint32_t _stats_value = 0; // For PROTO::RESP::STATS, TRACE and RECORD, including the repeated one
 
 #ifdef HID_DYNAMIC
 #	define RESET_TIMEOUT 500000
@@ -45,6 +50,7 @@ static unsigned long _reset_timestamp;
 // -----------------------------------------------------------------------------
 #ifdef HID_DYNAMIC
 static void _resetRequest() {
+	DRIVERS::statsInc(DRIVERS::STAT_RESET_REQUESTS);
 	_reset_required = true;
 	_reset_timestamp = micros();
 }
@@ -53,14 +59,18 @@ static void _resetRequest() {
 static void _cmdSetKeyboard(const uint8_t *data) { // 1 bytes
 #	ifdef HID_DYNAMIC
 	_out.writeOutputs(PROTO::OUTPUTS1::KEYBOARD::MASK, data[0], false);
-	_resetRequest();
+	if (!_out.applyOutputs()) {
+		_resetRequest();
+	}
 #	endif
 }
 
 static void _cmdSetMouse(const uint8_t *data) { // 1 bytes
 #	ifdef HID_DYNAMIC
 	_out.writeOutputs(PROTO::OUTPUTS1::MOUSE::MASK, data[0], false);
-	_resetRequest();
+	if (!_out.applyOutputs()) {
+		_resetRequest();
+	}
 #	endif
 }
 
@@ -115,29 +125,93 @@ static uint8_t _handleRequest(const uint8_t *data) { // 8 bytes
 	// FIXME: See kvmd/kvmd#80
 	// Should input buffer be cleared in this case?
 	if (data[0] == PROTO::MAGIC && PROTO::crc16(data, 6) == PROTO::merge8(data[6], data[7])) {
-#		define HANDLE(_handler) { _handler(data + 2); return PROTO::PONG::OK; }
+		DRIVERS::statsInc(DRIVERS::STAT_RX_FRAMES);
+#		define RECORD_CMD DRIVERS::recorderAdd(DRIVERS::REC_CMD, data[1], data[2], data[3])
+#		define HANDLE(_handler) { RECORD_CMD; _handler(data + 2); return PROTO::PONG::OK; }
+#		define HANDLE_INPUT(_handler) { \
+			RECORD_CMD; \
+			DRIVERS::traceBegin(); \
+			_handler(data + 2); \
+			DRIVERS::traceApplied(); \
+			return PROTO::PONG::OK; \
+		}
 		switch (data[1]) {
 			case PROTO::CMD::PING:		return PROTO::PONG::OK;
 			case PROTO::CMD::SET_KEYBOARD:		HANDLE(_cmdSetKeyboard);
 			case PROTO::CMD::SET_MOUSE:			HANDLE(_cmdSetMouse);
 			case PROTO::CMD::SET_CONNECTED:		HANDLE(_cmdSetConnected);
-			case PROTO::CMD::CLEAR_HID:			HANDLE(_cmdClearHid);
-			case PROTO::CMD::KEYBOARD::KEY:		HANDLE(_cmdKeyEvent);
-			case PROTO::CMD::MOUSE::BUTTON:		HANDLE(_cmdMouseButtonEvent);
-			case PROTO::CMD::MOUSE::MOVE:		HANDLE(_cmdMouseMoveEvent);
-			case PROTO::CMD::MOUSE::RELATIVE:	HANDLE(_cmdMouseRelativeEvent);
-			case PROTO::CMD::MOUSE::WHEEL:		HANDLE(_cmdMouseWheelEvent);
+			case PROTO::CMD::GET_STATS:
+				if (data[2] < DRIVERS::STATS_COUNT) {
+					_stats_value = DRIVERS::statsGet(data[2]);
+					return PROTO::RESP::STATS;
+				}
+				DRIVERS::statsInc(DRIVERS::STAT_INVALID_COMMANDS);
+				return PROTO::RESP::INVALID_ERROR;
+#			ifdef HID_PROFILE
+			case PROTO::CMD::GET_PROFILE:
+				if (data[2] < DRIVERS::PROBES_COUNT && data[3] < DRIVERS::PROFILE_BUCKETS) {
+					_stats_value = DRIVERS::profilerGet(data[2], data[3]);
+					return PROTO::RESP::STATS;
+				}
+				DRIVERS::statsInc(DRIVERS::STAT_INVALID_COMMANDS);
+				return PROTO::RESP::INVALID_ERROR;
+#			endif
+			case PROTO::CMD::GET_TRACE:
+				_stats_value = DRIVERS::traceGet();
+				return PROTO::RESP::TRACE;
+			case PROTO::CMD::GET_RECORD:
+				if (DRIVERS::recorderGet(PROTO::merge8(data[2], data[3]), data[4], &_stats_value)) {
+					return PROTO::RESP::RECORD;
+				}
+				return PROTO::RESP::INVALID_ERROR; // Overwritten, not counted to keep the ring untouched
+			case PROTO::CMD::CLEAR_HID:			HANDLE_INPUT(_cmdClearHid);
+			case PROTO::CMD::KEYBOARD::KEY:		HANDLE_INPUT(_cmdKeyEvent);
+			case PROTO::CMD::MOUSE::BUTTON:		HANDLE_INPUT(_cmdMouseButtonEvent);
+			case PROTO::CMD::MOUSE::MOVE:		HANDLE_INPUT(_cmdMouseMoveEvent);
+			case PROTO::CMD::MOUSE::RELATIVE:	HANDLE_INPUT(_cmdMouseRelativeEvent);
+			case PROTO::CMD::MOUSE::WHEEL:		HANDLE_INPUT(_cmdMouseWheelEvent);
 			case PROTO::CMD::REPEAT:	return 0;
-			default:					return PROTO::RESP::INVALID_ERROR;
+			default:
+				DRIVERS::statsInc(DRIVERS::STAT_INVALID_COMMANDS);
+				return PROTO::RESP::INVALID_ERROR;
 		}
+#		undef HANDLE_INPUT
 #		undef HANDLE
+#		undef RECORD_CMD
 	}
+	DRIVERS::statsInc(DRIVERS::STAT_CRC_ERRORS);
 	return PROTO::RESP::CRC_ERROR;
 }
 
 
 // -----------------------------------------------------------------------------
-static void _sendResponse(uint8_t code) {
+static void _recordOnline(DRIVERS::recordEndpoint ep, bool online) {
+	static uint8_t offline = 0; // Bits by the endpoint, everything is online at start like in PONG
+	const uint8_t bit = (1 << ep);
+	if (((offline & bit) == 0) != online) {
+		offline ^= bit;
+		DRIVERS::recorderAdd(DRIVERS::REC_ONLINE, ep, online, 0);
+	}
+}
+
+static void _recordResponse(const uint8_t *response) {
+	static uint8_t prev_pong[3] = {0};
+	if (response[1] & PROTO::PONG::OK) {
+		if (!memcmp(prev_pong, response + 1, 3)) {
+			return; // Pings are constant, only the changes are interesting
+		}
+		memcpy(prev_pong, response + 1, 3);
+	} else if (
+		response[1] == PROTO::RESP::STATS
+		|| response[1] == PROTO::RESP::TRACE
+		|| response[1] == PROTO::RESP::RECORD
+	) {
+		return;
+	}
+	DRIVERS::recorderAdd(DRIVERS::REC_RESP, response[1], response[2], response[3]);
+}
+
+static void _sendResponse(uint8_t code, bool record) {
 	static uint8_t prev_code = PROTO::RESP::NONE;
 	if (code == 0) {
 		code = prev_code; // Repeat the last code
@@ -152,14 +226,19 @@ static void _sendResponse(uint8_t code) {
 #		ifdef HID_DYNAMIC
 		if (_reset_required) {
 			response[1] |= PROTO::PONG::RESET_REQUIRED;
-			if (is_micros_timed_out(_reset_timestamp, RESET_TIMEOUT)) {
+			if (is_micros_timed_out(_reset_timestamp, RESET_TIMEOUT) && _out.isSynced()) {
 				_board->reset();
 			}
 		}
 		response[2] = PROTO::OUTPUTS1::DYNAMIC;
 #		endif
 		if (_out.kbd->getType() != DRIVERS::DUMMY) {
-			if(_out.kbd->isOffline()) {
+			const bool kbd_offline = _out.kbd->isOffline();
+			_recordOnline(
+				(_out.kbd->getType() == DRIVERS::PS2_KEYBOARD ? DRIVERS::REC_EP_PS2_KEYBOARD : DRIVERS::REC_EP_USB_KEYBOARD),
+				!kbd_offline
+			);
+			if(kbd_offline) {
 				response[1] |= PROTO::PONG::KEYBOARD_OFFLINE;
 			} else {
 				_board->updateStatus(DRIVERS::KEYBOARD_ONLINE);
@@ -168,17 +247,24 @@ static void _sendResponse(uint8_t code) {
 			response[1] |= (leds.caps ? PROTO::PONG::CAPS : 0);
 			response[1] |= (leds.num ? PROTO::PONG::NUM : 0);
 			response[1] |= (leds.scroll ? PROTO::PONG::SCROLL : 0);
+			response[4] = _out.kbd->getQueueDepth();
+			response[5] = _out.kbd->getInhibitTime();
 			switch (_out.kbd->getType()) {
 				case DRIVERS::USB_KEYBOARD:
 					response[2] |= PROTO::OUTPUTS1::KEYBOARD::USB;
 					break;			
+				case DRIVERS::USB_KEYBOARD_NKRO:
+					response[2] |= PROTO::OUTPUTS1::KEYBOARD::USB_NKRO;
+					break;
 				case DRIVERS::PS2_KEYBOARD:
 					response[2] |= PROTO::OUTPUTS1::KEYBOARD::PS2;
 					break;			
 			}	
 		}
 		if (_out.mouse->getType() != DRIVERS::DUMMY) {
-			if(_out.mouse->isOffline()) {
+			const bool mouse_offline = _out.mouse->isOffline();
+			_recordOnline(DRIVERS::REC_EP_USB_MOUSE, !mouse_offline);
+			if(mouse_offline) {
 				response[1] |= PROTO::PONG::MOUSE_OFFLINE;
 			} else {
 				_board->updateStatus(DRIVERS::MOUSE_ONLINE);
@@ -206,27 +292,46 @@ static void _sendResponse(uint8_t code) {
 #		ifdef HID_WITH_USB_WIN98
 		response[3] |= PROTO::OUTPUTS2::HAS_USB_WIN98;
 #		endif
+#		ifdef HID_WITH_USB_NKRO
+		response[3] |= PROTO::OUTPUTS2::HAS_USB_NKRO;
+#		endif
 #		endif
 #		ifdef HID_WITH_PS2
 		response[3] |= PROTO::OUTPUTS2::HAS_PS2;
 #		endif
+	} else if (code == PROTO::RESP::STATS || code == PROTO::RESP::TRACE || code == PROTO::RESP::RECORD) {
+		response[1] = code;
+		PROTO::split16(_stats_value >> 16, &response[2], &response[3]);
+		PROTO::split16(_stats_value & 0xFFFF, &response[4], &response[5]);
 	} else {
 		response[1] = code;
 	}
+	if (record) {
+		_recordResponse(response);
+	}
+
 	PROTO::split16(PROTO::crc16(response, 6), &response[6], &response[7]);
 
 	_conn->write(response, 8);
 }
 
 static void _onTimeout() {
-	_sendResponse(PROTO::RESP::TIMEOUT_ERROR);
+	DRIVERS::statsInc(DRIVERS::STAT_RX_TIMEOUTS);
+	_sendResponse(PROTO::RESP::TIMEOUT_ERROR, true);
 }
 
 static void _onData(const uint8_t *data, size_t size) {
-	_sendResponse(_handleRequest(data));
+	// The diagnostics is not recorded, otherwise the dump would overwrite itself
+	const bool record = (data[1] < PROTO::CMD::GET_STATS || data[1] > PROTO::CMD::GET_RECORD);
+	_sendResponse(_handleRequest(data), record);
 }
 
 void setup() {
+	DRIVERS::recorderAdd(DRIVERS::REC_BOOT, 0, 0, 0);
+#	ifdef HID_PROFILE
+	DRIVERS::profilerBegin();
+#	endif
+
 	_out.initOutputs();
 
 #	ifdef AUM
@@ -242,12 +347,26 @@ void setup() {
 }
 
 void loop() {
+	static unsigned long loop_ts = micros();
+	const unsigned long now_ts = micros();
+	DRIVERS::statsMax(DRIVERS::STAT_LOOP_MAX_US, now_ts - loop_ts);
+	loop_ts = now_ts;
+#	ifdef HID_PROFILE
+	static uint32_t profile_ts = DRIVERS::profilerNow();
+	DRIVERS::profilerAdd(DRIVERS::PROBE_LOOP, DRIVERS::profilerElapsedUs(profile_ts));
+	profile_ts = DRIVERS::profilerNow();
+#	endif
+
 #	ifdef AUM
 	aumProxyUsbVbus();
 #	endif
 
-	_out.kbd->periodic();
-	_out.mouse->periodic();
+	PROFILE_RUN(
+		(_out.kbd->getType() == DRIVERS::PS2_KEYBOARD ? DRIVERS::PROBE_PS2 : DRIVERS::PROBE_USB),
+		_out.kbd->periodic()
+	);
+	PROFILE_RUN(DRIVERS::PROBE_USB, _out.mouse->periodic());
+	PROFILE_RUN(DRIVERS::PROBE_STORAGE, _out.periodic());
 	_board->periodic();
-	_conn->periodic();
+	PROFILE_RUN(DRIVERS::PROBE_TRANSPORT, _conn->periodic());
 }
@@ -22,23 +22,15 @@
 
 #include "factory.h"
 #include "proto.h"
+#include "journal.h"
 
 
 class Outputs {
 	public:
 		void writeOutputs(uint8_t mask, uint8_t outputs, bool force) {
-			int old = 0;
-			if (!force) {
-				old = _readOutputs();
-				if (old < 0) {
-					old = 0;
-				}
-			}
-			uint8_t data[8] = {0};
-			data[0] = PROTO::MAGIC;
-			data[1] = (old & ~mask) | outputs;
-			PROTO::split16(PROTO::crc16(data, 6), &data[6], &data[7]);
-			_storage->updateBlock(data, 0, 8);
+			// Только RAM, в энергонезависимую память уходит из periodic()
+			_outputs = ((force ? 0 : _outputs) & ~mask) | outputs;
+			_journal.write(_outputs);
 		}
 
 		void initOutputs() {
@@ -48,8 +40,11 @@ class Outputs {
 			_storage = DRIVERS::Factory::makeStorage(DRIVERS::DUMMY);
 #			endif
 
-			int outputs = _readOutputs();
-			if (outputs < 0) {
+			_journal.begin(_storage);
+			int outputs = _journal.read();
+			if (outputs >= 0) {
+				_outputs = outputs;
+			} else {
 				outputs = 0;
 #				if defined(HID_WITH_USB) && defined(HID_SET_USB_KBD)
 				outputs |= PROTO::OUTPUTS1::KEYBOARD::USB;
@@ -68,34 +63,8 @@ class Outputs {
 				writeOutputs(0xFF, outputs, true);
 			}
 
-			uint8_t kbd_type = outputs & PROTO::OUTPUTS1::KEYBOARD::MASK;
-			switch (kbd_type) {
-				case PROTO::OUTPUTS1::KEYBOARD::USB:
-					kbd = DRIVERS::Factory::makeKeyboard(DRIVERS::USB_KEYBOARD);
-					break;
-				case PROTO::OUTPUTS1::KEYBOARD::PS2:
-					kbd = DRIVERS::Factory::makeKeyboard(DRIVERS::PS2_KEYBOARD);
-					break;
-				default:
-					kbd = DRIVERS::Factory::makeKeyboard(DRIVERS::DUMMY);
-					break;
-			}
-
-			uint8_t mouse_type = outputs & PROTO::OUTPUTS1::MOUSE::MASK;
-			switch (mouse_type) {
-				case PROTO::OUTPUTS1::MOUSE::USB_ABS:
-					mouse = DRIVERS::Factory::makeMouse(DRIVERS::USB_MOUSE_ABSOLUTE);
-					break;
-				case PROTO::OUTPUTS1::MOUSE::USB_WIN98:
-					mouse = DRIVERS::Factory::makeMouse(DRIVERS::USB_MOUSE_ABSOLUTE_WIN98);
-					break;
-				case PROTO::OUTPUTS1::MOUSE::USB_REL:
-					mouse = DRIVERS::Factory::makeMouse(DRIVERS::USB_MOUSE_RELATIVE);
-					break;
-				default:
-					mouse = DRIVERS::Factory::makeMouse(DRIVERS::DUMMY);
-					break;
-			}
+			kbd = DRIVERS::Factory::makeKeyboard(_getKeyboardType(outputs));
+			mouse = DRIVERS::Factory::makeMouse(_getMouseType(outputs));
 
 #			ifdef ARDUINO_ARCH_AVR
 			USBDevice.attach();
@@ -105,18 +74,92 @@ class Outputs {
 			mouse->begin();
 		}
 
+		bool applyOutputs() {
+			// Пересоздает драйверы под новые выходы без ресета МК.
+			// USB-интерфейсы регистрируются в конструкторах драйверов (PluggableUSB на AVR,
+			// HidWrapper на STM32), так что смена USB-конфигурации по-прежнему требует ресета:
+			// в этом случае ничего не трогаем и возвращаем false.
+			const uint8_t outputs = _outputs;
+			const DRIVERS::type kbd_type = _getKeyboardType(outputs);
+			const DRIVERS::type mouse_type = _getMouseType(outputs);
+			if (!_isSwappable(kbd->getType(), kbd_type) || !_isSwappable(mouse->getType(), mouse_type)) {
+				return false;
+			}
+			if (kbd->getType() != kbd_type) {
+				kbd->clear();
+				delete kbd;
+				kbd = DRIVERS::Factory::makeKeyboard(kbd_type);
+				kbd->begin();
+			}
+			if (mouse->getType() != mouse_type) {
+				mouse->clear();
+				delete mouse;
+				mouse = DRIVERS::Factory::makeMouse(mouse_type);
+				mouse->begin();
+			}
+			return true;
+		}
+
+		void periodic() {
+			_journal.periodic();
+		}
+
+		/**
+		* True if the outputs are persisted
+		*/
+		bool isSynced() {
+			return _journal.isSynced();
+		}
+
 		DRIVERS::Keyboard *kbd = nullptr;
 		DRIVERS::Mouse *mouse = nullptr;
 		
 	private:
-		int _readOutputs(void) {
-			uint8_t data[8];
-			_storage->readBlock(data, 0, 8);
-			if (data[0] != PROTO::MAGIC || PROTO::crc16(data, 6) != PROTO::merge8(data[6], data[7])) {
-				return -1;
+
+		DRIVERS::type _getKeyboardType(int outputs) {
+			switch (outputs & PROTO::OUTPUTS1::KEYBOARD::MASK) {
+#				ifdef HID_WITH_USB
+				case PROTO::OUTPUTS1::KEYBOARD::USB: return DRIVERS::USB_KEYBOARD;
+#				ifdef HID_WITH_USB_NKRO
+				case PROTO::OUTPUTS1::KEYBOARD::USB_NKRO: return DRIVERS::USB_KEYBOARD_NKRO;
+#				endif
+#				endif
+#				ifdef HID_WITH_PS2
+				case PROTO::OUTPUTS1::KEYBOARD::PS2: return DRIVERS::PS2_KEYBOARD;
+#				endif
+				default: return DRIVERS::DUMMY;
+			}
+		}
+
+		DRIVERS::type _getMouseType(int outputs) {
+			switch (outputs & PROTO::OUTPUTS1::MOUSE::MASK) {
+#				ifdef HID_WITH_USB
+				case PROTO::OUTPUTS1::MOUSE::USB_ABS: return DRIVERS::USB_MOUSE_ABSOLUTE;
+				case PROTO::OUTPUTS1::MOUSE::USB_WIN98: return DRIVERS::USB_MOUSE_ABSOLUTE_WIN98;
+				case PROTO::OUTPUTS1::MOUSE::USB_REL: return DRIVERS::USB_MOUSE_RELATIVE;
+#				endif
+				default: return DRIVERS::DUMMY;
+			}
+		}
+
+		bool _isSwappable(uint8_t old_type, uint8_t new_type) {
+			return (old_type == new_type || (!_isUsb(old_type) && !_isUsb(new_type)));
+		}
+
+		bool _isUsb(uint8_t type) {
+			switch (type) {
+				case DRIVERS::USB_KEYBOARD:
+				case DRIVERS::USB_KEYBOARD_NKRO:
+				case DRIVERS::USB_MOUSE_ABSOLUTE:
+				case DRIVERS::USB_MOUSE_ABSOLUTE_WIN98:
+				case DRIVERS::USB_MOUSE_RELATIVE:
+					return true;
+				default:
+					return false;
 			}
-			return data[1];
 		}
 
 		DRIVERS::Storage *_storage = nullptr;
+		Journal _journal;
+		uint8_t _outputs = 0;
 };
@@ -33,6 +33,9 @@ namespace PROTO {
 		const uint8_t CRC_ERROR =		0x40;
 		const uint8_t INVALID_ERROR =	0x45;
 		const uint8_t TIMEOUT_ERROR =	0x48;
+		const uint8_t STATS =			0x28; // The counter in bytes 2-5, big-endian
+		const uint8_t TRACE =			0x29; // Microseconds rx->apply in bytes 2-3, rx->report in bytes 4-5
+		const uint8_t RECORD =			0x2A; // A half of the flight recorder entry in bytes 2-5
 	};
 
 	namespace PONG { // Complex response
@@ -51,6 +54,7 @@ namespace PROTO {
 			const uint8_t MASK =	0b00000111;
 			const uint8_t USB =		0b00000001;
 			const uint8_t PS2 =		0b00000011;
+			const uint8_t USB_NKRO =	0b00000101;
 		};
 		namespace MOUSE {
 			const uint8_t MASK =		0b00111000;
@@ -67,6 +71,7 @@ namespace PROTO {
 		const uint8_t HAS_USB =			0b00000001;
 		const uint8_t HAS_PS2 =			0b00000010;
 		const uint8_t HAS_USB_WIN98 =	0b00000100;
+		const uint8_t HAS_USB_NKRO =	0b00001000;
 	}
 
 	namespace CMD {
@@ -75,6 +80,10 @@ namespace PROTO {
 		const uint8_t SET_KEYBOARD =	0x03;
 		const uint8_t SET_MOUSE =		0x04;
 		const uint8_t SET_CONNECTED =	0x05;
+		const uint8_t GET_STATS =		0x07; // The counter index from DRIVERS::stat
+		const uint8_t GET_PROFILE =		0x08; // DRIVERS::probe and the bucket, zeroed on read
+		const uint8_t GET_TRACE =		0x09; // Stamps of the last input command
+		const uint8_t GET_RECORD =		0x0A; // Entry seq (2 bytes) and the half, see DRIVERS::recorderGet()
 		const uint8_t CLEAR_HID =		0x10;
 
 		namespace KEYBOARD {
@@ -109,7 +118,7 @@ namespace PROTO {
 		};
 	};
 
-	uint16_t crc16(const uint8_t *buffer, unsigned length) {
+	inline uint16_t crc16(const uint8_t *buffer, unsigned length) {
 		const uint16_t polinom = 0xA001;
 		uint16_t crc = 0xFFFF;
 
@@ -128,7 +137,7 @@ namespace PROTO {
 	}
 
 	inline int merge8_int(uint8_t from_a, uint8_t from_b) {
-		return (((int)from_a << 8) | (int)from_b);
+		return (int16_t)(((uint16_t)from_a << 8) | (uint16_t)from_b); // Signed on 32-bit int too
 	}
 
 	inline uint16_t merge8(uint8_t from_a, uint8_t from_b) {
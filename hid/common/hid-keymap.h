@@ -0,0 +1,528 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+// Общие таблицы для AVR, STM32 и Pico: код MCU - это просто индекс.
+// Сгенерировано из keymap.csv, не редактировать руками.
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __AVR__
+#	include <avr/pgmspace.h>
+#	define HID_KEYMAP_READ(x_ptr)	pgm_read_byte(x_ptr)
+#else
+#	ifndef PROGMEM
+#		define PROGMEM
+#	endif
+#	define HID_KEYMAP_READ(x_ptr)	(*(const uint8_t *)(x_ptr))
+#endif
+
+
+#define HID_KEYMAP_SIZE				116
+#define HID_KEYMAP_PS2_MAKE_MAX		8
+#define HID_KEYMAP_PS2_BREAK_MAX	6
+
+#define HID_KEYMAP_PS2_UNKNOWN	0
+#define HID_KEYMAP_PS2_REG		1
+#define HID_KEYMAP_PS2_SPEC		2
+#define HID_KEYMAP_PS2_PRINT	3
+#define HID_KEYMAP_PS2_PAUSE	4
+
+
+// USB usage or the NicoHood modifier code 0xE0...0xE7, zero for unknown
+static const uint8_t hid_keymap_usb[HID_KEYMAP_SIZE] PROGMEM = {
+	0,
+	4, // KeyA
+	5, // KeyB
+	6, // KeyC
+	7, // KeyD
+	8, // KeyE
+	9, // KeyF
+	10, // KeyG
+	11, // KeyH
+	12, // KeyI
+	13, // KeyJ
+	14, // KeyK
+	15, // KeyL
+	16, // KeyM
+	17, // KeyN
+	18, // KeyO
+	19, // KeyP
+	20, // KeyQ
+	21, // KeyR
+	22, // KeyS
+	23, // KeyT
+	24, // KeyU
+	25, // KeyV
+	26, // KeyW
+	27, // KeyX
+	28, // KeyY
+	29, // KeyZ
+	30, // Digit1
+	31, // Digit2
+	32, // Digit3
+	33, // Digit4
+	34, // Digit5
+	35, // Digit6
+	36, // Digit7
+	37, // Digit8
+	38, // Digit9
+	39, // Digit0
+	40, // Enter
+	41, // Escape
+	42, // Backspace
+	43, // Tab
+	44, // Space
+	45, // Minus
+	46, // Equal
+	47, // BracketLeft
+	48, // BracketRight
+	49, // Backslash
+	51, // Semicolon
+	52, // Quote
+	53, // Backquote
+	54, // Comma
+	55, // Period
+	56, // Slash
+	57, // CapsLock
+	58, // F1
+	59, // F2
+	60, // F3
+	61, // F4
+	62, // F5
+	63, // F6
+	64, // F7
+	65, // F8
+	66, // F9
+	67, // F10
+	68, // F11
+	69, // F12
+	70, // PrintScreen
+	73, // Insert
+	74, // Home
+	75, // PageUp
+	76, // Delete
+	77, // End
+	78, // PageDown
+	79, // ArrowRight
+	80, // ArrowLeft
+	81, // ArrowDown
+	82, // ArrowUp
+	224, // ControlLeft
+	225, // ShiftLeft
+	226, // AltLeft
+	227, // MetaLeft
+	228, // ControlRight
+	229, // ShiftRight
+	230, // AltRight
+	231, // MetaRight
+	72, // Pause
+	71, // ScrollLock
+	83, // NumLock
+	101, // ContextMenu
+	84, // NumpadDivide
+	85, // NumpadMultiply
+	86, // NumpadSubtract
+	87, // NumpadAdd
+	88, // NumpadEnter
+	89, // Numpad1
+	90, // Numpad2
+	91, // Numpad3
+	92, // Numpad4
+	93, // Numpad5
+	94, // Numpad6
+	95, // Numpad7
+	96, // Numpad8
+	97, // Numpad9
+	98, // Numpad0
+	99, // NumpadDecimal
+	102, // Power
+	100, // IntlBackslash
+	137, // IntlYen
+	135, // IntlRo
+	136, // KanaMode
+	138, // Convert
+	139, // NonConvert
+	127, // AudioVolumeMute
+	128, // AudioVolumeUp
+	129, // AudioVolumeDown
+	111, // F20
+};
+
+static const uint8_t hid_keymap_ps2_type[HID_KEYMAP_SIZE] PROGMEM = {
+	HID_KEYMAP_PS2_UNKNOWN,
+	HID_KEYMAP_PS2_REG, // KeyA
+	HID_KEYMAP_PS2_REG, // KeyB
+	HID_KEYMAP_PS2_REG, // KeyC
+	HID_KEYMAP_PS2_REG, // KeyD
+	HID_KEYMAP_PS2_REG, // KeyE
+	HID_KEYMAP_PS2_REG, // KeyF
+	HID_KEYMAP_PS2_REG, // KeyG
+	HID_KEYMAP_PS2_REG, // KeyH
+	HID_KEYMAP_PS2_REG, // KeyI
+	HID_KEYMAP_PS2_REG, // KeyJ
+	HID_KEYMAP_PS2_REG, // KeyK
+	HID_KEYMAP_PS2_REG, // KeyL
+	HID_KEYMAP_PS2_REG, // KeyM
+	HID_KEYMAP_PS2_REG, // KeyN
+	HID_KEYMAP_PS2_REG, // KeyO
+	HID_KEYMAP_PS2_REG, // KeyP
+	HID_KEYMAP_PS2_REG, // KeyQ
+	HID_KEYMAP_PS2_REG, // KeyR
+	HID_KEYMAP_PS2_REG, // KeyS
+	HID_KEYMAP_PS2_REG, // KeyT
+	HID_KEYMAP_PS2_REG, // KeyU
+	HID_KEYMAP_PS2_REG, // KeyV
+	HID_KEYMAP_PS2_REG, // KeyW
+	HID_KEYMAP_PS2_REG, // KeyX
+	HID_KEYMAP_PS2_REG, // KeyY
+	HID_KEYMAP_PS2_REG, // KeyZ
+	HID_KEYMAP_PS2_REG, // Digit1
+	HID_KEYMAP_PS2_REG, // Digit2
+	HID_KEYMAP_PS2_REG, // Digit3
+	HID_KEYMAP_PS2_REG, // Digit4
+	HID_KEYMAP_PS2_REG, // Digit5
+	HID_KEYMAP_PS2_REG, // Digit6
+	HID_KEYMAP_PS2_REG, // Digit7
+	HID_KEYMAP_PS2_REG, // Digit8
+	HID_KEYMAP_PS2_REG, // Digit9
+	HID_KEYMAP_PS2_REG, // Digit0
+	HID_KEYMAP_PS2_REG, // Enter
+	HID_KEYMAP_PS2_REG, // Escape
+	HID_KEYMAP_PS2_REG, // Backspace
+	HID_KEYMAP_PS2_REG, // Tab
+	HID_KEYMAP_PS2_REG, // Space
+	HID_KEYMAP_PS2_REG, // Minus
+	HID_KEYMAP_PS2_REG, // Equal
+	HID_KEYMAP_PS2_REG, // BracketLeft
+	HID_KEYMAP_PS2_REG, // BracketRight
+	HID_KEYMAP_PS2_REG, // Backslash
+	HID_KEYMAP_PS2_REG, // Semicolon
+	HID_KEYMAP_PS2_REG, // Quote
+	HID_KEYMAP_PS2_REG, // Backquote
+	HID_KEYMAP_PS2_REG, // Comma
+	HID_KEYMAP_PS2_REG, // Period
+	HID_KEYMAP_PS2_REG, // Slash
+	HID_KEYMAP_PS2_REG, // CapsLock
+	HID_KEYMAP_PS2_REG, // F1
+	HID_KEYMAP_PS2_REG, // F2
+	HID_KEYMAP_PS2_REG, // F3
+	HID_KEYMAP_PS2_REG, // F4
+	HID_KEYMAP_PS2_REG, // F5
+	HID_KEYMAP_PS2_REG, // F6
+	HID_KEYMAP_PS2_REG, // F7
+	HID_KEYMAP_PS2_REG, // F8
+	HID_KEYMAP_PS2_REG, // F9
+	HID_KEYMAP_PS2_REG, // F10
+	HID_KEYMAP_PS2_REG, // F11
+	HID_KEYMAP_PS2_REG, // F12
+	HID_KEYMAP_PS2_PRINT, // PrintScreen
+	HID_KEYMAP_PS2_SPEC, // Insert
+	HID_KEYMAP_PS2_SPEC, // Home
+	HID_KEYMAP_PS2_SPEC, // PageUp
+	HID_KEYMAP_PS2_SPEC, // Delete
+	HID_KEYMAP_PS2_SPEC, // End
+	HID_KEYMAP_PS2_SPEC, // PageDown
+	HID_KEYMAP_PS2_SPEC, // ArrowRight
+	HID_KEYMAP_PS2_SPEC, // ArrowLeft
+	HID_KEYMAP_PS2_SPEC, // ArrowDown
+	HID_KEYMAP_PS2_SPEC, // ArrowUp
+	HID_KEYMAP_PS2_REG, // ControlLeft
+	HID_KEYMAP_PS2_REG, // ShiftLeft
+	HID_KEYMAP_PS2_REG, // AltLeft
+	HID_KEYMAP_PS2_SPEC, // MetaLeft
+	HID_KEYMAP_PS2_SPEC, // ControlRight
+	HID_KEYMAP_PS2_REG, // ShiftRight
+	HID_KEYMAP_PS2_SPEC, // AltRight
+	HID_KEYMAP_PS2_SPEC, // MetaRight
+	HID_KEYMAP_PS2_PAUSE, // Pause
+	HID_KEYMAP_PS2_REG, // ScrollLock
+	HID_KEYMAP_PS2_REG, // NumLock
+	HID_KEYMAP_PS2_SPEC, // ContextMenu
+	HID_KEYMAP_PS2_SPEC, // NumpadDivide
+	HID_KEYMAP_PS2_REG, // NumpadMultiply
+	HID_KEYMAP_PS2_REG, // NumpadSubtract
+	HID_KEYMAP_PS2_REG, // NumpadAdd
+	HID_KEYMAP_PS2_SPEC, // NumpadEnter
+	HID_KEYMAP_PS2_REG, // Numpad1
+	HID_KEYMAP_PS2_REG, // Numpad2
+	HID_KEYMAP_PS2_REG, // Numpad3
+	HID_KEYMAP_PS2_REG, // Numpad4
+	HID_KEYMAP_PS2_REG, // Numpad5
+	HID_KEYMAP_PS2_REG, // Numpad6
+	HID_KEYMAP_PS2_REG, // Numpad7
+	HID_KEYMAP_PS2_REG, // Numpad8
+	HID_KEYMAP_PS2_REG, // Numpad9
+	HID_KEYMAP_PS2_REG, // Numpad0
+	HID_KEYMAP_PS2_REG, // NumpadDecimal
+	HID_KEYMAP_PS2_SPEC, // Power
+	HID_KEYMAP_PS2_REG, // IntlBackslash
+	HID_KEYMAP_PS2_REG, // IntlYen
+	HID_KEYMAP_PS2_REG, // IntlRo
+	HID_KEYMAP_PS2_REG, // KanaMode
+	HID_KEYMAP_PS2_REG, // Convert
+	HID_KEYMAP_PS2_REG, // NonConvert
+	HID_KEYMAP_PS2_SPEC, // AudioVolumeMute
+	HID_KEYMAP_PS2_SPEC, // AudioVolumeUp
+	HID_KEYMAP_PS2_SPEC, // AudioVolumeDown
+	HID_KEYMAP_PS2_UNKNOWN,
+};
+
+// Set 2, the first byte is the length
+static const uint8_t hid_keymap_ps2_make[HID_KEYMAP_SIZE][HID_KEYMAP_PS2_MAKE_MAX + 1] PROGMEM = {
+	{0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+	{1, 0x1C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyA
+	{1, 0x32, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyB
+	{1, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyC
+	{1, 0x23, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyD
+	{1, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyE
+	{1, 0x2B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyF
+	{1, 0x34, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyG
+	{1, 0x33, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyH
+	{1, 0x43, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyI
+	{1, 0x3B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyJ
+	{1, 0x42, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyK
+	{1, 0x4B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyL
+	{1, 0x3A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyM
+	{1, 0x31, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyN
+	{1, 0x44, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyO
+	{1, 0x4D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyP
+	{1, 0x15, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyQ
+	{1, 0x2D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyR
+	{1, 0x1B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyS
+	{1, 0x2C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyT
+	{1, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyU
+	{1, 0x2A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyV
+	{1, 0x1D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyW
+	{1, 0x22, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyX
+	{1, 0x35, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyY
+	{1, 0x1A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KeyZ
+	{1, 0x16, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Digit1
+	{1, 0x1E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Digit2
+	{1, 0x26, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Digit3
+	{1, 0x25, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Digit4
+	{1, 0x2E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Digit5
+	{1, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Digit6
+	{1, 0x3D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Digit7
+	{1, 0x3E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Digit8
+	{1, 0x46, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Digit9
+	{1, 0x45, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Digit0
+	{1, 0x5A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Enter
+	{1, 0x76, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Escape
+	{1, 0x66, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Backspace
+	{1, 0x0D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Tab
+	{1, 0x29, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Space
+	{1, 0x4E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Minus
+	{1, 0x55, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Equal
+	{1, 0x54, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // BracketLeft
+	{1, 0x5B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // BracketRight
+	{1, 0x5D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Backslash
+	{1, 0x4C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Semicolon
+	{1, 0x52, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Quote
+	{1, 0x0E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Backquote
+	{1, 0x41, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Comma
+	{1, 0x49, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Period
+	{1, 0x4A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Slash
+	{1, 0x58, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // CapsLock
+	{1, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // F1
+	{1, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // F2
+	{1, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // F3
+	{1, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // F4
+	{1, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // F5
+	{1, 0x0B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // F6
+	{1, 0x83, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // F7
+	{1, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // F8
+	{1, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // F9
+	{1, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // F10
+	{1, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // F11
+	{1, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // F12
+	{4, 0xE0, 0x12, 0xE0, 0x7C, 0x00, 0x00, 0x00, 0x00}, // PrintScreen
+	{2, 0xE0, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Insert
+	{2, 0xE0, 0x6C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Home
+	{2, 0xE0, 0x7D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // PageUp
+	{2, 0xE0, 0x71, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Delete
+	{2, 0xE0, 0x69, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // End
+	{2, 0xE0, 0x7A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // PageDown
+	{2, 0xE0, 0x74, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ArrowRight
+	{2, 0xE0, 0x6B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ArrowLeft
+	{2, 0xE0, 0x72, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ArrowDown
+	{2, 0xE0, 0x75, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ArrowUp
+	{1, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ControlLeft
+	{1, 0x12, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ShiftLeft
+	{1, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // AltLeft
+	{2, 0xE0, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // MetaLeft
+	{2, 0xE0, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ControlRight
+	{1, 0x59, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ShiftRight
+	{2, 0xE0, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // AltRight
+	{2, 0xE0, 0x27, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // MetaRight
+	{8, 0xE1, 0x14, 0x77, 0xE1, 0xF0, 0x14, 0xF0, 0x77}, // Pause
+	{1, 0x7E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ScrollLock
+	{1, 0x77, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // NumLock
+	{2, 0xE0, 0x2F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ContextMenu
+	{2, 0xE0, 0x4A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // NumpadDivide
+	{1, 0x7C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // NumpadMultiply
+	{1, 0x7B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // NumpadSubtract
+	{1, 0x79, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // NumpadAdd
+	{2, 0xE0, 0x5A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // NumpadEnter
+	{1, 0x69, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Numpad1
+	{1, 0x72, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Numpad2
+	{1, 0x7A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Numpad3
+	{1, 0x6B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Numpad4
+	{1, 0x73, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Numpad5
+	{1, 0x74, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Numpad6
+	{1, 0x6C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Numpad7
+	{1, 0x75, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Numpad8
+	{1, 0x7D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Numpad9
+	{1, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Numpad0
+	{1, 0x71, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // NumpadDecimal
+	{2, 0xE0, 0x5E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Power
+	{1, 0x61, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // IntlBackslash
+	{1, 0x6A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // IntlYen
+	{1, 0x51, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // IntlRo
+	{1, 0x13, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // KanaMode
+	{1, 0x64, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Convert
+	{1, 0x67, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // NonConvert
+	{2, 0xE0, 0x23, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // AudioVolumeMute
+	{2, 0xE0, 0x32, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // AudioVolumeUp
+	{2, 0xE0, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // AudioVolumeDown
+	{0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+};
+
+static const uint8_t hid_keymap_ps2_break[HID_KEYMAP_SIZE][HID_KEYMAP_PS2_BREAK_MAX + 1] PROGMEM = {
+	{0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+	{2, 0xF0, 0x1C, 0x00, 0x00, 0x00, 0x00}, // KeyA
+	{2, 0xF0, 0x32, 0x00, 0x00, 0x00, 0x00}, // KeyB
+	{2, 0xF0, 0x21, 0x00, 0x00, 0x00, 0x00}, // KeyC
+	{2, 0xF0, 0x23, 0x00, 0x00, 0x00, 0x00}, // KeyD
+	{2, 0xF0, 0x24, 0x00, 0x00, 0x00, 0x00}, // KeyE
+	{2, 0xF0, 0x2B, 0x00, 0x00, 0x00, 0x00}, // KeyF
+	{2, 0xF0, 0x34, 0x00, 0x00, 0x00, 0x00}, // KeyG
+	{2, 0xF0, 0x33, 0x00, 0x00, 0x00, 0x00}, // KeyH
+	{2, 0xF0, 0x43, 0x00, 0x00, 0x00, 0x00}, // KeyI
+	{2, 0xF0, 0x3B, 0x00, 0x00, 0x00, 0x00}, // KeyJ
+	{2, 0xF0, 0x42, 0x00, 0x00, 0x00, 0x00}, // KeyK
+	{2, 0xF0, 0x4B, 0x00, 0x00, 0x00, 0x00}, // KeyL
+	{2, 0xF0, 0x3A, 0x00, 0x00, 0x00, 0x00}, // KeyM
+	{2, 0xF0, 0x31, 0x00, 0x00, 0x00, 0x00}, // KeyN
+	{2, 0xF0, 0x44, 0x00, 0x00, 0x00, 0x00}, // KeyO
+	{2, 0xF0, 0x4D, 0x00, 0x00, 0x00, 0x00}, // KeyP
+	{2, 0xF0, 0x15, 0x00, 0x00, 0x00, 0x00}, // KeyQ
+	{2, 0xF0, 0x2D, 0x00, 0x00, 0x00, 0x00}, // KeyR
+	{2, 0xF0, 0x1B, 0x00, 0x00, 0x00, 0x00}, // KeyS
+	{2, 0xF0, 0x2C, 0x00, 0x00, 0x00, 0x00}, // KeyT
+	{2, 0xF0, 0x3C, 0x00, 0x00, 0x00, 0x00}, // KeyU
+	{2, 0xF0, 0x2A, 0x00, 0x00, 0x00, 0x00}, // KeyV
+	{2, 0xF0, 0x1D, 0x00, 0x00, 0x00, 0x00}, // KeyW
+	{2, 0xF0, 0x22, 0x00, 0x00, 0x00, 0x00}, // KeyX
+	{2, 0xF0, 0x35, 0x00, 0x00, 0x00, 0x00}, // KeyY
+	{2, 0xF0, 0x1A, 0x00, 0x00, 0x00, 0x00}, // KeyZ
+	{2, 0xF0, 0x16, 0x00, 0x00, 0x00, 0x00}, // Digit1
+	{2, 0xF0, 0x1E, 0x00, 0x00, 0x00, 0x00}, // Digit2
+	{2, 0xF0, 0x26, 0x00, 0x00, 0x00, 0x00}, // Digit3
+	{2, 0xF0, 0x25, 0x00, 0x00, 0x00, 0x00}, // Digit4
+	{2, 0xF0, 0x2E, 0x00, 0x00, 0x00, 0x00}, // Digit5
+	{2, 0xF0, 0x36, 0x00, 0x00, 0x00, 0x00}, // Digit6
+	{2, 0xF0, 0x3D, 0x00, 0x00, 0x00, 0x00}, // Digit7
+	{2, 0xF0, 0x3E, 0x00, 0x00, 0x00, 0x00}, // Digit8
+	{2, 0xF0, 0x46, 0x00, 0x00, 0x00, 0x00}, // Digit9
+	{2, 0xF0, 0x45, 0x00, 0x00, 0x00, 0x00}, // Digit0
+	{2, 0xF0, 0x5A, 0x00, 0x00, 0x00, 0x00}, // Enter
+	{2, 0xF0, 0x76, 0x00, 0x00, 0x00, 0x00}, // Escape
+	{2, 0xF0, 0x66, 0x00, 0x00, 0x00, 0x00}, // Backspace
+	{2, 0xF0, 0x0D, 0x00, 0x00, 0x00, 0x00}, // Tab
+	{2, 0xF0, 0x29, 0x00, 0x00, 0x00, 0x00}, // Space
+	{2, 0xF0, 0x4E, 0x00, 0x00, 0x00, 0x00}, // Minus
+	{2, 0xF0, 0x55, 0x00, 0x00, 0x00, 0x00}, // Equal
+	{2, 0xF0, 0x54, 0x00, 0x00, 0x00, 0x00}, // BracketLeft
+	{2, 0xF0, 0x5B, 0x00, 0x00, 0x00, 0x00}, // BracketRight
+	{2, 0xF0, 0x5D, 0x00, 0x00, 0x00, 0x00}, // Backslash
+	{2, 0xF0, 0x4C, 0x00, 0x00, 0x00, 0x00}, // Semicolon
+	{2, 0xF0, 0x52, 0x00, 0x00, 0x00, 0x00}, // Quote
+	{2, 0xF0, 0x0E, 0x00, 0x00, 0x00, 0x00}, // Backquote
+	{2, 0xF0, 0x41, 0x00, 0x00, 0x00, 0x00}, // Comma
+	{2, 0xF0, 0x49, 0x00, 0x00, 0x00, 0x00}, // Period
+	{2, 0xF0, 0x4A, 0x00, 0x00, 0x00, 0x00}, // Slash
+	{2, 0xF0, 0x58, 0x00, 0x00, 0x00, 0x00}, // CapsLock
+	{2, 0xF0, 0x05, 0x00, 0x00, 0x00, 0x00}, // F1
+	{2, 0xF0, 0x06, 0x00, 0x00, 0x00, 0x00}, // F2
+	{2, 0xF0, 0x04, 0x00, 0x00, 0x00, 0x00}, // F3
+	{2, 0xF0, 0x0C, 0x00, 0x00, 0x00, 0x00}, // F4
+	{2, 0xF0, 0x03, 0x00, 0x00, 0x00, 0x00}, // F5
+	{2, 0xF0, 0x0B, 0x00, 0x00, 0x00, 0x00}, // F6
+	{2, 0xF0, 0x83, 0x00, 0x00, 0x00, 0x00}, // F7
+	{2, 0xF0, 0x0A, 0x00, 0x00, 0x00, 0x00}, // F8
+	{2, 0xF0, 0x01, 0x00, 0x00, 0x00, 0x00}, // F9
+	{2, 0xF0, 0x09, 0x00, 0x00, 0x00, 0x00}, // F10
+	{2, 0xF0, 0x78, 0x00, 0x00, 0x00, 0x00}, // F11
+	{2, 0xF0, 0x07, 0x00, 0x00, 0x00, 0x00}, // F12
+	{6, 0xE0, 0xF0, 0x7C, 0xE0, 0xF0, 0x12}, // PrintScreen
+	{3, 0xE0, 0xF0, 0x70, 0x00, 0x00, 0x00}, // Insert
+	{3, 0xE0, 0xF0, 0x6C, 0x00, 0x00, 0x00}, // Home
+	{3, 0xE0, 0xF0, 0x7D, 0x00, 0x00, 0x00}, // PageUp
+	{3, 0xE0, 0xF0, 0x71, 0x00, 0x00, 0x00}, // Delete
+	{3, 0xE0, 0xF0, 0x69, 0x00, 0x00, 0x00}, // End
+	{3, 0xE0, 0xF0, 0x7A, 0x00, 0x00, 0x00}, // PageDown
+	{3, 0xE0, 0xF0, 0x74, 0x00, 0x00, 0x00}, // ArrowRight
+	{3, 0xE0, 0xF0, 0x6B, 0x00, 0x00, 0x00}, // ArrowLeft
+	{3, 0xE0, 0xF0, 0x72, 0x00, 0x00, 0x00}, // ArrowDown
+	{3, 0xE0, 0xF0, 0x75, 0x00, 0x00, 0x00}, // ArrowUp
+	{2, 0xF0, 0x14, 0x00, 0x00, 0x00, 0x00}, // ControlLeft
+	{2, 0xF0, 0x12, 0x00, 0x00, 0x00, 0x00}, // ShiftLeft
+	{2, 0xF0, 0x11, 0x00, 0x00, 0x00, 0x00}, // AltLeft
+	{3, 0xE0, 0xF0, 0x1F, 0x00, 0x00, 0x00}, // MetaLeft
+	{3, 0xE0, 0xF0, 0x14, 0x00, 0x00, 0x00}, // ControlRight
+	{2, 0xF0, 0x59, 0x00, 0x00, 0x00, 0x00}, // ShiftRight
+	{3, 0xE0, 0xF0, 0x11, 0x00, 0x00, 0x00}, // AltRight
+	{3, 0xE0, 0xF0, 0x27, 0x00, 0x00, 0x00}, // MetaRight
+	{0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Pause
+	{2, 0xF0, 0x7E, 0x00, 0x00, 0x00, 0x00}, // ScrollLock
+	{2, 0xF0, 0x77, 0x00, 0x00, 0x00, 0x00}, // NumLock
+	{3, 0xE0, 0xF0, 0x2F, 0x00, 0x00, 0x00}, // ContextMenu
+	{3, 0xE0, 0xF0, 0x4A, 0x00, 0x00, 0x00}, // NumpadDivide
+	{2, 0xF0, 0x7C, 0x00, 0x00, 0x00, 0x00}, // NumpadMultiply
+	{2, 0xF0, 0x7B, 0x00, 0x00, 0x00, 0x00}, // NumpadSubtract
+	{2, 0xF0, 0x79, 0x00, 0x00, 0x00, 0x00}, // NumpadAdd
+	{3, 0xE0, 0xF0, 0x5A, 0x00, 0x00, 0x00}, // NumpadEnter
+	{2, 0xF0, 0x69, 0x00, 0x00, 0x00, 0x00}, // Numpad1
+	{2, 0xF0, 0x72, 0x00, 0x00, 0x00, 0x00}, // Numpad2
+	{2, 0xF0, 0x7A, 0x00, 0x00, 0x00, 0x00}, // Numpad3
+	{2, 0xF0, 0x6B, 0x00, 0x00, 0x00, 0x00}, // Numpad4
+	{2, 0xF0, 0x73, 0x00, 0x00, 0x00, 0x00}, // Numpad5
+	{2, 0xF0, 0x74, 0x00, 0x00, 0x00, 0x00}, // Numpad6
+	{2, 0xF0, 0x6C, 0x00, 0x00, 0x00, 0x00}, // Numpad7
+	{2, 0xF0, 0x75, 0x00, 0x00, 0x00, 0x00}, // Numpad8
+	{2, 0xF0, 0x7D, 0x00, 0x00, 0x00, 0x00}, // Numpad9
+	{2, 0xF0, 0x70, 0x00, 0x00, 0x00, 0x00}, // Numpad0
+	{2, 0xF0, 0x71, 0x00, 0x00, 0x00, 0x00}, // NumpadDecimal
+	{3, 0xE0, 0xF0, 0x5E, 0x00, 0x00, 0x00}, // Power
+	{2, 0xF0, 0x61, 0x00, 0x00, 0x00, 0x00}, // IntlBackslash
+	{2, 0xF0, 0x6A, 0x00, 0x00, 0x00, 0x00}, // IntlYen
+	{2, 0xF0, 0x51, 0x00, 0x00, 0x00, 0x00}, // IntlRo
+	{2, 0xF0, 0x13, 0x00, 0x00, 0x00, 0x00}, // KanaMode
+	{2, 0xF0, 0x64, 0x00, 0x00, 0x00, 0x00}, // Convert
+	{2, 0xF0, 0x67, 0x00, 0x00, 0x00, 0x00}, // NonConvert
+	{3, 0xE0, 0xF0, 0x23, 0x00, 0x00, 0x00}, // AudioVolumeMute
+	{3, 0xE0, 0xF0, 0x32, 0x00, 0x00, 0x00}, // AudioVolumeUp
+	{3, 0xE0, 0xF0, 0x21, 0x00, 0x00, 0x00}, // AudioVolumeDown
+	{0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+};
@@ -0,0 +1,103 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+// Общие таблицы для AVR, STM32 и Pico: код MCU - это просто индекс.
+// Сгенерировано из keymap.csv, не редактировать руками.
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __AVR__
+#	include <avr/pgmspace.h>
+#	define HID_KEYMAP_READ(x_ptr)	pgm_read_byte(x_ptr)
+#else
+#	ifndef PROGMEM
+#		define PROGMEM
+#	endif
+#	define HID_KEYMAP_READ(x_ptr)	(*(const uint8_t *)(x_ptr))
+#endif
+
+<%
+	by_code = {km.mcu_code: km for km in keymap}
+	size = max(by_code) + 1
+	ps2_keys = [km.ps2_key for km in keymap if km.ps2_key is not None]
+	make_max = max(len(key.make_sequence) for key in ps2_keys)
+	break_max = max(len(key.break_sequence) for key in ps2_keys)
+
+	def fmt_seq(seq, width):
+		return ", ".join(["%d" % len(seq)] + ["0x%02X" % byte for byte in seq + [0] * (width - len(seq))])
+%>
+#define HID_KEYMAP_SIZE				${size}
+#define HID_KEYMAP_PS2_MAKE_MAX		${make_max}
+#define HID_KEYMAP_PS2_BREAK_MAX	${break_max}
+
+#define HID_KEYMAP_PS2_UNKNOWN	0
+#define HID_KEYMAP_PS2_REG		1
+#define HID_KEYMAP_PS2_SPEC		2
+#define HID_KEYMAP_PS2_PRINT	3
+#define HID_KEYMAP_PS2_PAUSE	4
+
+
+// USB usage or the NicoHood modifier code 0xE0...0xE7, zero for unknown
+static const uint8_t hid_keymap_usb[HID_KEYMAP_SIZE] PROGMEM = {
+% for code in range(size):
+	% if code not in by_code:
+	0,
+	% elif by_code[code].usb_key.is_mod:
+	${by_code[code].usb_key.arduino_mod_code}, // ${by_code[code].web_name}
+	% else:
+	${by_code[code].usb_key.code}, // ${by_code[code].web_name}
+	% endif
+% endfor
+};
+
+static const uint8_t hid_keymap_ps2_type[HID_KEYMAP_SIZE] PROGMEM = {
+% for code in range(size):
+	% if code in by_code and by_code[code].ps2_key is not None:
+	HID_KEYMAP_PS2_${by_code[code].ps2_key.type.upper()}, // ${by_code[code].web_name}
+	% else:
+	HID_KEYMAP_PS2_UNKNOWN,
+	% endif
+% endfor
+};
+
+// Set 2, the first byte is the length
+static const uint8_t hid_keymap_ps2_make[HID_KEYMAP_SIZE][HID_KEYMAP_PS2_MAKE_MAX + 1] PROGMEM = {
+% for code in range(size):
+	% if code in by_code and by_code[code].ps2_key is not None:
+	{${fmt_seq(by_code[code].ps2_key.make_sequence, make_max)}}, // ${by_code[code].web_name}
+	% else:
+	{${fmt_seq([], make_max)}},
+	% endif
+% endfor
+};
+
+static const uint8_t hid_keymap_ps2_break[HID_KEYMAP_SIZE][HID_KEYMAP_PS2_BREAK_MAX + 1] PROGMEM = {
+% for code in range(size):
+	% if code in by_code and by_code[code].ps2_key is not None:
+	{${fmt_seq(by_code[code].ps2_key.break_sequence, break_max)}}, // ${by_code[code].web_name}
+	% else:
+	{${fmt_seq([], break_max)}},
+	% endif
+% endfor
+};
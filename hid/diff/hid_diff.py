@@ -0,0 +1,350 @@
+#!/usr/bin/env python3
+# ========================================================================== #
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+# ========================================================================== #
+
+
+import sys
+import os
+import csv
+import struct
+import difflib
+import argparse
+import subprocess
+import dataclasses
+
+
+# =====
+# Один и тот же поток кадров PiKVM-протокола прогоняется через хостовые сборки
+# прошивок (hid_replay для AVR и STM32, ph_replay для Pico), а их USB-отчеты
+# сводятся к тому, что видит хост: нажатия и отпускания клавиш и кнопок по порядку,
+# а между ними - итоговая позиция курсора, сумма относительных сдвигов и колеса.
+# Так разная нарезка движения на отчеты не считается расхождением, а потерянный
+# или лишний клик - считается. С --strict сравниваются сами отчеты.
+
+_ROOT_PATH = os.path.dirname(os.path.abspath(__file__))
+
+_TARGETS = {
+    "avr":   "../arduino/host/.build/hid_replay",
+    "stm32": "../arduino/host/.build/hid_replay_stm32",
+    "pico":  "../pico/host/.build/ph_replay",
+}
+
+# See kvmd/plugins/hid/_mcu/proto.py
+_KEYBOARD_OUTPUTS = {
+    "usb":      0b00000001,
+    "usb_nkro": 0b00000101,
+}
+_MOUSE_OUTPUTS = {
+    "usb":       0b00001000,
+    "usb_rel":   0b00010000,
+    "usb_win98": 0b00100000,
+}
+_MOUSE_BUTTONS = {  # Select, state and the main byte flag
+    "left":   (0b10000000, 0b00001000, True),
+    "right":  (0b01000000, 0b00000100, True),
+    "middle": (0b00100000, 0b00000010, True),
+    "up":     (0b10000000, 0b00001000, False),
+    "down":   (0b01000000, 0b00000100, False),
+}
+
+
+@dataclasses.dataclass
+class _Trace:
+    path: str
+    frames: list[tuple[int, bytes]] = dataclasses.field(default_factory=list)  # Offset in us and the whole frame
+    outputs: (int | None) = None
+    known: dict[str, str] = dataclasses.field(default_factory=dict)  # Target -> the reason of the difference
+
+
+@dataclasses.dataclass(frozen=True)
+class _Event:
+    ts: int
+    what: tuple
+
+    def __str__(self) -> str:
+        return f"{self.ts:>10}us  " + " ".join(map(str, self.what))
+
+
+# =====
+def _make_crc16(data: bytes) -> int:
+    crc = 0xFFFF
+    for byte in data:
+        crc = crc ^ byte
+        for _ in range(8):
+            if crc & 0x0001 == 0:
+                crc = crc >> 1
+            else:
+                crc = crc >> 1
+                crc = crc ^ 0xA001
+    return crc
+
+
+def _make_request(cmd: bytes) -> bytes:
+    assert len(cmd) == 5, cmd
+    request = b"\x33" + cmd
+    return request + struct.pack(">H", _make_crc16(request))
+
+
+def _read_keymap() -> dict[str, int]:
+    with open(os.path.join(_ROOT_PATH, "../../keymap.csv")) as file:
+        return {row["web_name"]: int(row["mcu_code"]) for row in csv.DictReader(file)}
+
+
+def _make_cmd(args: list[str], keymap: dict[str, int]) -> bytes:
+    match args:
+        case ["key", name, state]:
+            return struct.pack(">BBBxx", 0x11, keymap[name], int(state))
+        case ["button", name, state]:
+            (code, state_pressed, is_main) = _MOUSE_BUTTONS[name]
+            if int(state):
+                code |= state_pressed
+            return struct.pack(">BBBxx", 0x13, (code if is_main else 0), (0 if is_main else code))
+        case ["move", to_x, to_y]:
+            return struct.pack(">Bhh", 0x12, int(to_x), int(to_y))
+        case ["rel", delta_x, delta_y]:
+            return struct.pack(">Bbbxx", 0x15, int(delta_x), int(delta_y))
+        case ["wheel", delta_y]:
+            return struct.pack(">Bxbxx", 0x14, int(delta_y))
+        case ["clear"]:
+            return b"\x10\x00\x00\x00\x00"
+        case ["cmd", raw]:  # Any other command, 5 bytes in hex
+            return bytes.fromhex(raw)
+    raise ValueError("Unknown event")
+
+
+def _read_text_trace(path: str) -> _Trace:
+    # Строка - это пауза в миллисекундах от предыдущего события и само событие:
+    #   5 key KeyA 1 / button left 0 / move -32768 32767 / rel 5 -3 / wheel -1 / clear / cmd 0500000000
+    # и до событий - выходы и ожидаемые расхождения:
+    #   keyboard usb_nkro / mouse usb_rel / known stm32 <почему>
+    keymap = _read_keymap()
+    trace = _Trace(path)
+    keyboard = mouse = 0
+    ts = 0
+    with open(path) as file:
+        for (number, line) in enumerate(file, 1):
+            args = line.split("#", 1)[0].split()
+            try:
+                match args:
+                    case []:
+                        pass
+                    case ["keyboard", name]:
+                        keyboard = _KEYBOARD_OUTPUTS[name]
+                    case ["mouse", name]:
+                        mouse = _MOUSE_OUTPUTS[name]
+                    case ["known", target, *reason] if target in _TARGETS:
+                        trace.known[target] = " ".join(reason)
+                    case [delay, *event]:
+                        ts += int(float(delay) * 1000)
+                        trace.frames.append((ts, _make_request(_make_cmd(event, keymap))))
+            except (KeyError, ValueError, struct.error) as ex:
+                raise SystemExit(f"{path}:{number}: Invalid line: {line.strip()!r}: {type(ex).__name__} {ex}")
+    if keyboard or mouse:
+        trace.outputs = ((keyboard or _KEYBOARD_OUTPUTS["usb"]) | (mouse or _MOUSE_OUTPUTS["usb"]))
+    return trace
+
+
+def _read_kvmd_capture(path: str) -> _Trace:
+    # Запись kvmd с hid/capture/path, кадры те же, что отправил бы MCU-плагин
+    sys.path.insert(0, os.path.join(_ROOT_PATH, "../.."))
+    from evdev import ecodes  # pylint: disable=import-outside-toplevel
+    from kvmd.keyboard.mappings import EvdevModifiers  # pylint: disable=import-outside-toplevel
+    from kvmd.plugins.hid import _capture  # pylint: disable=import-outside-toplevel
+    from kvmd.plugins.hid._mcu import proto  # pylint: disable=import-outside-toplevel
+
+    trace = _Trace(path)
+    with open(path, "rb") as file:
+        for (ts, event, args) in _capture.read_capture(file):
+            events: list[proto.BaseEvent]
+            if event == _capture.EVENT_KEY:
+                (key, flags) = args
+                events = [proto.KeyEvent(key, bool(flags & 0x01))]
+                if (flags & 0x03) == 0x03 and key not in EvdevModifiers.ALL and key != ecodes.KEY_SYSRQ:
+                    events.append(proto.KeyEvent(key, False))  # Like BaseHid.send_key_event()
+            elif event == _capture.EVENT_MOUSE_BUTTON:
+                events = [proto.MouseButtonEvent(args[0], bool(args[1]))]
+            elif event == _capture.EVENT_MOUSE_MOVE:
+                events = [proto.MouseMoveEvent(*args)]
+            elif event == _capture.EVENT_MOUSE_RELATIVE:
+                events = [proto.MouseRelativeEvent(*args)]
+            elif event == _capture.EVENT_MOUSE_WHEEL:
+                events = [proto.MouseWheelEvent(*args)]
+            else:
+                events = [proto.ClearEvent()]
+            trace.frames.extend((ts, item.make_request()) for item in events)
+    return trace
+
+
+# =====
+def _run_target(name: str, path: str, trace: _Trace, settle_ms: int) -> list[_Event]:
+    cmd = [path, f"--settle-us={settle_ms * 1000}"]
+    if trace.outputs is not None:
+        cmd.append(f"--outputs={trace.outputs}")
+    frames = "".join(f"{ts} {frame.hex()}\n" for (ts, frame) in trace.frames)
+    try:
+        proc = subprocess.run(cmd, input=frames, capture_output=True, text=True, check=False)
+    except FileNotFoundError:
+        raise SystemExit(f"No runner for {name}: {path}; run make first")
+    if proc.returncode != 0:
+        raise SystemExit(f"Runner {name} failed on {trace.path}:\n{proc.stderr}")
+    reports: list[_Event] = []
+    for line in proc.stdout.splitlines():
+        (ts, *what) = line.split()
+        reports.append(_Event(int(ts), tuple(what)))
+    return reports
+
+
+def _make_events(reports: list[_Event]) -> list[_Event]:
+    events: list[_Event] = []
+    mods = 0
+    keys: set[int] = set()
+    buttons = 0
+    pos: (tuple[int, int] | None) = None
+    sent_pos: (tuple[int, int] | None) = None
+    rel = [0, 0]
+    wheel = 0
+    motion_ts = 0
+
+    def flush_motion() -> None:
+        nonlocal sent_pos, wheel
+        if pos != sent_pos and pos is not None:
+            events.append(_Event(motion_ts, ("move", *pos)))
+            sent_pos = pos
+        if rel != [0, 0]:
+            events.append(_Event(motion_ts, ("rel", *rel)))
+            rel[:] = [0, 0]
+        if wheel:
+            events.append(_Event(motion_ts, ("wheel", wheel)))
+            wheel = 0
+
+    for report in reports:
+        (kind, *fields) = report.what
+        changes: list[tuple] = []
+        if kind == "kbd":
+            new_mods = int(fields[0], 16)
+            new_keys = (set() if fields[1] == "-" else {int(key, 16) for key in fields[1].split(",")})
+            for bit in range(8):
+                if (mods ^ new_mods) & (1 << bit):
+                    changes.append(("mod", bit, ("+" if new_mods & (1 << bit) else "-")))
+            changes.extend(("key", f"0x{key:02X}", "-") for key in sorted(keys - new_keys))
+            changes.extend(("key", f"0x{key:02X}", "+") for key in sorted(new_keys - keys))
+            (mods, keys) = (new_mods, new_keys)
+        else:
+            new_buttons = int(fields[0], 16)
+            (x, y, delta) = map(int, fields[1:])
+            if kind == "abs":
+                if pos != (x, y):
+                    (pos, motion_ts) = ((x, y), report.ts)
+            elif x or y:
+                rel[0] += x
+                rel[1] += y
+                motion_ts = report.ts
+            if delta:
+                wheel += delta
+                motion_ts = report.ts
+            for bit in range(8):
+                if (buttons ^ new_buttons) & (1 << bit):
+                    changes.append(("button", bit, ("+" if new_buttons & (1 << bit) else "-")))
+            buttons = new_buttons
+        if changes:
+            flush_motion()  # Click exactly where the cursor is
+            events.extend(_Event(report.ts, change) for change in changes)
+    flush_motion()
+    return events
+
+
+def _compare(ref: list[_Event], other: list[_Event]) -> tuple[list[str], list[int]]:
+    diff: list[str] = []
+    latencies: list[int] = []
+    matcher = difflib.SequenceMatcher(a=[event.what for event in ref], b=[event.what for event in other], autojunk=False)
+    for (tag, ref_begin, ref_end, other_begin, other_end) in matcher.get_opcodes():
+        if tag == "equal":
+            for (ref_event, other_event) in zip(ref[ref_begin:ref_end], other[other_begin:other_end]):
+                latencies.append(other_event.ts - ref_event.ts)
+        else:
+            diff.extend(f"- {event}" for event in ref[ref_begin:ref_end])
+            diff.extend(f"+ {event}" for event in other[other_begin:other_end])
+    return (diff, latencies)
+
+
+def _format_latencies(latencies: list[int]) -> str:
+    if not latencies:
+        return ""
+    ordered = sorted(latencies)
+    pcts = ", ".join(f"p{pct} {ordered[min(len(ordered) * pct // 100, len(ordered) - 1)]:+d}us" for pct in (50, 99))
+    return f"timing {pcts}, max {max(ordered, key=abs):+d}us"
+
+
+# =====
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Replay the same input through the host builds of the HID firmwares and diff their USB reports")
+    parser.add_argument("traces", nargs="+", help="Text traces (see traces/) or kvmd captures (*.kvmdhidc)")
+    parser.add_argument("-t", "--targets", default=",".join(_TARGETS), help="Comma-separated list of the firmwares")
+    parser.add_argument("-r", "--reference", default="avr", choices=list(_TARGETS), help="The firmware to compare the others with")
+    parser.add_argument("--strict", action="store_true", help="Compare the reports as is, not the events they make")
+    parser.add_argument("--settle-ms", default=100, type=int, help="Run time after the last frame")
+    parser.add_argument("--context", default=20, type=int, help="How many differing events to show")
+    parser.add_argument("-d", "--dump", action="store_true", help="Print the events of each firmware")
+    options = parser.parse_args()
+
+    targets = options.targets.split(",")
+    for name in targets:
+        if name not in _TARGETS:
+            raise SystemExit(f"Unknown target: {name}")
+    others = [name for name in targets if name != options.reference]
+
+    failed = False
+    for path in options.traces:
+        trace = (_read_kvmd_capture(path) if path.endswith(".kvmdhidc") else _read_text_trace(path))
+        results: dict[str, list[_Event]] = {}
+        for name in [options.reference, *others]:
+            reports = _run_target(name, os.path.join(_ROOT_PATH, _TARGETS[name]), trace, options.settle_ms)
+            results[name] = (reports if options.strict else _make_events(reports))
+            if options.dump:
+                print(f"# {path} on {name}")
+                for event in results[name]:
+                    print(event)
+
+        print(f"{path}: {len(trace.frames)} frames, {len(results[options.reference])} {'reports' if options.strict else 'events'} on {options.reference}")
+        for name in others:
+            (diff, latencies) = _compare(results[options.reference], results[name])
+            known = trace.known.get(name)
+            if diff:
+                status = (f"DIFFERS (known: {known})" if known else "DIFFERS")
+            elif known:
+                status = "SAME, but a known difference is expected: drop the 'known' line?"
+            else:
+                status = "same"
+            print(f"    {name:<6} {status}  {_format_latencies(latencies)}".rstrip())
+            if diff and (not known or options.dump):
+                for line in diff[:options.context]:
+                    print(f"        {line}")
+                if len(diff) > options.context:
+                    print(f"        ... {len(diff) - options.context} more")
+            failed = (failed or bool(diff) != bool(known))
+
+    if failed:
+        raise SystemExit(1)
+
+
+# =====
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,132 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "ph_types.h"
+#include "ph_proto.h"
+#include "ph_outputs.h"
+#include "ph_host.h"
+
+
+// Пропускная способность пути "байты транспорта -> разбор кадра -> отчет".
+// Хост забирает USB-отчет на следующей итерации, а не раз в миллисекунду,
+// так что меряется сама прошивка, а не частота опроса. Время - настоящее.
+
+#define _DEFAULT_FRAMES	100000
+
+
+static u64 _now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000 + (u64)ts.tv_nsec;
+}
+
+static void _feed_keys(u32 frames) {
+	for (u32 index = 0; index < frames; ++index) {
+		const u8 key = 1 + (index / 2) % 26; // KeyA...KeyZ, press and release
+		ph_host_uart_feed_frame(PH_PROTO_CMD_KBD_KEY, key, !(index & 1), 0, 0);
+	}
+}
+
+static void _feed_mouse_abs(u32 frames) {
+	for (u32 index = 0; index < frames; ++index) {
+		const s16 x = (s16)(index * 37);
+		const s16 y = (s16)(index * 59);
+		ph_host_uart_feed_frame(PH_PROTO_CMD_MOUSE_ABS, (u16)x >> 8, x & 0xFF, (u16)y >> 8, y & 0xFF);
+	}
+}
+
+static void _feed_mouse_rel(u32 frames) {
+	for (u32 index = 0; index < frames; ++index) {
+		ph_host_uart_feed_frame(PH_PROTO_CMD_MOUSE_REL, 3, (u8)-2, 0, 0);
+	}
+}
+
+static void _feed_ping(u32 frames) {
+	for (u32 index = 0; index < frames; ++index) {
+		ph_host_uart_feed_frame(PH_PROTO_CMD_PING, 0, 0, 0, 0);
+	}
+}
+
+static void _feed_ch9329_keys(u32 frames) {
+	for (u32 index = 0; index < frames; ++index) {
+		u8 packet[14] = {0x57, 0xAB, 0x00, 0x02, 0x08, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+		packet[7] = ((index & 1) ? 0 : 4 + (index / 2) % 26);
+		for (u8 pos = 0; pos < 13; ++pos) {
+			packet[13] += packet[pos];
+		}
+		ph_host_uart_feed(packet, 14);
+	}
+}
+
+static void _run(const char *name, u8 outputs, void (*feed)(u32), u32 frames) {
+	fflush(stdout);
+	const pid_t pid = fork();
+	if (pid == 0) {
+		ph_outputs_write(0xFF, outputs, true);
+		ph_host_gpio_set(2, false); // PS/2 is enabled
+		ph_host_usb_set_poll_us(0);
+		ph_host_run(50000); // Boot and enumeration
+		ph_host_usb_reports_clear();
+		ph_host_ps2_events_clear();
+
+		feed(frames);
+		const u64 loops = ph_host_loops();
+		const u64 begin_ns = _now_ns();
+		ph_host_drain(0);
+		const u64 elapsed_ns = _now_ns() - begin_ns;
+
+		const u64 reports = ph_host_usb_reports_total() + ph_host_ps2_events_total();
+		printf("%-16s %9u %9lu %9.1f %9.1f %9.1f\n",
+			name, frames, (unsigned long)reports,
+			(double)elapsed_ns / frames,
+			(double)frames * 1000 / elapsed_ns,
+			(double)(ph_host_loops() - loops) / frames);
+		exit(0);
+	}
+	waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char **argv) {
+	const u32 frames = (argc > 1 ? (u32)atol(argv[1]) : _DEFAULT_FRAMES);
+	const u8 usb = PH_PROTO_OUT1_KBD_USB | PH_PROTO_OUT1_MOUSE_USB_ABS;
+	const u8 usb_nkro = PH_PROTO_OUT1_KBD_USB_NKRO | PH_PROTO_OUT1_MOUSE_USB_ABS;
+	const u8 usb_rel = PH_PROTO_OUT1_KBD_USB | PH_PROTO_OUT1_MOUSE_USB_REL;
+	const u8 ps2 = PH_PROTO_OUT1_KBD_PS2 | PH_PROTO_OUT1_MOUSE_PS2;
+
+	printf("%-16s %9s %9s %9s %9s %9s\n", "# scenario", "frames", "reports", "ns/frame", "Mframe/s", "loops/fr");
+	_run("ping", usb, _feed_ping, frames);
+	_run("usb_key", usb, _feed_keys, frames);
+	_run("usb_nkro_key", usb_nkro, _feed_keys, frames);
+	_run("usb_mouse_abs", usb, _feed_mouse_abs, frames);
+	_run("usb_mouse_rel", usb_rel, _feed_mouse_rel, frames);
+	_run("ps2_key", ps2, _feed_keys, frames);
+	_run("ps2_mouse_rel", ps2, _feed_mouse_rel, frames);
+	_run("ch9329_usb_key", usb, _feed_ch9329_keys, frames);
+	return 0;
+}
@@ -20,18 +20,24 @@
 *****************************************************************************/
 
 
+
 #pragma once
 
-<%! import operator %>
-uint8_t keymapUsb(uint8_t code) {
-	switch (code) {
-% for km in sorted(keymap, key=operator.attrgetter("mcu_code")):
-	% if km.usb_key.is_mod:
-		case ${km.mcu_code}: return ${km.usb_key.arduino_mod_code}; // ${km.web_name}
-	% else:
-		case ${km.mcu_code}: return ${km.usb_key.code}; // ${km.web_name}
-	% endif
-% endfor
-		default: return 0;
-	}
-}
+#include "pico.h"
+
+
+#define GPIO_OUT	1
+#define GPIO_IN		0
+
+enum gpio_function {
+	GPIO_FUNC_SPI = 1,
+	GPIO_FUNC_UART = 2,
+};
+
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_pull_up(uint gpio);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+void gpio_set_function(uint gpio, enum gpio_function fn);
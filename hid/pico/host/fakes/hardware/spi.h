@@ -0,0 +1,55 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+
+#pragma once
+
+#include "pico.h"
+
+
+typedef struct {
+	volatile uint32_t cr0;
+	volatile uint32_t cr1;
+	volatile uint32_t dr;
+	volatile uint32_t sr;
+	volatile uint32_t cpsr;
+	volatile uint32_t imsc;
+	volatile uint32_t ris;
+	volatile uint32_t mis;
+	volatile uint32_t icr;
+	volatile uint32_t dmacr;
+} spi_hw_t;
+
+typedef struct spi_inst spi_inst_t;
+
+#define spi0 ((spi_inst_t *)0)
+#define spi1 ((spi_inst_t *)1)
+
+typedef enum {SPI_CPOL_0 = 0, SPI_CPOL_1 = 1} spi_cpol_t;
+typedef enum {SPI_CPHA_0 = 0, SPI_CPHA_1 = 1} spi_cpha_t;
+typedef enum {SPI_LSB_FIRST = 0, SPI_MSB_FIRST = 1} spi_order_t;
+
+
+uint spi_init(spi_inst_t *spi, uint baudrate);
+void spi_set_slave(spi_inst_t *spi, bool slave);
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order);
+spi_hw_t *spi_get_hw(spi_inst_t *spi);
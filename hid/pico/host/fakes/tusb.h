@@ -0,0 +1,181 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+
+#pragma once
+
+// Только то, что нужно прошивке: дескрипторы собираются теми же макросами,
+// что и в TinyUSB, а стек заменен на ph_host.c
+
+#include "pico.h"
+
+#include "tusb_config.h"
+
+
+#define TUD_OPT_HIGH_SPEED	0
+
+#define TU_ATTR_PACKED		__attribute__((packed))
+#define TU_BIT(x_n)			(1UL << (x_n))
+#define TU_U16_LOW(x_v)		((uint8_t)((x_v) & 0xFF))
+#define TU_U16_HIGH(x_v)	((uint8_t)(((x_v) >> 8) & 0xFF))
+#define U16_TO_U8S_LE(x_v)	TU_U16_LOW(x_v), TU_U16_HIGH(x_v)
+
+#define HID_KEY_CONTROL_LEFT	0xE0
+#define HID_KEY_GUI_RIGHT		0xE7
+
+#define KEYBOARD_LED_NUMLOCK	0x01
+#define KEYBOARD_LED_CAPSLOCK	0x02
+#define KEYBOARD_LED_SCROLLLOCK	0x04
+
+#define MOUSE_BUTTON_LEFT		0x01
+#define MOUSE_BUTTON_RIGHT		0x02
+#define MOUSE_BUTTON_MIDDLE		0x04
+#define MOUSE_BUTTON_BACKWARD	0x08
+#define MOUSE_BUTTON_FORWARD	0x10
+
+typedef enum {
+	HID_REPORT_TYPE_INVALID = 0,
+	HID_REPORT_TYPE_INPUT,
+	HID_REPORT_TYPE_OUTPUT,
+	HID_REPORT_TYPE_FEATURE,
+} hid_report_type_t;
+
+enum {
+	HID_ITF_PROTOCOL_NONE = 0,
+	HID_ITF_PROTOCOL_KEYBOARD = 1,
+	HID_ITF_PROTOCOL_MOUSE = 2,
+};
+
+enum {
+	HID_PROTOCOL_BOOT = 0,
+	HID_PROTOCOL_REPORT = 1,
+};
+
+#define TUSB_DESC_DEVICE		0x01
+#define TUSB_DESC_CONFIGURATION	0x02
+#define TUSB_DESC_STRING		0x03
+#define TUSB_DESC_INTERFACE		0x04
+#define TUSB_DESC_ENDPOINT		0x05
+#define TUSB_DESC_INTERFACE_ASSOCIATION	0x0B
+#define TUSB_DESC_CS_INTERFACE	0x24
+
+#define TUSB_CLASS_CDC			0x02
+#define TUSB_CLASS_HID			0x03
+#define TUSB_CLASS_CDC_DATA		0x0A
+#define TUSB_CLASS_MISC			0xEF
+#define MISC_SUBCLASS_COMMON	0x02
+#define MISC_PROTOCOL_IAD		0x01
+
+#define TUSB_XFER_BULK			0x02
+#define TUSB_XFER_INTERRUPT		0x03
+
+#define HID_SUBCLASS_BOOT		0x01
+#define HID_DESC_TYPE_HID		0x21
+#define HID_DESC_TYPE_REPORT	0x22
+
+#define TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP	0x20
+
+#define TUD_CONFIG_DESC_LEN		(9)
+#define TUD_HID_DESC_LEN		(9 + 9 + 7)
+#define TUD_CDC_DESC_LEN		(8 + 9 + 5 + 5 + 4 + 5 + 7 + 9 + 7 + 7)
+
+#define TUD_CONFIG_DESCRIPTOR(x_config_num, x_itf_count, x_str_index, x_total_len, x_attr, x_power_ma) \
+	9, TUSB_DESC_CONFIGURATION, U16_TO_U8S_LE(x_total_len), x_itf_count, x_config_num, x_str_index, \
+	TU_BIT(7) | (x_attr), (x_power_ma) / 2
+
+#define TUD_HID_DESCRIPTOR(x_itf_num, x_str_index, x_boot_proto, x_report_desc_len, x_ep_in, x_ep_size, x_ep_interval) \
+	/* Interface */ \
+	9, TUSB_DESC_INTERFACE, x_itf_num, 0, 1, TUSB_CLASS_HID, \
+	(uint8_t)((x_boot_proto) ? HID_SUBCLASS_BOOT : 0), x_boot_proto, x_str_index, \
+	/* HID descriptor */ \
+	9, HID_DESC_TYPE_HID, U16_TO_U8S_LE(0x0111), 0, 1, HID_DESC_TYPE_REPORT, U16_TO_U8S_LE(x_report_desc_len), \
+	/* Endpoint In */ \
+	7, TUSB_DESC_ENDPOINT, x_ep_in, TUSB_XFER_INTERRUPT, U16_TO_U8S_LE(x_ep_size), x_ep_interval
+
+#define TUD_CDC_DESCRIPTOR(x_itf_num, x_str_index, x_ep_notif, x_ep_notif_size, x_ep_out, x_ep_in, x_ep_size) \
+	/* Interface Associate */ \
+	8, TUSB_DESC_INTERFACE_ASSOCIATION, x_itf_num, 2, TUSB_CLASS_CDC, 2, 0, 0, \
+	/* CDC Control Interface */ \
+	9, TUSB_DESC_INTERFACE, x_itf_num, 0, 1, TUSB_CLASS_CDC, 2, 0, x_str_index, \
+	/* CDC Header, Call, ACM, Union */ \
+	5, TUSB_DESC_CS_INTERFACE, 0, U16_TO_U8S_LE(0x0120), \
+	5, TUSB_DESC_CS_INTERFACE, 1, 0, (uint8_t)((x_itf_num) + 1), \
+	4, TUSB_DESC_CS_INTERFACE, 2, 6, \
+	5, TUSB_DESC_CS_INTERFACE, 6, x_itf_num, (uint8_t)((x_itf_num) + 1), \
+	/* Endpoint Notification */ \
+	7, TUSB_DESC_ENDPOINT, x_ep_notif, TUSB_XFER_INTERRUPT, U16_TO_U8S_LE(x_ep_notif_size), 16, \
+	/* CDC Data Interface */ \
+	9, TUSB_DESC_INTERFACE, (uint8_t)((x_itf_num) + 1), 0, 2, TUSB_CLASS_CDC_DATA, 0, 0, 0, \
+	/* Endpoint Out, In */ \
+	7, TUSB_DESC_ENDPOINT, x_ep_out, TUSB_XFER_BULK, U16_TO_U8S_LE(x_ep_size), 0, \
+	7, TUSB_DESC_ENDPOINT, x_ep_in, TUSB_XFER_BULK, U16_TO_U8S_LE(x_ep_size), 0
+
+typedef struct TU_ATTR_PACKED {
+	uint8_t		bLength;
+	uint8_t		bDescriptorType;
+	uint16_t	bcdUSB;
+	uint8_t		bDeviceClass;
+	uint8_t		bDeviceSubClass;
+	uint8_t		bDeviceProtocol;
+	uint8_t		bMaxPacketSize0;
+	uint16_t	idVendor;
+	uint16_t	idProduct;
+	uint16_t	bcdDevice;
+	uint8_t		iManufacturer;
+	uint8_t		iProduct;
+	uint8_t		iSerialNumber;
+	uint8_t		bNumConfigurations;
+} tusb_desc_device_t;
+
+
+bool tud_init(uint8_t rhport);
+void tud_task(void);
+bool tud_mounted(void);
+bool tud_suspended(void);
+bool tud_remote_wakeup(void);
+bool tud_connect(void);
+bool tud_disconnect(void);
+
+bool tud_hid_n_ready(uint8_t instance);
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, const void *report, uint16_t len);
+bool tud_hid_n_keyboard_report(uint8_t instance, uint8_t report_id, uint8_t modifier, const uint8_t keycode[6]);
+uint8_t tud_hid_n_get_protocol(uint8_t instance);
+
+bool tud_cdc_connected(void);
+void tud_cdc_write_clear(void);
+uint32_t tud_cdc_available(void);
+int32_t tud_cdc_read_char(void);
+uint32_t tud_cdc_write(const void *buffer, uint32_t size);
+uint32_t tud_cdc_write_flush(void);
+
+// Callbacks of the firmware
+const uint8_t *tud_descriptor_device_cb(void);
+const uint8_t *tud_descriptor_configuration_cb(uint8_t index);
+const uint16_t *tud_descriptor_string_cb(uint8_t index, uint16_t lang_id);
+const uint8_t *tud_hid_descriptor_report_cb(uint8_t iface);
+uint16_t tud_hid_get_report_cb(uint8_t iface, uint8_t report_id, hid_report_type_t report_type, uint8_t *buf, uint16_t len);
+void tud_hid_set_report_cb(uint8_t iface, uint8_t report_id, hid_report_type_t report_type, const uint8_t *buf, uint16_t len);
+void tud_hid_report_complete_cb(uint8_t iface, const uint8_t *report, uint16_t len);
+void tud_mount_cb(void);
+void tud_umount_cb(void);
+void tud_suspend_cb(bool remote_wakeup_en);
+void tud_resume_cb(void);
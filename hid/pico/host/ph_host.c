@@ -0,0 +1,623 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+
+#include "ph_host.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+#include "pico/stdlib.h"
+#include "pico/unique_id.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/spi.h"
+#include "hardware/uart.h"
+#include "hardware/watchdog.h"
+#include "hardware/structs/watchdog.h"
+
+#include "tusb.h"
+
+#include "ph_types.h"
+#include "ph_tools.h"
+#include "ph_proto.h"
+
+
+#define _GPIO_COUNT			30
+#define _USE_SPI_PIN		22 // See ph_com.c
+#define _FW_STACK_SIZE		(1024 * 1024)
+#define _USB_IFACES			8
+
+
+int ph_host_firmware_main(void); // main() of main.c
+
+
+static ucontext_t _host_ctx;
+static ucontext_t _fw_ctx;
+static bool _fw_started = false;
+
+static u64 _now_ts = 0;
+static u64 _loops = 0;
+static u64 _loop_us = PH_HOST_LOOP_US;
+static u64 _run_until_ts = 0;
+static bool _draining = false;
+static u64 _drain_us = 0;
+
+static bool _gpio[_GPIO_COUNT];
+static bool _gpio_inited = false;
+
+static u8 *_rx = NULL;
+static uz _rx_size = 0;
+static uz _rx_len = 0;
+static uz _rx_pos = 0;
+
+static u8 *_tx = NULL;
+static uz _tx_size = 0;
+static uz _tx_len = 0;
+
+static struct {
+	bool	connected;
+	bool	mounted;
+	bool	polling;
+	u64		poll_us;
+	bool	hid[_USB_IFACES];
+	u8		protocol[_USB_IFACES];
+	bool	busy[_USB_IFACES];
+	u64		busy_ts[_USB_IFACES];
+	u8		last[_USB_IFACES][PH_HOST_REPORT_SIZE];
+	u8		last_len[_USB_IFACES];
+	int		leds_iface; // -1 if nothing to deliver
+	u8		leds;
+} _usb = {
+	.polling = true,
+	.poll_us = PH_HOST_USB_POLL_US,
+	.protocol = {
+		HID_PROTOCOL_REPORT, HID_PROTOCOL_REPORT, HID_PROTOCOL_REPORT, HID_PROTOCOL_REPORT,
+		HID_PROTOCOL_REPORT, HID_PROTOCOL_REPORT, HID_PROTOCOL_REPORT, HID_PROTOCOL_REPORT,
+	},
+	.leds_iface = -1,
+};
+
+static ph_host_report_s _reports[PH_HOST_LOG_SIZE];
+static uz _reports_count = 0;
+static u64 _reports_total = 0;
+
+static bool _ps2_kbd_online = true;
+static bool _ps2_mouse_online = true;
+static ph_host_ps2_s _ps2_events[PH_HOST_LOG_SIZE];
+static uz _ps2_count = 0;
+static u64 _ps2_total = 0;
+
+static timer_hw_t _timer_hw = {0};
+timer_hw_t *timer_hw = &_timer_hw;
+
+static watchdog_hw_t _watchdog_hw = {0};
+watchdog_hw_t *watchdog_hw = &_watchdog_hw;
+
+static spi_hw_t _spi_hw = {0};
+
+
+static void _gpio_init_defaults(void);
+static void _fw_entry(void);
+static void _loop_tick(void);
+static void _buf_append(u8 **buf, uz *size, uz *len, const u8 *data, uz data_len);
+static void _usb_enumerate(void);
+static void _ps2_log(bool mouse, u8 a, u8 b, u8 c, u8 d);
+
+
+//--------------------------------------------------------------------
+// Harness
+//--------------------------------------------------------------------
+
+void ph_host_gpio_set(u8 pin, bool value) {
+	_gpio_init_defaults();
+	if (pin < _GPIO_COUNT) {
+		_gpio[pin] = value;
+	}
+}
+
+void ph_host_set_loop_us(u64 us) {
+	_loop_us = us;
+}
+
+void ph_host_run(u64 us) {
+	_run_until_ts = _now_ts + us;
+	_draining = false;
+	if (!_fw_started) {
+		static u8 *stack = NULL;
+		stack = malloc(_FW_STACK_SIZE);
+		getcontext(&_fw_ctx);
+		_fw_ctx.uc_stack.ss_sp = stack;
+		_fw_ctx.uc_stack.ss_size = _FW_STACK_SIZE;
+		_fw_ctx.uc_link = NULL;
+		makecontext(&_fw_ctx, _fw_entry, 0);
+		_fw_started = true;
+	}
+	swapcontext(&_host_ctx, &_fw_ctx);
+}
+
+void ph_host_drain(u64 us) {
+	ph_host_run(0);
+	while (_rx_pos < _rx_len) {
+		_draining = true;
+		_drain_us = us;
+		swapcontext(&_host_ctx, &_fw_ctx);
+	}
+	if (us > 0) {
+		ph_host_run(us);
+	}
+}
+
+u64 ph_host_now(void) {
+	return _now_ts;
+}
+
+u64 ph_host_loops(void) {
+	return _loops;
+}
+
+static void _gpio_init_defaults(void) {
+	if (!_gpio_inited) {
+		for (u8 index = 0; index < _GPIO_COUNT; ++index) {
+			_gpio[index] = true; // All switches are pulled up
+		}
+		_gpio_inited = true;
+	}
+}
+
+static void _fw_entry(void) {
+	ph_host_firmware_main();
+	abort(); // The firmware never returns
+}
+
+static void _loop_tick(void) {
+	_now_ts += _loop_us;
+	++_loops;
+	_timer_hw.timerawl = (u32)_now_ts;
+	_timer_hw.timerawh = (u32)(_now_ts >> 32);
+	if (_draining) {
+		if (_rx_pos < _rx_len) {
+			return;
+		}
+		_draining = false;
+		_run_until_ts = _now_ts + _drain_us;
+	}
+	if (_now_ts >= _run_until_ts) {
+		swapcontext(&_fw_ctx, &_host_ctx);
+	}
+}
+
+static void _buf_append(u8 **buf, uz *size, uz *len, const u8 *data, uz data_len) {
+	if (*len + data_len > *size) {
+		*size = (*len + data_len) * 2;
+		*buf = realloc(*buf, *size);
+		if (*buf == NULL) {
+			abort();
+		}
+	}
+	memcpy(*buf + *len, data, data_len);
+	*len += data_len;
+}
+
+
+//--------------------------------------------------------------------
+// UART
+//--------------------------------------------------------------------
+
+void ph_host_uart_feed(const u8 *data, uz len) {
+	if (_rx_pos == _rx_len) {
+		_rx_pos = 0;
+		_rx_len = 0;
+	}
+	_buf_append(&_rx, &_rx_size, &_rx_len, data, len);
+}
+
+void ph_host_uart_feed_frame(u8 cmd, u8 a, u8 b, u8 c, u8 d) {
+	u8 frame[8] = {PH_PROTO_MAGIC, cmd, a, b, c, d, 0, 0};
+	ph_split16(ph_crc16(frame, 6), &frame[6], &frame[7]);
+	ph_host_uart_feed(frame, 8);
+}
+
+uz ph_host_uart_pending(void) {
+	return _tx_len;
+}
+
+uz ph_host_uart_take(u8 *buf, uz size) {
+	const uz len = (size < _tx_len ? size : _tx_len);
+	memcpy(buf, _tx, len);
+	memmove(_tx, _tx + len, _tx_len - len);
+	_tx_len -= len;
+	return len;
+}
+
+uint uart_init(uart_inst_t *uart, uint baudrate) {
+	(void)uart;
+	return baudrate;
+}
+
+bool uart_is_readable(uart_inst_t *uart) {
+	(void)uart;
+	_loop_tick(); // Once per the main loop iteration
+	return (_rx_pos < _rx_len);
+}
+
+char uart_getc(uart_inst_t *uart) {
+	(void)uart;
+	return (_rx_pos < _rx_len ? (char)_rx[_rx_pos++] : 0);
+}
+
+void uart_write_blocking(uart_inst_t *uart, const uint8_t *src, size_t len) {
+	(void)uart;
+	_buf_append(&_tx, &_tx_size, &_tx_len, src, len);
+}
+
+void stdio_uart_init_full(uart_inst_t *uart, uint baud_rate, int tx_pin, int rx_pin) {
+	(void)uart;
+	(void)baud_rate;
+	(void)tx_pin;
+	(void)rx_pin;
+}
+
+
+//--------------------------------------------------------------------
+// USB
+//--------------------------------------------------------------------
+
+void ph_host_usb_set_poll_us(u64 us) {
+	_usb.poll_us = us;
+}
+
+void ph_host_usb_set_polling(bool polling) {
+	_usb.polling = polling;
+}
+
+void ph_host_usb_set_protocol(u8 iface, u8 protocol) {
+	if (iface < _USB_IFACES) {
+		_usb.protocol[iface] = protocol;
+	}
+}
+
+void ph_host_usb_set_leds(u8 iface, u8 leds) {
+	_usb.leds_iface = iface;
+	_usb.leds = leds;
+}
+
+bool ph_host_usb_is_mounted(void) {
+	return _usb.mounted;
+}
+
+const ph_host_report_s *ph_host_usb_reports(uz *count) {
+	*count = _reports_count;
+	return _reports;
+}
+
+u64 ph_host_usb_reports_total(void) {
+	return _reports_total;
+}
+
+void ph_host_usb_reports_clear(void) {
+	_reports_count = 0;
+	_reports_total = 0;
+}
+
+bool tud_init(uint8_t rhport) {
+	(void)rhport;
+	_usb.connected = true;
+	return true;
+}
+
+void tud_task(void) {
+	if (!_usb.connected) {
+		return;
+	}
+	if (!_usb.mounted) {
+		_usb_enumerate();
+		return;
+	}
+	for (u8 iface = 0; iface < _USB_IFACES; ++iface) {
+		if (_usb.busy[iface] && _usb.polling && _now_ts >= _usb.busy_ts[iface] + _usb.poll_us) {
+			_usb.busy[iface] = false;
+			tud_hid_report_complete_cb(iface, _usb.last[iface], _usb.last_len[iface]);
+		}
+	}
+	if (_usb.leds_iface >= 0) {
+		tud_hid_set_report_cb(_usb.leds_iface, 0, HID_REPORT_TYPE_OUTPUT, &_usb.leds, 1);
+		_usb.leds_iface = -1;
+	}
+}
+
+static void _usb_enumerate(void) {
+	// Как драйвер хоста: дескрипторы устройства, конфигурации, отчетов каждого HID и строки
+	tud_descriptor_device_cb();
+	const u8 *desc = tud_descriptor_configuration_cb(0);
+	const u16 total = desc[2] | ((u16)desc[3] << 8);
+	memset(_usb.hid, 0, sizeof(_usb.hid));
+	for (u16 offset = 0; offset < total && desc[offset] > 0; offset += desc[offset]) {
+		const u8 *part = desc + offset;
+		if (part[1] == TUSB_DESC_INTERFACE && part[5] == TUSB_CLASS_HID && part[2] < _USB_IFACES) {
+			_usb.hid[part[2]] = true;
+		}
+	}
+	for (u8 index = 0; index < 4; ++index) {
+		tud_descriptor_string_cb(index, 0x0409);
+	}
+	memset(_usb.busy, 0, sizeof(_usb.busy));
+	_usb.mounted = true;
+	tud_mount_cb(); // SET_CONFIGURATION, then the HID driver asks the report descriptors
+	for (u8 iface = 0; iface < _USB_IFACES; ++iface) {
+		if (_usb.hid[iface]) {
+			tud_hid_descriptor_report_cb(iface);
+		}
+	}
+}
+
+bool tud_mounted(void) {
+	return _usb.mounted;
+}
+
+bool tud_suspended(void) {
+	return false;
+}
+
+bool tud_remote_wakeup(void) {
+	return true;
+}
+
+bool tud_connect(void) {
+	_usb.connected = true;
+	return true;
+}
+
+bool tud_disconnect(void) {
+	_usb.connected = false;
+	if (_usb.mounted) {
+		_usb.mounted = false;
+		tud_umount_cb();
+	}
+	return true;
+}
+
+bool tud_hid_n_ready(uint8_t instance) {
+	return (_usb.mounted && instance < _USB_IFACES && _usb.hid[instance] && !_usb.busy[instance]);
+}
+
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, const void *report, uint16_t len) {
+	(void)report_id;
+	if (!tud_hid_n_ready(instance) || len > PH_HOST_REPORT_SIZE) {
+		return false;
+	}
+	_usb.busy[instance] = true;
+	_usb.busy_ts[instance] = _now_ts;
+	memcpy(_usb.last[instance], report, len);
+	_usb.last_len[instance] = len;
+
+	if (_reports_count < PH_HOST_LOG_SIZE) {
+		ph_host_report_s *const item = &_reports[_reports_count];
+		item->ts = _now_ts;
+		item->iface = instance;
+		item->len = len;
+		memcpy(item->data, report, len);
+		++_reports_count;
+	}
+	++_reports_total;
+	return true;
+}
+
+bool tud_hid_n_keyboard_report(uint8_t instance, uint8_t report_id, uint8_t modifier, const uint8_t keycode[6]) {
+	u8 report[8] = {modifier, 0};
+	memcpy(report + 2, keycode, 6);
+	return tud_hid_n_report(instance, report_id, report, 8);
+}
+
+uint8_t tud_hid_n_get_protocol(uint8_t instance) {
+	return (instance < _USB_IFACES ? _usb.protocol[instance] : HID_PROTOCOL_REPORT);
+}
+
+bool tud_cdc_connected(void) {
+	return false;
+}
+
+void tud_cdc_write_clear(void) {
+}
+
+uint32_t tud_cdc_available(void) {
+	return 0;
+}
+
+int32_t tud_cdc_read_char(void) {
+	return -1;
+}
+
+uint32_t tud_cdc_write(const void *buffer, uint32_t size) {
+	(void)buffer;
+	return size;
+}
+
+uint32_t tud_cdc_write_flush(void) {
+	return 0;
+}
+
+
+//--------------------------------------------------------------------
+// PS/2 (ps2x2pico)
+//--------------------------------------------------------------------
+
+void ph_host_ps2_set_online(bool kbd, bool mouse) {
+	_ps2_kbd_online = kbd;
+	_ps2_mouse_online = mouse;
+}
+
+const ph_host_ps2_s *ph_host_ps2_events(uz *count) {
+	*count = _ps2_count;
+	return _ps2_events;
+}
+
+u64 ph_host_ps2_events_total(void) {
+	return _ps2_total;
+}
+
+void ph_host_ps2_events_clear(void) {
+	_ps2_count = 0;
+	_ps2_total = 0;
+}
+
+static void _ps2_log(bool mouse, u8 a, u8 b, u8 c, u8 d) {
+	if (_ps2_count < PH_HOST_LOG_SIZE) {
+		ph_host_ps2_s *const item = &_ps2_events[_ps2_count];
+		item->ts = _now_ts;
+		item->mouse = mouse;
+		item->args[0] = a;
+		item->args[1] = b;
+		item->args[2] = c;
+		item->args[3] = d;
+		++_ps2_count;
+	}
+	++_ps2_total;
+}
+
+void kb_init(u8 gpio_out, u8 gpio_in) {
+	(void)gpio_out;
+	(void)gpio_in;
+}
+
+bool kb_task() {
+	return _ps2_kbd_online;
+}
+
+void kb_send_key(u8 key, bool state, u8 modifiers) {
+	_ps2_log(false, key, state, modifiers, 0);
+}
+
+void ms_init(u8 gpio_out, u8 gpio_in) {
+	(void)gpio_out;
+	(void)gpio_in;
+}
+
+bool ms_task() {
+	return _ps2_mouse_online;
+}
+
+void ms_send_movement(u8 buttons, s8 x, s8 y, s8 z) {
+	_ps2_log(true, buttons, x, y, z);
+}
+
+
+//--------------------------------------------------------------------
+// Pico SDK
+//--------------------------------------------------------------------
+
+uint64_t time_us_64(void) {
+	return _now_ts;
+}
+
+uint32_t time_us_32(void) {
+	return (u32)_now_ts;
+}
+
+void sleep_ms(uint32_t ms) {
+	_now_ts += (u64)ms * 1000;
+}
+
+void sleep_us(uint64_t us) {
+	_now_ts += us;
+}
+
+void gpio_init(uint gpio) {
+	(void)gpio;
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+	(void)gpio;
+	(void)out;
+}
+
+void gpio_pull_up(uint gpio) {
+	(void)gpio;
+}
+
+void gpio_put(uint gpio, bool value) {
+	(void)gpio;
+	(void)value;
+}
+
+bool gpio_get(uint gpio) {
+	if (gpio == _USE_SPI_PIN) {
+		return false; // The harness talks over UART only
+	}
+	_gpio_init_defaults();
+	return (gpio < _GPIO_COUNT ? _gpio[gpio] : true);
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+	(void)gpio;
+	(void)fn;
+}
+
+uint spi_init(spi_inst_t *spi, uint baudrate) {
+	(void)spi;
+	return baudrate;
+}
+
+void spi_set_slave(spi_inst_t *spi, bool slave) {
+	(void)spi;
+	(void)slave;
+}
+
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order) {
+	(void)spi;
+	(void)data_bits;
+	(void)cpol;
+	(void)cpha;
+	(void)order;
+}
+
+spi_hw_t *spi_get_hw(spi_inst_t *spi) {
+	(void)spi;
+	return &_spi_hw;
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+	(void)num;
+	(void)handler;
+}
+
+void irq_set_enabled(uint num, bool enabled) {
+	(void)num;
+	(void)enabled;
+}
+
+void watchdog_reboot(uint32_t pc, uint32_t sp, uint32_t delay_ms) {
+	(void)pc;
+	(void)sp;
+	(void)delay_ms;
+	abort(); // Nothing in the firmware reboots on purpose
+}
+
+bool watchdog_caused_reboot(void) {
+	return false;
+}
+
+void pico_get_unique_board_id_string(char *id_out, uint len) {
+	strncpy(id_out, "E6605C1234567890", len);
+	id_out[len - 1] = '\0';
+}
@@ -0,0 +1,84 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+
+#pragma once
+
+#include "ph_types.h"
+
+
+// Прошивка крутится в своем контексте (ucontext), а тест или бенчмарк
+// отдает ей управление через ph_host_run() и смотрит, что вышло наружу.
+// Время виртуальное: одна итерация main loop - PH_HOST_LOOP_US микросекунд.
+// Транспорт всегда UART, итерация заканчивается на опросе uart_is_readable().
+
+#define PH_HOST_LOOP_US			10
+#define PH_HOST_USB_POLL_US		1000 // Full-Speed host takes the report on the next frame
+#define PH_HOST_LOG_SIZE		1024 // Only the first entries are kept, the total is counted anyway
+#define PH_HOST_REPORT_SIZE		32
+
+
+typedef struct {
+	u64		ts;
+	u8		iface;
+	u8		len;
+	u8		data[PH_HOST_REPORT_SIZE];
+} ph_host_report_s;
+
+typedef struct {
+	u64		ts;
+	bool	mouse;
+	u8		args[4]; // Keyboard: key, state, modifiers; mouse: buttons, x, y, z
+} ph_host_ps2_s;
+
+
+// Before the first run
+void ph_host_gpio_set(u8 pin, bool value);
+void ph_host_set_loop_us(u64 us);
+
+// Firmware control
+void ph_host_run(u64 us);
+void ph_host_drain(u64 us); // Until the UART input is consumed, then the given time
+u64 ph_host_now(void);
+u64 ph_host_loops(void);
+
+// UART transport
+void ph_host_uart_feed(const u8 *data, uz len);
+void ph_host_uart_feed_frame(u8 cmd, u8 a, u8 b, u8 c, u8 d);
+uz ph_host_uart_pending(void);
+uz ph_host_uart_take(u8 *buf, uz size);
+
+// USB host
+void ph_host_usb_set_poll_us(u64 us);
+void ph_host_usb_set_polling(bool polling); // The host doesn't take the reports if false
+void ph_host_usb_set_protocol(u8 iface, u8 protocol);
+void ph_host_usb_set_leds(u8 iface, u8 leds); // Delivered by the next tud_task()
+bool ph_host_usb_is_mounted(void);
+const ph_host_report_s *ph_host_usb_reports(uz *count);
+u64 ph_host_usb_reports_total(void);
+void ph_host_usb_reports_clear(void);
+
+// PS/2 devices of ps2x2pico
+void ph_host_ps2_set_online(bool kbd, bool mouse);
+const ph_host_ps2_s *ph_host_ps2_events(uz *count);
+u64 ph_host_ps2_events_total(void);
+void ph_host_ps2_events_clear(void);
@@ -0,0 +1,210 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "ph_types.h"
+#include "ph_outputs.h"
+#include "ph_host.h"
+
+
+// Реплей потока кадров для ../../diff/hid_diff.py, см. ../../arduino/host/replay.cpp:
+// тот же вход, тот же вид отчетов и то же ожидание ответа на каждый кадр. Клавиатур может быть несколько (PH_USB_KBD_IFACES),
+// наружу идет их объединенное состояние.
+
+#define _STEP_US		1000 // Reports are taken between the steps, so the log never overflows
+#define _RESPONSE_STEP_US	10
+#define _RESPONSE_SIZE		4
+#define _RESPONSE_TIMEOUT_US	100000
+#define _MAX_FRAMES		(1024 * 1024)
+#define _KBD_IFACES		4
+
+
+typedef struct {
+	u64	ts;
+	u8	data[8];
+} _frame_s;
+
+static u64 _base_ts = 0;
+static u8 _kbd_mods[_KBD_IFACES] = {0};
+static u8 _kbd_bitmap[_KBD_IFACES][32] = {0};
+
+
+static void _help(void) {
+	printf("Usage: ph_replay [--outputs N] [--boot-us N] [--settle-us N] < frames.txt\n");
+}
+
+static _frame_s *_read_frames(FILE *file, uz *count) {
+	_frame_s *const frames = malloc(sizeof(_frame_s) * _MAX_FRAMES);
+	*count = 0;
+	char line[256];
+	for (unsigned number = 1; fgets(line, sizeof(line), file) != NULL; ++number) {
+		if (line[0] == '#' || line[0] == '\n') {
+			continue;
+		}
+		if (*count == _MAX_FRAMES) {
+			fprintf(stderr, "Too many frames\n");
+			exit(1);
+		}
+		_frame_s *const frame = &frames[*count];
+		unsigned long long ts;
+		unsigned values[8];
+		if (sscanf(line, "%llu %2x%2x%2x%2x%2x%2x%2x%2x", &ts,
+			&values[0], &values[1], &values[2], &values[3],
+			&values[4], &values[5], &values[6], &values[7]) != 9
+		) {
+			fprintf(stderr, "Invalid frame on line %u\n", number);
+			exit(1);
+		}
+		frame->ts = ts;
+		for (unsigned index = 0; index < 8; ++index) {
+			frame->data[index] = values[index];
+		}
+		++*count;
+	}
+	return frames;
+}
+
+static void _print_kbd(const ph_host_report_s *report) {
+	const u8 iface = (report->iface < _KBD_IFACES ? report->iface : 0);
+	u8 *const bitmap = _kbd_bitmap[iface];
+	memset(bitmap, 0, sizeof(_kbd_bitmap[iface]));
+	_kbd_mods[iface] = report->data[0];
+	if (report->len == 8) {
+		for (u8 index = 2; index < 8; ++index) {
+			const u8 key = report->data[index];
+			if (key > 0) {
+				bitmap[key >> 3] |= 1 << (key & 0x07);
+			}
+		}
+	} else { // NKRO: mods, reserved and the bitmap
+		const uz size = report->len - 2;
+		memcpy(bitmap, report->data + 2, (size < sizeof(_kbd_bitmap[iface]) ? size : sizeof(_kbd_bitmap[iface])));
+	}
+
+	u8 mods = 0;
+	for (u8 index = 0; index < _KBD_IFACES; ++index) {
+		mods |= _kbd_mods[index];
+	}
+	printf("kbd %02x ", mods);
+	bool first = true;
+	for (unsigned key = 1; key < 256; ++key) {
+		for (u8 index = 0; index < _KBD_IFACES; ++index) {
+			if (_kbd_bitmap[index][key >> 3] & (1 << (key & 0x07))) {
+				printf((first ? "%02x" : ",%02x"), key);
+				first = false;
+				break;
+			}
+		}
+	}
+	printf((first ? "-\n" : "\n"));
+}
+
+static void _flush(bool print) {
+	uz count;
+	const ph_host_report_s *const reports = ph_host_usb_reports(&count);
+	for (uz index = 0; print && index < count; ++index) {
+		const ph_host_report_s *const report = &reports[index];
+		const u8 *const data = report->data;
+		printf("%llu ", (unsigned long long)(report->ts - _base_ts));
+		switch (report->len) {
+			case 4:
+				printf("rel %02x %d %d %d\n", data[0], (s8)data[1], (s8)data[2], (s8)data[3]);
+				break;
+			case 6:
+				printf("abs %02x %u %u %d\n", data[0],
+					(unsigned)(data[1] | (data[2] << 8)), (unsigned)(data[3] | (data[4] << 8)), (s8)data[5]);
+				break;
+			default:
+				_print_kbd(report);
+		}
+	}
+	ph_host_usb_reports_clear();
+}
+
+static void _run_until(u64 ts) {
+	while (ph_host_now() < ts) {
+		const u64 left = ts - ph_host_now();
+		ph_host_run(left < _STEP_US ? left : _STEP_US);
+		_flush(true);
+	}
+}
+
+static void _wait_response(void) {
+	const u64 deadline = ph_host_now() + _RESPONSE_TIMEOUT_US;
+	uz received = 0;
+	while (received < _RESPONSE_SIZE && ph_host_now() < deadline) {
+		ph_host_run(_RESPONSE_STEP_US);
+		u8 buf[_RESPONSE_SIZE];
+		received += ph_host_uart_take(buf, sizeof(buf)); // Only the fact of the response matters
+		_flush(true);
+	}
+}
+
+
+//--------------------------------------------------------------------
+int main(int argc, char **argv) {
+	long outputs = -1;
+	u64 boot_us = 100000;
+	u64 settle_us = 100000;
+
+	const struct option opts[] = {
+		{"outputs",		required_argument,	NULL, 'o'},
+		{"boot-us",		required_argument,	NULL, 'b'},
+		{"settle-us",	required_argument,	NULL, 's'},
+		{"help",		no_argument,		NULL, 'h'},
+		{NULL, 0, NULL, 0},
+	};
+	for (int ch; (ch = getopt_long(argc, argv, "h", opts, NULL)) >= 0;) {
+		switch (ch) {
+			case 'o': outputs = strtol(optarg, NULL, 0); break;
+			case 'b': boot_us = strtoull(optarg, NULL, 10); break;
+			case 's': settle_us = strtoull(optarg, NULL, 10); break;
+			case 'h': _help(); return 0;
+			default: _help(); return 1;
+		}
+	}
+
+	uz count;
+	_frame_s *const frames = _read_frames(stdin, &count);
+
+	if (outputs >= 0) {
+		ph_outputs_write(0xFF, outputs, true); // Like the choice made before the reboot
+	}
+	ph_host_run(boot_us);
+	_flush(false);
+	u8 junk[64];
+	while (ph_host_uart_take(junk, sizeof(junk)) > 0);
+	_base_ts = ph_host_now();
+
+	for (uz index = 0; index < count; ++index) {
+		_run_until(_base_ts + frames[index].ts);
+		ph_host_uart_feed(frames[index].data, 8);
+		_wait_response();
+	}
+	_run_until(ph_host_now() + settle_us);
+	free(frames);
+	return 0;
+}
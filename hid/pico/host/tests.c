@@ -0,0 +1,688 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "tusb.h"
+
+#include "ph_types.h"
+#include "ph_tools.h"
+#include "ph_proto.h"
+#include "ph_outputs.h"
+#include "ph_host.h"
+
+
+#define _KEY_A			1 // MCU codes from hid-keymap.h
+#define _KEY_B			2
+#define _KEY_SHIFT_LEFT	78
+
+#define _MOUSE_IFACE	PH_USB_KBD_IFACES // After all keyboards in the boot layout
+
+#define CHECK(x_expr) { \
+		if (!(x_expr)) { \
+			fprintf(stderr, "    %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #x_expr); \
+			exit(1); \
+		} \
+	}
+
+
+static u8 _request(u8 cmd, u8 a, u8 b, u8 c, u8 d, u8 *resp) {
+	ph_host_uart_feed_frame(cmd, a, b, c, d);
+	ph_host_drain(PH_HOST_LOOP_US);
+	CHECK(ph_host_uart_take(resp, 8) == 8);
+	CHECK(resp[0] == PH_PROTO_MAGIC_RESP);
+	CHECK(ph_crc16(resp, 6) == ph_merge8_u16(resp[6], resp[7]));
+	return resp[1];
+}
+
+static u8 _ping(u8 *resp) {
+	return _request(PH_PROTO_CMD_PING, 0, 0, 0, 0, resp);
+}
+
+static u32 _get_stat(u8 index) {
+	u8 resp[8];
+	CHECK(_request(PH_PROTO_CMD_GET_STATS, index, 0, 0, 0, resp) == PH_PROTO_RESP_STATS);
+	return ((u32)resp[2] << 24) | ((u32)resp[3] << 16) | ((u32)resp[4] << 8) | (u32)resp[5];
+}
+
+static void _start(void) {
+	// Boot and let the host enumerate the device
+	ph_host_run(50000);
+	ph_host_usb_reports_clear();
+	ph_host_ps2_events_clear();
+	u8 junk[64];
+	while (ph_host_uart_take(junk, sizeof(junk)) > 0);
+}
+
+static const ph_host_report_s *_reports(uz expected) {
+	uz count;
+	const ph_host_report_s *const reports = ph_host_usb_reports(&count);
+	CHECK(count == expected);
+	return reports;
+}
+
+static void _check_kbd_report(const ph_host_report_s *report, u8 mods, u8 key0, u8 key1) {
+	const u8 expected[8] = {mods, 0, key0, key1, 0, 0, 0, 0};
+	CHECK(report->iface == 0);
+	CHECK(report->len == 8);
+	CHECK(!memcmp(report->data, expected, 8));
+}
+
+
+//--------------------------------------------------------------------
+// PiKVM protocol
+//--------------------------------------------------------------------
+
+static void test_ping(void) {
+	_start();
+	CHECK(ph_host_usb_is_mounted());
+	u8 resp[8];
+	CHECK(_ping(resp) == PH_PROTO_PONG_OK);
+	CHECK(resp[2] == (PH_PROTO_OUT1_DYNAMIC | PH_PROTO_OUT1_KBD_USB | PH_PROTO_OUT1_MOUSE_USB_ABS));
+	CHECK(resp[3] == (PH_PROTO_OUT2_HAS_USB | PH_PROTO_OUT2_HAS_USB_NKRO)); // W98 is disabled by the switch
+	CHECK(_get_stat(PH_PROTO_STAT_RX_FRAMES) == 2); // With the stats request itself
+}
+
+static void test_crc_error(void) {
+	_start();
+	const u8 frame[8] = {PH_PROTO_MAGIC, PH_PROTO_CMD_PING, 0, 0, 0, 0, 0xDE, 0xAD};
+	ph_host_uart_feed(frame, 8);
+	ph_host_drain(1000);
+	CHECK(ph_host_uart_pending() == 0); // Broken frames are not answered
+	CHECK(_get_stat(PH_PROTO_STAT_CRC_ERRORS) == 1);
+}
+
+static void test_invalid_command(void) {
+	_start();
+	u8 resp[8];
+	CHECK(_request(0x7F, 0, 0, 0, 0, resp) == PH_PROTO_RESP_INVALID_ERROR);
+	CHECK(_get_stat(PH_PROTO_STAT_INVALID_CMDS) == 1);
+}
+
+static void test_timeout(void) {
+	_start();
+	u8 resp[8];
+	_ping(resp);
+	const u8 part[3] = {PH_PROTO_MAGIC, PH_PROTO_CMD_PING, 0};
+	ph_host_uart_feed(part, 3);
+	ph_host_drain(200000);
+	CHECK(ph_host_uart_take(resp, 8) == 8);
+	CHECK(resp[1] == PH_PROTO_RESP_TIMEOUT_ERROR);
+	CHECK(_get_stat(PH_PROTO_STAT_RX_TIMEOUTS) == 1);
+}
+
+
+//--------------------------------------------------------------------
+// USB
+//--------------------------------------------------------------------
+
+static void test_usb_key(void) {
+	_start();
+	u8 resp[8];
+	_request(PH_PROTO_CMD_KBD_KEY, _KEY_A, 1, 0, 0, resp);
+	ph_host_run(2000);
+	_request(PH_PROTO_CMD_KBD_KEY, _KEY_A, 0, 0, 0, resp);
+	ph_host_run(2000);
+	const ph_host_report_s *const reports = _reports(2);
+	_check_kbd_report(&reports[0], 0, 4, 0);
+	_check_kbd_report(&reports[1], 0, 0, 0);
+}
+
+#if PH_USB_KBD_IFACES == 1
+static void test_usb_key_batches(void) {
+	// Быстрые события не склеиваются: одно нажатие на батч, модификатор отдельно
+	_start();
+	u8 resp[8];
+	_request(PH_PROTO_CMD_KBD_KEY, _KEY_SHIFT_LEFT, 1, 0, 0, resp);
+	_request(PH_PROTO_CMD_KBD_KEY, _KEY_A, 1, 0, 0, resp);
+	_request(PH_PROTO_CMD_KBD_KEY, _KEY_B, 1, 0, 0, resp);
+	_request(PH_PROTO_CMD_KBD_KEY, _KEY_A, 0, 0, 0, resp);
+	ph_host_run(10000);
+	const ph_host_report_s *const reports = _reports(4);
+	_check_kbd_report(&reports[0], 0x02, 0, 0);
+	_check_kbd_report(&reports[1], 0x02, 4, 0);
+	_check_kbd_report(&reports[2], 0x02, 4, 5);
+	_check_kbd_report(&reports[3], 0x02, 0, 5);
+	for (u8 index = 1; index < 4; ++index) {
+		CHECK(reports[index].ts - reports[index - 1].ts >= PH_HOST_USB_POLL_US);
+	}
+}
+#endif
+
+static void test_usb_leds(void) {
+	_start();
+	ph_host_usb_set_leds(0, KEYBOARD_LED_CAPSLOCK | KEYBOARD_LED_NUMLOCK);
+	ph_host_run(100);
+	u8 resp[8];
+	_ping(resp);
+	CHECK(resp[1] == (PH_PROTO_PONG_OK | PH_PROTO_PONG_CAPS | PH_PROTO_PONG_NUM));
+}
+
+static void test_usb_kbd_offline(void) {
+	_start();
+	ph_host_usb_set_polling(false);
+	u8 resp[8];
+	_request(PH_PROTO_CMD_KBD_KEY, _KEY_A, 1, 0, 0, resp);
+	ph_host_run(100000);
+	_request(PH_PROTO_CMD_KBD_KEY, _KEY_A, 0, 0, 0, resp); // The timeout is checked on the next report
+	CHECK(resp[1] & PH_PROTO_PONG_KBD_OFFLINE);
+	ph_host_usb_set_polling(true);
+	ph_host_run(10000);
+	_ping(resp);
+	CHECK(!(resp[1] & PH_PROTO_PONG_KBD_OFFLINE));
+}
+
+static void test_usb_kbd_report_fails(void) {
+	// Повторы неотправленного отчета не считаются, только потеря состояния
+	_start();
+	ph_host_usb_set_polling(false);
+	u8 resp[8];
+	_request(PH_PROTO_CMD_KBD_KEY, _KEY_A, 1, 0, 0, resp);
+	ph_host_run(100000);
+	_request(PH_PROTO_CMD_KBD_KEY, _KEY_B, 1, 0, 0, resp); // Retried while the endpoint is busy
+	ph_host_run(100000);
+	CHECK(_get_stat(PH_PROTO_STAT_REPORT_FAILS) == 0);
+	for (u8 index = 0; index <= 64; ++index) { // One more than the queue size
+		_request(PH_PROTO_CMD_KBD_KEY, _KEY_A, (index & 1), 0, 0, resp);
+	}
+	CHECK(_get_stat(PH_PROTO_STAT_REPORT_FAILS) == 1); // The queue has been collapsed
+	ph_host_usb_set_polling(true);
+	ph_host_run(100000);
+	CHECK(_get_stat(PH_PROTO_STAT_REPORT_FAILS) == 1);
+}
+
+static void test_usb_mouse_abs(void) {
+	_start();
+	u8 resp[8];
+	_request(PH_PROTO_CMD_MOUSE_ABS, 0x80, 0x00, 0x7F, 0xFF, resp); // -32768, 32767
+	ph_host_run(2000);
+	const ph_host_report_s *const reports = _reports(1);
+	const u8 expected[6] = {0, 0x00, 0x00, 0xFF, 0x7F, 0}; // Buttons, x and y little-endian, wheel
+	CHECK(reports[0].iface == _MOUSE_IFACE);
+	CHECK(reports[0].len == 6);
+	CHECK(!memcmp(reports[0].data, expected, 6));
+}
+
+static u16 _abs_report_x(const ph_host_report_s *report) {
+	return report->data[1] | ((u16)report->data[2] << 8);
+}
+
+static void test_usb_mouse_interp(void) {
+	_start();
+	u8 resp[8];
+	_request(PH_PROTO_CMD_SET_MOUSE_INTERP, 20, 0, 0, 0, resp);
+
+	// После долгой паузы ход занимает не больше look-ahead и идет мелкими шагами
+	_request(PH_PROTO_CMD_MOUSE_ABS, 0x40, 0x00, 0, 0, resp); // 16384
+	ph_host_run(40000);
+	uz count;
+	const ph_host_report_s *reports = ph_host_usb_reports(&count);
+	CHECK(count > 5);
+	for (uz index = 1; index < count; ++index) {
+		CHECK(_abs_report_x(&reports[index]) > _abs_report_x(&reports[index - 1]));
+	}
+	CHECK(_abs_report_x(&reports[count - 1]) == (16384 + 32768) / 2);
+	CHECK(reports[count - 1].ts - reports[0].ts <= 20000);
+
+	// Новая точка посреди хода: движение продолжается от выданной позиции, к старой цели не прыгает
+	ph_host_usb_reports_clear();
+	_request(PH_PROTO_CMD_MOUSE_ABS, 0x00, 0x00, 0, 0, resp);
+	ph_host_run(5000);
+	_request(PH_PROTO_CMD_MOUSE_ABS, 0x40, 0x00, 0, 0, resp);
+	ph_host_run(40000);
+	reports = ph_host_usb_reports(&count);
+	CHECK(count > 2);
+	for (uz index = 0; index < count; ++index) {
+		CHECK(_abs_report_x(&reports[index]) > 32768 / 2);
+	}
+	CHECK(_abs_report_x(&reports[count - 1]) == (16384 + 32768) / 2);
+
+	// Кнопка сбрасывает интерполяцию: клик ровно в последней точке хоста
+	ph_host_usb_reports_clear();
+	_request(PH_PROTO_CMD_MOUSE_ABS, 0x00, 0x00, 0, 0, resp);
+	ph_host_run(5000);
+	_request(PH_PROTO_CMD_MOUSE_BUTTON, PH_PROTO_CMD_MOUSE_LEFT_SELECT | PH_PROTO_CMD_MOUSE_LEFT_STATE, 0, 0, 0, resp);
+	ph_host_run(40000);
+	reports = ph_host_usb_reports(&count);
+	CHECK(count >= 2);
+	CHECK(reports[count - 1].data[0] == 1); // Left button
+	CHECK(_abs_report_x(&reports[count - 1]) == 32768 / 2);
+	for (uz index = 0; index < count - 1; ++index) {
+		CHECK(reports[index].data[0] == 0);
+	}
+}
+
+static void test_usb_mouse_rel_switch(void) {
+	// Переключение выхода на лету: переподключение с новым дескриптором без ресета
+	_start();
+	u8 resp[8];
+	_request(PH_PROTO_CMD_SET_MOUSE, PH_PROTO_OUT1_MOUSE_USB_REL, 0, 0, 0, resp);
+	CHECK(resp[2] == (PH_PROTO_OUT1_DYNAMIC | PH_PROTO_OUT1_KBD_USB | PH_PROTO_OUT1_MOUSE_USB_REL));
+	CHECK(!ph_host_usb_is_mounted());
+	ph_host_run(200000);
+	CHECK(ph_host_usb_is_mounted());
+	ph_host_usb_reports_clear();
+	_request(PH_PROTO_CMD_MOUSE_REL, 5, (u8)-3, 0, 0, resp);
+	ph_host_run(2000);
+	const ph_host_report_s *const reports = _reports(1);
+	const u8 expected[4] = {0, 5, (u8)-3, 0};
+	CHECK(reports[0].iface == _MOUSE_IFACE);
+	CHECK(reports[0].len == 4);
+	CHECK(!memcmp(reports[0].data, expected, 4));
+}
+
+static void test_usb_nkro_mouse(void) {
+	// NKRO всегда одна клавиатура, мышь сразу за ней при любом PH_USB_KBD_IFACES
+	ph_outputs_write(0xFF, PH_PROTO_OUT1_KBD_USB_NKRO | PH_PROTO_OUT1_MOUSE_USB_ABS, true);
+	_start();
+	u8 resp[8];
+	for (u8 index = 0; index < 3; ++index) {
+		_request(PH_PROTO_CMD_MOUSE_ABS, index, 0, index, 0, resp);
+		ph_host_run(60000); // Longer than the report timeout
+	}
+	const ph_host_report_s *const reports = _reports(3);
+	for (u8 index = 0; index < 3; ++index) {
+		CHECK(reports[index].iface == 1);
+		CHECK(index == 0 || memcmp(reports[index].data, reports[index - 1].data, reports[index].len));
+	}
+	_ping(resp);
+	CHECK(resp[1] == PH_PROTO_PONG_OK);
+}
+
+#if PH_USB_KBD_IFACES > 1
+static void test_usb_kbd_stripes(void) {
+	// Нажатия одного батча расходятся по клавиатурам, следующий батч ждет завершения на всех.
+	// Если бы завершение второй клавиатуры потерялось, через таймаут она выпала бы из used.
+	_start();
+	u8 resp[8];
+	for (u8 round = 0; round < 2; ++round) {
+		ph_host_usb_reports_clear();
+		_request(PH_PROTO_CMD_KBD_KEY, _KEY_SHIFT_LEFT, 1, 0, 0, resp);
+		_request(PH_PROTO_CMD_KBD_KEY, _KEY_A, 1, 0, 0, resp);
+		_request(PH_PROTO_CMD_KBD_KEY, _KEY_B, 1, 0, 0, resp);
+		_request(PH_PROTO_CMD_MOUSE_ABS, round, 0, round, 0, resp);
+		_request(PH_PROTO_CMD_KBD_KEY, _KEY_A, 0, 0, 0, resp);
+		_request(PH_PROTO_CMD_KBD_KEY, _KEY_B, 0, 0, 0, resp);
+		_request(PH_PROTO_CMD_KBD_KEY, _KEY_SHIFT_LEFT, 0, 0, 0, resp);
+		ph_host_run(60000); // Longer than the report timeout
+
+		uz count;
+		const ph_host_report_s *const reports = ph_host_usb_reports(&count);
+		const ph_host_report_s *kbd[2][4] = {0};
+		uz kbd_count[2] = {0};
+		uz mouse_count = 0;
+		for (uz index = 0; index < count; ++index) {
+			const u8 iface = reports[index].iface;
+			if (iface == _MOUSE_IFACE) {
+				++mouse_count;
+			} else {
+				CHECK(iface < 2);
+				CHECK(kbd_count[iface] < 4);
+				kbd[iface][kbd_count[iface]++] = &reports[index];
+			}
+		}
+		CHECK(mouse_count == 1);
+		CHECK(kbd_count[0] == 4);
+		CHECK(kbd_count[1] == 2);
+
+		_check_kbd_report(kbd[0][0], 0x02, 0, 0);
+		_check_kbd_report(kbd[0][1], 0x02, 4, 0);
+		_check_kbd_report(kbd[0][2], 0x02, 0, 0); // A and B released together, Shift goes alone
+		_check_kbd_report(kbd[0][3], 0x00, 0, 0);
+		const u8 press_b[8] = {0, 0, 5, 0, 0, 0, 0, 0};
+		const u8 release[8] = {0};
+		CHECK(kbd[1][0]->len == 8);
+		CHECK(!memcmp(kbd[1][0]->data, press_b, 8));
+		CHECK(!memcmp(kbd[1][1]->data, release, 8));
+		CHECK(kbd[1][0]->ts == kbd[0][1]->ts); // Striped
+		CHECK(kbd[1][1]->ts == kbd[0][2]->ts);
+		for (u8 index = 1; index < 4; ++index) {
+			CHECK(kbd[0][index]->ts - kbd[0][index - 1]->ts >= PH_HOST_USB_POLL_US);
+		}
+
+		_ping(resp);
+		CHECK(resp[1] == PH_PROTO_PONG_OK);
+	}
+}
+
+static void test_usb_kbd_stripes_nkro(void) {
+	// В NKRO одна клавиатура: нажатия не расходятся, а идут по одному на батч
+	ph_outputs_write(0xFF, PH_PROTO_OUT1_KBD_USB_NKRO | PH_PROTO_OUT1_MOUSE_USB_ABS, true);
+	_start();
+	u8 resp[8];
+	_request(PH_PROTO_CMD_KBD_KEY, _KEY_A, 1, 0, 0, resp);
+	_request(PH_PROTO_CMD_KBD_KEY, _KEY_B, 1, 0, 0, resp);
+	_request(PH_PROTO_CMD_MOUSE_ABS, 0, 0, 0, 0, resp);
+	ph_host_run(10000);
+
+	uz count;
+	const ph_host_report_s *const reports = ph_host_usb_reports(&count);
+	const ph_host_report_s *kbd[2] = {0};
+	uz kbd_count = 0;
+	uz mouse_count = 0;
+	for (uz index = 0; index < count; ++index) {
+		if (reports[index].iface == 1) {
+			++mouse_count;
+		} else {
+			CHECK(reports[index].iface == 0);
+			CHECK(kbd_count < 2);
+			kbd[kbd_count++] = &reports[index];
+		}
+	}
+	CHECK(mouse_count == 1);
+	CHECK(kbd_count == 2);
+	CHECK(kbd[0]->data[2] == (1 << 4)); // Bitmap: A, then A and B
+	CHECK(kbd[1]->data[2] == ((1 << 4) | (1 << 5)));
+	CHECK(kbd[1]->ts - kbd[0]->ts >= PH_HOST_USB_POLL_US);
+
+	_ping(resp);
+	CHECK(resp[1] == PH_PROTO_PONG_OK);
+}
+#endif
+
+
+//--------------------------------------------------------------------
+// PS/2
+//--------------------------------------------------------------------
+
+static void _start_ps2(void) {
+	ph_outputs_write(0xFF, PH_PROTO_OUT1_KBD_PS2 | PH_PROTO_OUT1_MOUSE_PS2, true);
+	ph_host_gpio_set(2, false); // PS/2 is enabled
+	_start();
+}
+
+static void test_ps2_key(void) {
+	_start_ps2();
+	u8 resp[8];
+	_ping(resp);
+	CHECK(resp[2] == (PH_PROTO_OUT1_DYNAMIC | PH_PROTO_OUT1_KBD_PS2 | PH_PROTO_OUT1_MOUSE_PS2));
+	CHECK(!ph_host_usb_is_mounted());
+	_request(PH_PROTO_CMD_KBD_KEY, _KEY_A, 1, 0, 0, resp);
+	_request(PH_PROTO_CMD_KBD_KEY, _KEY_A, 0, 0, 0, resp);
+	ph_host_run(20000);
+	uz count;
+	const ph_host_ps2_s *const events = ph_host_ps2_events(&count);
+	CHECK(count == 2);
+	CHECK(!events[0].mouse && events[0].args[0] == 4 && events[0].args[1] == 1);
+	CHECK(!events[1].mouse && events[1].args[0] == 4 && events[1].args[1] == 0);
+	CHECK(events[1].ts - events[0].ts >= 3300); // Paced like a real keyboard
+}
+
+static void test_ps2_mouse_accumulates(void) {
+	_start_ps2();
+	u8 resp[8];
+	for (u8 index = 0; index < 3; ++index) {
+		_request(PH_PROTO_CMD_MOUSE_REL, 100, 0, 0, 0, resp);
+	}
+	ph_host_run(30000);
+	uz count;
+	const ph_host_ps2_s *const events = ph_host_ps2_events(&count);
+	int sum = 0;
+	for (uz index = 0; index < count; ++index) {
+		CHECK(events[index].mouse);
+		sum += (s8)events[index].args[1];
+	}
+	CHECK(count == 3); // 300 doesn't fit into one packet
+	CHECK(sum == 300);
+}
+
+
+//--------------------------------------------------------------------
+// CH9329
+//--------------------------------------------------------------------
+
+static void _ch9329_request(u8 cmd, const u8 *data, u8 len, u8 *reply, uz reply_len) {
+	u8 packet[5 + 64 + 1] = {0x57, 0xAB, 0x00, cmd, len};
+	memcpy(packet + 5, data, len);
+	for (u8 index = 0; index < 5 + len; ++index) {
+		packet[5 + len] += packet[index];
+	}
+	ph_host_uart_feed(packet, 5 + len + 1);
+	ph_host_drain(2000);
+	CHECK(ph_host_uart_take(reply, reply_len) == reply_len);
+	CHECK(ph_host_uart_pending() == 0);
+	u8 sum = 0;
+	for (uz index = 0; index < reply_len - 1; ++index) {
+		sum += reply[index];
+	}
+	CHECK(reply[reply_len - 1] == sum);
+}
+
+static void test_ch9329_keyboard(void) {
+	_start();
+	const u8 data[8] = {0x02, 0x00, 0x04, 0, 0, 0, 0, 0};
+	u8 reply[7];
+	_ch9329_request(0x02, data, 8, reply, 7);
+	const u8 expected[7] = {0x57, 0xAB, 0x00, 0x82, 0x01, 0x00, 0x85};
+	CHECK(!memcmp(reply, expected, 7));
+	const ph_host_report_s *const reports = _reports(PH_USB_KBD_IFACES); // The other keyboards are released
+	_check_kbd_report(&reports[0], 0x02, 4, 0);
+}
+
+static void test_ch9329_errors(void) {
+	_start();
+	const u8 data[7] = {0};
+	u8 reply[7];
+	_ch9329_request(0x02, data, 7, reply, 7); // The keyboard packet has 8 bytes
+	const u8 expected_param[7] = {0x57, 0xAB, 0x00, 0xC2, 0x01, 0xE5, 0xAA};
+	CHECK(!memcmp(reply, expected_param, 7));
+	_ch9329_request(0x0A, NULL, 0, reply, 7);
+	const u8 expected_cmd[7] = {0x57, 0xAB, 0x00, 0xCA, 0x01, 0xE3, 0xB0};
+	CHECK(!memcmp(reply, expected_cmd, 7));
+
+	// Неверная сумма: ни ответа, ни отчета
+	const u8 packet[14] = {0x57, 0xAB, 0x00, 0x02, 0x08, 0x02, 0x00, 0x04, 0, 0, 0, 0, 0, 0x00};
+	ph_host_uart_feed(packet, 14);
+	ph_host_drain(2000);
+	CHECK(ph_host_uart_pending() == 0);
+	_reports(0);
+}
+
+static void test_ch9329_get_info(void) {
+	_start();
+	ph_host_usb_set_leds(0, KEYBOARD_LED_CAPSLOCK);
+	ph_host_run(100);
+	u8 reply[14];
+	_ch9329_request(0x01, NULL, 0, reply, 14);
+	// Version 1.0, online, Caps Lock in bit 1
+	const u8 expected[14] = {0x57, 0xAB, 0x00, 0x81, 0x08, 0x30, 0x01, 0x02, 0, 0, 0, 0, 0, 0xBE};
+	CHECK(!memcmp(reply, expected, 14));
+}
+
+static void test_ch9329_mouse_abs(void) {
+	_start();
+	u8 reply[7];
+	const u8 corner[7] = {0x02, 0x01, 0x00, 0x00, 0xFF, 0x0F, 0x00}; // Left button, x=0, y=4095
+	_ch9329_request(0x04, corner, 7, reply, 7);
+	CHECK(reply[3] == 0x84 && reply[5] == 0x00);
+	ph_host_run(2000);
+	const u8 clamped[7] = {0x02, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0x01}; // x=65535 is clamped to 4095, y=0, wheel
+	_ch9329_request(0x04, clamped, 7, reply, 7);
+	ph_host_run(2000);
+
+	const ph_host_report_s *const reports = _reports(2);
+	const u8 expected_corner[6] = {0x01, 0x00, 0x00, 0xFF, 0x7F, 0x00}; // 0 and 32767 little-endian
+	const u8 expected_clamped[6] = {0x00, 0xFF, 0x7F, 0x00, 0x00, 0x01};
+	CHECK(reports[0].iface == _MOUSE_IFACE);
+	CHECK(!memcmp(reports[0].data, expected_corner, 6));
+	CHECK(!memcmp(reports[1].data, expected_clamped, 6));
+}
+
+static void test_ch9329_mouse_rel(void) {
+	ph_outputs_write(0xFF, PH_PROTO_OUT1_KBD_USB | PH_PROTO_OUT1_MOUSE_USB_REL, true);
+	_start();
+	u8 reply[7];
+	const u8 data[5] = {0x01, 0x02, 5, (u8)-3, (u8)-1}; // Right button, x, y, wheel
+	_ch9329_request(0x05, data, 5, reply, 7);
+	CHECK(reply[3] == 0x85 && reply[5] == 0x00);
+	ph_host_run(2000);
+	const ph_host_report_s *const reports = _reports(1);
+	const u8 expected[4] = {0x02, 5, (u8)-3, (u8)-1};
+	CHECK(reports[0].iface == _MOUSE_IFACE);
+	CHECK(reports[0].len == 4);
+	CHECK(!memcmp(reports[0].data, expected, 4));
+}
+
+static void test_ch9329_media(void) {
+	// Громкость есть на странице клавиатуры, браузерных клавиш нет: они подтверждаются и теряются
+	_start();
+	u8 reply[7];
+	const u8 volume_up[4] = {0x02, 0x01, 0x01, 0x00};
+	_ch9329_request(0x03, volume_up, 4, reply, 7);
+	CHECK(reply[3] == 0x83 && reply[5] == 0x00);
+	ph_host_run(2000);
+	const u8 release[4] = {0x02, 0x00, 0x00, 0x00};
+	_ch9329_request(0x03, release, 4, reply, 7);
+	ph_host_run(2000);
+	const ph_host_report_s *const reports = _reports(2);
+	_check_kbd_report(&reports[0], 0, 0x80, 0);
+	_check_kbd_report(&reports[1], 0, 0, 0);
+}
+
+static void test_ch9329_off_after_pikvm(void) {
+	// После первого кадра PiKVM правильный пакет CH9329 уже не разбирается и не подтверждается
+	_start();
+	u8 resp[8];
+	_ping(resp);
+	const u8 packet[6] = {0x57, 0xAB, 0x00, 0x01, 0x00, 0x03}; // GET_INFO
+	ph_host_uart_feed(packet, 6);
+	ph_host_drain(200000); // And the PiKVM timeout for the incomplete frame
+	u8 junk[16];
+	const uz len = ph_host_uart_take(junk, sizeof(junk));
+	CHECK(len == 0 || (len == 8 && junk[0] == PH_PROTO_MAGIC_RESP)); // No 57 AB reply
+	_ping(resp);
+}
+
+static void test_ch9329_ignores_pikvm(void) {
+	// x=0x57AB дает в кадре 57 AB 00, но после кадров PiKVM это не CH9329.
+	// С y=20 дальше идут cmd=0x14 и len=0x40 из CRC, а следующие пинги дают данные и сумму.
+	_start();
+	u8 resp[8];
+	_ping(resp);
+	ph_host_usb_reports_clear();
+	_request(PH_PROTO_CMD_MOUSE_ABS, 0x57, 0xAB, 0x00, 20, resp);
+	for (u8 index = 0; index < 9; ++index) {
+		_ping(resp);
+	}
+	CHECK(ph_host_uart_pending() == 0); // Only the 8-byte responses
+	ph_host_run(2000);
+	const ph_host_report_s *const reports = _reports(1);
+	const u8 expected[6] = {0, 0xD5, 0x6B, 0x0A, 0x40, 0}; // 22443 and 20 scaled to 0...32767
+	CHECK(reports[0].len == 6);
+	CHECK(!memcmp(reports[0].data, expected, 6));
+}
+
+
+//--------------------------------------------------------------------
+// Diagnostics
+//--------------------------------------------------------------------
+
+static void test_trace(void) {
+	_start();
+	u8 resp[8];
+	_request(PH_PROTO_CMD_KBD_KEY, _KEY_A, 1, 0, 0, resp);
+	ph_host_run(1000);
+	CHECK(_request(PH_PROTO_CMD_GET_TRACE, 0, 0, 0, 0, resp) == PH_PROTO_RESP_TRACE);
+	CHECK(ph_merge8_u16(resp[4], resp[5]) != PH_PROTO_TRACE_PENDING);
+}
+
+static void test_recorder(void) {
+	_start();
+	u8 resp[8];
+	_request(PH_PROTO_CMD_KBD_KEY, _KEY_A, 1, 0, 0, resp);
+	CHECK(_request(PH_PROTO_CMD_GET_RECORD, 0, 0, 3, 0, resp) == PH_PROTO_RESP_RECORD);
+	const u16 next_seq = ph_merge8_u16(resp[2], resp[3]);
+	CHECK(ph_merge8_u16(resp[4], resp[5]) == next_seq); // Nothing is overwritten yet
+	const u16 last_seq = next_seq - 2; // The last one is PONG with the new online flags
+	CHECK(_request(PH_PROTO_CMD_GET_RECORD, last_seq >> 8, last_seq & 0xFF, 1, 0, resp) == PH_PROTO_RESP_RECORD);
+	const u8 expected[4] = {PH_PROTO_REC_CMD, PH_PROTO_CMD_KBD_KEY, _KEY_A, 1};
+	CHECK(!memcmp(resp + 2, expected, 4));
+}
+
+
+//--------------------------------------------------------------------
+// Runner
+//--------------------------------------------------------------------
+
+int main(void) {
+	// Каждый тест в своем процессе: у прошивки статическое состояние и один main()
+#	define TEST(x_name) {#x_name, x_name}
+	const struct {
+		const char	*name;
+		void		(*func)(void);
+	} tests[] = {
+		TEST(test_ping),
+		TEST(test_crc_error),
+		TEST(test_invalid_command),
+		TEST(test_timeout),
+		TEST(test_usb_key),
+#		if PH_USB_KBD_IFACES == 1
+		TEST(test_usb_key_batches),
+#		endif
+		TEST(test_usb_leds),
+		TEST(test_usb_kbd_offline),
+		TEST(test_usb_kbd_report_fails),
+		TEST(test_usb_mouse_abs),
+		TEST(test_usb_mouse_interp),
+		TEST(test_usb_mouse_rel_switch),
+		TEST(test_usb_nkro_mouse),
+#		if PH_USB_KBD_IFACES > 1
+		TEST(test_usb_kbd_stripes),
+		TEST(test_usb_kbd_stripes_nkro),
+#		endif
+		TEST(test_ps2_key),
+		TEST(test_ps2_mouse_accumulates),
+		TEST(test_ch9329_keyboard),
+		TEST(test_ch9329_errors),
+		TEST(test_ch9329_get_info),
+		TEST(test_ch9329_mouse_abs),
+		TEST(test_ch9329_mouse_rel),
+		TEST(test_ch9329_media),
+		TEST(test_ch9329_off_after_pikvm),
+		TEST(test_ch9329_ignores_pikvm),
+		TEST(test_trace),
+		TEST(test_recorder),
+	};
+#	undef TEST
+
+	unsigned failed = 0;
+	for (uz index = 0; index < sizeof(tests) / sizeof(tests[0]); ++index) {
+		fflush(stdout);
+		const pid_t pid = fork();
+		if (pid == 0) {
+			tests[index].func();
+			exit(0);
+		}
+		int status = 0;
+		waitpid(pid, &status, 0);
+		const bool ok = (WIFEXITED(status) && WEXITSTATUS(status) == 0);
+		printf("%s %s\n", (ok ? "ok  " : "FAIL"), tests[index].name);
+		failed += !ok;
+	}
+	printf("%u failed\n", failed);
+	return (failed > 0);
+}
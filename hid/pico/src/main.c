@@ -20,6 +20,8 @@
 *****************************************************************************/
 
 
+#include <string.h>
+
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
 #include "hardware/watchdog.h"
@@ -32,297 +34,187 @@
 #include "ph_com.h"
 #include "ph_proto.h"
 #include "ph_cmds.h"
+#include "ph_ch9329.h"
+#include "ph_stats.h"
+#include "ph_profile.h"
+#include "ph_trace.h"
+#include "ph_recorder.h"
 #include "ph_debug.h"
 
-/*
- * ====================================================================
- * [수정] CH9329 시리얼 프로토콜 번역기 코드 (main.c에 삽입)
- * ====================================================================
- */
-
-// CH9329 프로토콜 상수 정의
-#define CH_HEADER_1 0x57
-#define CH_HEADER_2 0xAB
-#define CH_CMD_TYPE 0x00 // 고정값
-#define CH_CMD_MOUSE 0x01
-#define CH_CMD_KEYBOARD 0x02
-
-// CH9329 패킷 길이 정의
-#define CH_LEN_MOUSE 0x05
-#define CH_LEN_KEYBOARD 0x08
-
-// 파서(Parser)의 상태를 정의
-typedef enum {
-    CH_WAIT_HEADER_1,
-    CH_WAIT_HEADER_2,
-    CH_WAIT_CMD_TYPE,
-    CH_WAIT_CMD,
-    CH_WAIT_LEN,
-    CH_READ_DATA,
-    CH_WAIT_CHECKSUM
-} ch_parser_state_t;
-
-// CH9329 패킷 구조체 정의 (u8 타입 사용)
-static struct {
-    u8 cmd;
-    u8 len;
-    u8 data[8]; // 최대 8바이트 (키보드 기준)
-    u8 checksum;
-    u8 data_index;
-} ch_packet;
-
-static ch_parser_state_t ch_parser_state = CH_WAIT_HEADER_1;
-
-// [링커 오류 수정] 키보드 상태 저장을 위한 변수 추가
-static u8 ch_kbd_modifier = 0;
-static u8 ch_kbd_keycodes[6] = {0};
-
-/**
- * @brief 6-Key 롤오버(CH9329)를 1-Key 이벤트(PiKVM)로 변환
- */
-static void ch9329_process_keyboard_state(u8 new_modifier, u8 new_keycodes[6])
-{
-    int i, j;
-    bool found;
 
-    // 1. 모디파이어 키 처리
-    if (ch_kbd_modifier != new_modifier) {
-        // (간결성을 위해 모디파이어 키의 개별 Press/Release는 생략합니다.
-        // PiKVM의 ph_cmd_kbd_send_key는 모디파이어를 다루지 않습니다.)
-        ch_kbd_modifier = new_modifier;
-    }
+// Хост на PiKVM-протоколе: после первого валидного запроса отвечаем и на таймауты
+static bool _proto_seen = false;
 
-    // 2. 키 떼기 (Release) 이벤트 전송
-    // (이전 리포트에는 있었지만, 새 리포트에는 없는 키를 찾습니다)
-    for (i = 0; i < 6; i++) {
-        if (ch_kbd_keycodes[i] == 0) continue; // 이전 키가 비어있으면 스킵
-        
-        found = false;
-        for (j = 0; j < 6; j++) {
-            if (ch_kbd_keycodes[i] == new_keycodes[j]) {
-                found = true;
-                break;
-            }
-        }
-        
-        if (!found) {
-            // 이 키(ch_kbd_keycodes[i])를 떼었습니다.
-            u8 args[2];
-            args[0] = ch_kbd_keycodes[i];
-            args[1] = 0; // 0 = Release
-            ph_cmd_kbd_send_key(args);
-        }
-    }
+static u32 _stats_value = 0; // For PH_PROTO_RESP_STATS, TRACE and RECORD, including the repeated one
 
-    // 3. 키 누름 (Press) 이벤트 전송
-    // (새 리포트에는 있지만, 이전 리포트에는 없던 키를 찾습니다)
-    for (i = 0; i < 6; i++) {
-        if (new_keycodes[i] == 0) continue; // 새 키가 비어있으면 스킵
-        
-        found = false;
-        for (j = 0; j < 6; j++) {
-            if (new_keycodes[i] == ch_kbd_keycodes[j]) {
-                found = true;
-                break;
-            }
-        }
-        
-        if (!found) {
-            // 이 키(new_keycodes[i])를 눌렀습니다.
-            u8 args[2];
-            args[0] = new_keycodes[i];
-            args[1] = 1; // 1 = Press
-            ph_cmd_kbd_send_key(args);
-        }
-    }
 
-    // 4. 현재 상태를 이전 상태로 저장
-    for (i = 0; i < 6; i++) {
-        ch_kbd_keycodes[i] = new_keycodes[i];
-    }
+static u8 _handle_request(const u8 *data) { // 8 bytes
+	// FIXME: See kvmd/kvmd#80
+	// Should input buffer be cleared in this case?
+	if (data[0] == PH_PROTO_MAGIC && ph_crc16(data, 6) == ph_merge8_u16(data[6], data[7])) {
+#		define HANDLE(x_handler) { \
+				ph_recorder_add(PH_PROTO_REC_CMD, data[1], data[2], data[3]); \
+				x_handler(data + 2); \
+				return PH_PROTO_PONG_OK; \
+			}
+#		define HANDLE_INPUT(x_handler) { \
+				ph_recorder_add(PH_PROTO_REC_CMD, data[1], data[2], data[3]); \
+				ph_trace_begin(); \
+				x_handler(data + 2); \
+				ph_trace_applied(); \
+				return PH_PROTO_PONG_OK; \
+			}
+		switch (data[1]) {
+			case PH_PROTO_CMD_PING:				return PH_PROTO_PONG_OK;
+			case PH_PROTO_CMD_SET_KBD:			HANDLE(ph_cmd_set_kbd); // Переключается на лету, без ресета
+			case PH_PROTO_CMD_SET_MOUSE:		HANDLE(ph_cmd_set_mouse);
+			case PH_PROTO_CMD_SET_CONNECTED:	return PH_PROTO_PONG_OK; // Arduino AUM
+			case PH_PROTO_CMD_SET_MOUSE_INTERP:	HANDLE(ph_cmd_set_mouse_interp);
+			case PH_PROTO_CMD_GET_STATS:
+				if (data[2] < PH_PROTO_STATS_COUNT) {
+					_stats_value = ph_stats_get(data[2]);
+					return PH_PROTO_RESP_STATS;
+				}
+				break;
+#			ifdef PH_PROFILE
+			case PH_PROTO_CMD_GET_PROFILE:
+				if (data[2] < PH_PROTO_PROBES_COUNT && data[3] < PH_PROTO_PROFILE_BUCKETS) {
+					_stats_value = ph_profile_get(data[2], data[3]);
+					return PH_PROTO_RESP_STATS;
+				}
+				break;
+#			endif
+			case PH_PROTO_CMD_GET_TRACE:
+				_stats_value = ph_trace_get();
+				return PH_PROTO_RESP_TRACE;
+			case PH_PROTO_CMD_GET_RECORD:
+				if (ph_recorder_get(ph_merge8_u16(data[2], data[3]), data[4], &_stats_value)) {
+					return PH_PROTO_RESP_RECORD;
+				}
+				return PH_PROTO_RESP_INVALID_ERROR; // Затертая запись - не ошибка протокола, и кольцо не трогаем
+			case PH_PROTO_CMD_CLEAR_HID:		HANDLE_INPUT(ph_cmd_send_clear);
+			case PH_PROTO_CMD_KBD_KEY:			HANDLE_INPUT(ph_cmd_kbd_send_key);
+			case PH_PROTO_CMD_MOUSE_BUTTON:		HANDLE_INPUT(ph_cmd_mouse_send_button);
+			case PH_PROTO_CMD_MOUSE_ABS:		HANDLE_INPUT(ph_cmd_mouse_send_abs);
+			case PH_PROTO_CMD_MOUSE_REL:		HANDLE_INPUT(ph_cmd_mouse_send_rel);
+			case PH_PROTO_CMD_MOUSE_WHEEL:		HANDLE_INPUT(ph_cmd_mouse_send_wheel);
+			case PH_PROTO_CMD_REPEAT:			return 0;
+		}
+#		undef HANDLE_INPUT
+#		undef HANDLE
+		PH_STATS_INC(INVALID_CMDS);
+		return PH_PROTO_RESP_INVALID_ERROR;
+	}
+	return PH_PROTO_RESP_CRC_ERROR;
 }
 
-
-/**
- * @brief CH9329 패킷을 해석하고 PiKVM의 HID 함수를 호출
- */
-static void ch9329_process_packet()
-{
-    if (ch_packet.cmd == CH_CMD_KEYBOARD && ch_packet.len == CH_LEN_KEYBOARD)
-    {
-        // [링커 오류 수정]
-        // 6KRO 리포트를 1-Key 이벤트로 변환하는 새 함수 호출
-        u8 modifier = ch_packet.data[0];
-        u8* keycodes = &ch_packet.data[2]; // data[2]~[7]
-        ch9329_process_keyboard_state(modifier, keycodes);
-    }
-    else if (ch_packet.cmd == CH_CMD_MOUSE && ch_packet.len == CH_LEN_MOUSE)
-    {
-        // 마우스 로직은 링커 오류가 없었으므로 10차 수정안과 동일
-        u8 buttons = ch_packet.data[0];
-        s8 x = (s8)ch_packet.data[1];
-        s8 y = (s8)ch_packet.data[2];
-        s8 wheel = (s8)ch_packet.data[3];
-        
-        u8 button_args[2];
-        button_args[0] = (buttons & 0x07); 
-        button_args[1] = ((buttons >> 3) & 0x03); 
-        ph_cmd_mouse_send_button(button_args);
-
-        u8 rel_args[2];
-        rel_args[0] = (u8)x;
-        rel_args[1] = (u8)y;
-        ph_cmd_mouse_send_rel(rel_args);
-        
-        u8 wheel_args[2];
-        wheel_args[0] = (u8)wheel; // Vertical wheel
-        wheel_args[1] = 0;         // Horizontal wheel (CH9329는 지원 안함)
-        ph_cmd_mouse_send_wheel(wheel_args);
-    }
+static void _record_response(const u8 *resp) {
+	static u8 prev_pong[3] = {0};
+	if (resp[1] & PH_PROTO_PONG_OK) {
+		if (!memcmp(prev_pong, resp + 1, 3)) {
+			return; // Пинги идут постоянно, а в кольце нужны только изменения
+		}
+		memcpy(prev_pong, resp + 1, 3);
+	} else if (
+		resp[1] == PH_PROTO_RESP_STATS
+		|| resp[1] == PH_PROTO_RESP_TRACE
+		|| resp[1] == PH_PROTO_RESP_RECORD
+	) {
+		return;
+	}
+	ph_recorder_add(PH_PROTO_REC_RESP, resp[1], resp[2], resp[3]);
 }
 
-/**
- * @brief UART에서 1바이트를 읽어 CH9329 상태 머신을 실행
- */
-static void ch9329_parse_byte(u8 ch) // u8 타입 사용
-{
-    // C89 표준을 준수하기 위해 변수를 함수 맨 위에 선언합니다.
-    u8 calculated_checksum = 0; // u8 타입 사용
-    int i = 0; 
-
-    switch (ch_parser_state)
-    {
-        case CH_WAIT_HEADER_1:
-            if (ch == CH_HEADER_1) ch_parser_state = CH_WAIT_HEADER_2;
-            break;
-        case CH_WAIT_HEADER_2:
-            if (ch == CH_HEADER_2) ch_parser_state = CH_WAIT_CMD_TYPE;
-            else ch_parser_state = CH_WAIT_HEADER_1;
-            break;
-        case CH_WAIT_CMD_TYPE:
-            if (ch == CH_CMD_TYPE) ch_parser_state = CH_WAIT_CMD;
-            else ch_parser_state = CH_WAIT_HEADER_1;
-            break;
-        case CH_WAIT_CMD:
-            if (ch == CH_CMD_MOUSE || ch == CH_CMD_KEYBOARD) {
-                ch_packet.cmd = ch;
-                ch_parser_state = CH_WAIT_LEN;
-            } else ch_parser_state = CH_WAIT_HEADER_1;
-            break;
-        case CH_WAIT_LEN:
-            if ((ch_packet.cmd == CH_CMD_MOUSE && ch == CH_LEN_MOUSE) ||
-                (ch_packet.cmd == CH_CMD_KEYBOARD && ch == CH_LEN_KEYBOARD)) {
-                ch_packet.len = ch;
-                ch_packet.data_index = 0;
-                ch_parser_state = CH_READ_DATA;
-            } else ch_parser_state = CH_WAIT_HEADER_1;
-            break;
-        case CH_READ_DATA:
-            ch_packet.data[ch_packet.data_index++] = ch;
-            if (ch_packet.data_index >= ch_packet.len) {
-                ch_parser_state = CH_WAIT_CHECKSUM;
-            }
-            break;
-        case CH_WAIT_CHECKSUM:
-            ch_packet.checksum = ch;
-            calculated_checksum = CH_HEADER_1 + CH_HEADER_2 + CH_CMD_TYPE + 
-                                  ch_packet.cmd + ch_packet.len;
-            
-            for (i = 0; i < ch_packet.len; i++) {
-                calculated_checksum += ch_packet.data[i];
-            }
-
-            if ((u8)calculated_checksum == ch_packet.checksum) { // u8 타입 사용
-                ch9329_process_packet();
-            }
-            ch_parser_state = CH_WAIT_HEADER_1; 
-            break;
-        default:
-            ch_parser_state = CH_WAIT_HEADER_1;
-            break;
-    }
-}
-/*
- * ====================================================================
- * (사용자 추가 부분 끝)
- * ====================================================================
- */
+static void _send_response(u8 code, bool record) {
+	static u8 prev_code = PH_PROTO_RESP_NONE;
+	if (code == 0) {
+		code = prev_code; // Repeat the last code
+	} else {
+		prev_code = code;
+	}
 
+	u8 resp[8] = {0};
+	resp[0] = PH_PROTO_MAGIC_RESP;
+
+	if (code & PH_PROTO_PONG_OK) {
+		resp[1] = PH_PROTO_PONG_OK;
+		resp[2] = PH_PROTO_OUT1_DYNAMIC;
+
+		resp[1] |= ph_cmd_get_offlines();
+		resp[1] |= ph_cmd_kbd_get_leds();
+		resp[2] |= ph_g_outputs_active;
+		resp[3] |= ph_g_outputs_avail;
+	} else if (code == PH_PROTO_RESP_STATS || code == PH_PROTO_RESP_TRACE || code == PH_PROTO_RESP_RECORD) {
+		resp[1] = code;
+		ph_split16(_stats_value >> 16, &resp[2], &resp[3]);
+		ph_split16(_stats_value & 0xFFFF, &resp[4], &resp[5]);
+	} else {
+		resp[1] = code;
+	}
 
-static bool _reset_required = false;
+	if (record) {
+		_record_response(resp);
+	}
 
-/*
- * ====================================================================
- * [수정] _handle_request 함수는 사용되지 않으므로 비워둡니다.
- * (로그에 'unused' 경고가 뜨지만 무시합니다.)
- * ====================================================================
- */
-static u8 _handle_request(const u8 *data) { // 8 bytes
-	// (기존 내용 모두 삭제 또는 주석 처리)
-    return 0; 
-}
+	ph_split16(ph_crc16(resp, 6), &resp[6], &resp[7]);
 
-/*
- * ====================================================================
- * [수정] _send_response 함수는 사용되지 않으므로 비워둡니다.
- * (로그에 'unused' 경고가 뜨지만 무시합니다.)
- * ====================================================================
- */
-static void _send_response(u8 code) {
-	// (기존 내용 모두 삭제 또는 주석 처리)
+	ph_com_write(resp);
 }
 
-
-/*
- * ====================================================================
- * [수정] _data_handler 함수를 하이재킹합니다.
- * ====================================================================
- */
 static void _data_handler(const u8 *data) {
-	// _send_response(_handle_request(data)); // <-- 기존 PiKVM 프로토콜 비활성화
+	if (data[0] == PH_PROTO_MAGIC && ph_crc16(data, 6) == ph_merge8_u16(data[6], data[7])) {
+		// Валидный кадр PiKVM-протокола
+		_proto_seen = true;
+		PH_STATS_INC(RX_FRAMES);
+		// Диагностика не пишется в кольцо, иначе дамп затирал бы сам себя
+		const bool record = (data[1] < PH_PROTO_CMD_GET_STATS || data[1] > PH_PROTO_CMD_GET_RECORD);
+		_send_response(_handle_request(data), record);
+	} else if (data[0] == PH_PROTO_MAGIC) {
+		PH_STATS_INC(CRC_ERRORS); // Меджик на месте, но кадр битый
+	}
+	// Всё остальное - поток CH9329, он разбирается побайтово в _byte_handler()
+}
 
-    /*
-     * 하이재킹: 8바이트 버퍼(data)를 CH9329 번역기에 1바이트씩 주입합니다.
-     */
-    int i;
-    for (i = 0; i < 8; i++) {
-        ch9329_parse_byte(data[i]);
-    }
+static void _byte_handler(u8 ch) {
+	// После первого кадра PiKVM поток CH9329 больше не разбирается: в обычных кадрах
+	// тоже бывает 57 AB 00 (например, MOUSE_ABS с x=0x57AB), и ответ на такой "пакет"
+	// сломал бы kvmd разбивку ответов по 8 байт
+	if (!_proto_seen) {
+		ph_ch9329_feed(ch);
+	}
 }
 
-/*
- * ====================================================================
- * [수정] _timeout_handler 함수를 비활성화합니다.
- * ====================================================================
- */
 static void _timeout_handler(void) {
-	// _send_response(PH_PROTO_RESP_TIMEOUT_ERROR); // <-- 비활성화
+	PH_STATS_INC(RX_TIMEOUTS);
+	if (_proto_seen) {
+		_send_response(PH_PROTO_RESP_TIMEOUT_ERROR, true);
+	}
 }
 
 
 int main(void) {
 	//ph_debug_act_init();
 	//ph_debug_uart_init();
+	ph_recorder_add(PH_PROTO_REC_BOOT, watchdog_caused_reboot(), 0, 0);
 	ph_outputs_init();
 	ph_ps2_init();
 	ph_usb_init();
-	
-    // [수정] CH9329 파서 초기화 코드를 ph_com_init 전에 추가합니다.
-    ch_parser_state = CH_WAIT_HEADER_1;
-    // [수정] CH9329 키보드 상태 초기화
-    ch_kbd_modifier = 0;
-    for(int i=0; i<6; i++) { ch_kbd_keycodes[i] = 0; }
-
-
-    ph_com_init(_data_handler, _timeout_handler);
+	ph_ch9329_init();
+	ph_com_init(_data_handler, _byte_handler, _timeout_handler);
 
+	u32 loop_ts = time_us_32();
 	while (true) {
-		ph_usb_task();
-		ph_ps2_task();
-		if (!_reset_required) {
-			ph_com_task();
-			//ph_debug_act_pulse(100);
-		}
+		PH_PROFILE_RUN(USB, ph_usb_task());
+		PH_PROFILE_RUN(PS2, ph_ps2_task());
+		PH_PROFILE_RUN(TRANSPORT, ph_com_task());
+		//ph_debug_act_pulse(100);
+
+		const u32 now_ts = time_us_32();
+		PH_STATS_MAX(LOOP_MAX_US, now_ts - loop_ts);
+#		ifdef PH_PROFILE
+		ph_profile_add(PH_PROTO_PROBE_LOOP, now_ts - loop_ts);
+#		endif
+		loop_ts = now_ts;
 	}
 	return 0;
 }
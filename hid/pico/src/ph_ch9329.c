@@ -0,0 +1,248 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+
+#include "ph_ch9329.h"
+
+#include "ph_types.h"
+#include "ph_tools.h"
+#include "ph_proto.h"
+#include "ph_cmds.h"
+#include "ph_com.h"
+#include "ph_recorder.h"
+
+
+// CH9329 serial protocol: 57 AB <addr> <cmd> <len> <data...> <sum>.
+// The reply has the same format with cmd | 0x80 or cmd | 0xC0 on error.
+#define _HEAD1			0x57
+#define _HEAD2			0xAB
+#define _ADDR			0x00
+#define _LEN_MAX		64
+
+#define _CMD_GET_INFO	0x01
+#define _CMD_KEYBOARD	0x02
+#define _CMD_MEDIA		0x03
+#define _CMD_MOUSE_ABS	0x04
+#define _CMD_MOUSE_REL	0x05
+#define _CMD_RESET		0x0F
+
+#define _ABS_MAX		4095 // CH9329 absolute coordinates are 0...4095
+
+#define _OK				0x00
+#define _ERR_CMD		0xE3
+#define _ERR_PARAM		0xE5
+
+#define _VERSION		0x30 // V1.0
+
+
+enum {
+	_WAIT_HEAD1 = 0,
+	_WAIT_HEAD2,
+	_WAIT_ADDR,
+	_WAIT_CMD,
+	_WAIT_LEN,
+	_READ_DATA,
+	_WAIT_SUM,
+};
+
+static u8 _state = _WAIT_HEAD1;
+static u8 _cmd = 0;
+static u8 _len = 0;
+static u8 _data[_LEN_MAX] = {0};
+static u8 _index = 0;
+static u8 _sum = 0;
+
+static u8 _media[4] = {0}; // ACPI byte, then three multimedia bytes
+
+
+static u8 _process_packet(void);
+static void _process_media(u8 index, u8 bits);
+static void _send_info(void);
+static void _send_reply(u8 cmd, const u8 *data, u8 len);
+
+
+void ph_ch9329_init(void) {
+	_state = _WAIT_HEAD1;
+	for (u8 index = 0; index < 4; ++index) {
+		_media[index] = 0;
+	}
+}
+
+void ph_ch9329_feed(u8 ch) {
+	// Пакет применяется сразу, как только пришел байт контрольной суммы,
+	// и тут же подтверждается, чтобы хост не ждал таймаута чтения.
+	// Пакет с неверной суммой молча отбрасывается: скорее всего это вообще не CH9329.
+	switch (_state) {
+		case _WAIT_HEAD1:
+			if (ch == _HEAD1) {
+				_sum = ch;
+				_state = _WAIT_HEAD2;
+			}
+			return;
+		case _WAIT_HEAD2:
+			if (ch != _HEAD2) {
+				_state = (ch == _HEAD1 ? _WAIT_HEAD2 : _WAIT_HEAD1);
+				return;
+			}
+			_state = _WAIT_ADDR;
+			break;
+		case _WAIT_ADDR:
+			_state = (ch == _ADDR ? _WAIT_CMD : _WAIT_HEAD1);
+			break;
+		case _WAIT_CMD:
+			_cmd = ch;
+			_state = (ch < 0x80 ? _WAIT_LEN : _WAIT_HEAD1); // Replies from another chip are not for us
+			break;
+		case _WAIT_LEN:
+			_len = ch;
+			_index = 0;
+			_state = (ch > _LEN_MAX ? _WAIT_HEAD1 : (ch > 0 ? _READ_DATA : _WAIT_SUM));
+			break;
+		case _READ_DATA:
+			_data[_index] = ch;
+			++_index;
+			if (_index >= _len) {
+				_state = _WAIT_SUM;
+			}
+			break;
+		case _WAIT_SUM:
+			_state = _WAIT_HEAD1;
+			if (ch != _sum) {
+				return;
+			} else if (_cmd == _CMD_GET_INFO && _len == 0) {
+				_send_info();
+			} else {
+				ph_recorder_add(PH_PROTO_REC_CH9329, _cmd, _data[0], _data[2]);
+				const u8 code = _process_packet();
+				_send_reply(_cmd | (code == _OK ? 0x80 : 0xC0), &code, 1);
+			}
+			return;
+		default:
+			_state = _WAIT_HEAD1;
+			return;
+	}
+	_sum += ch;
+}
+
+static u8 _process_packet(void) {
+	switch (_cmd) {
+		case _CMD_GET_INFO: return _ERR_PARAM; // Has no data, handled separately
+
+		case _CMD_KEYBOARD:
+			if (_len != 8) {
+				return _ERR_PARAM;
+			}
+			ph_cmd_kbd_send_report(_data); // The same layout as the USB report
+			return _OK;
+
+		case _CMD_MEDIA:
+			if (_len == 2 && _data[0] == 0x01) {
+				_process_media(0, _data[1]);
+			} else if (_len == 4 && _data[0] == 0x02) {
+				for (u8 index = 1; index < 4; ++index) {
+					_process_media(index, _data[index]);
+				}
+			} else {
+				return _ERR_PARAM;
+			}
+			return _OK;
+
+		case _CMD_MOUSE_ABS: {
+			if (_len != 7 || _data[0] != 0x02) {
+				return _ERR_PARAM;
+			}
+			// Buttons, x and y little-endian, wheel
+#			define SCALE(x_lo, x_hi) ({ \
+					u16 m_value = _data[x_lo] | ((u16)_data[x_hi] << 8); \
+					m_value = (m_value > _ABS_MAX ? _ABS_MAX : m_value); \
+					(s16)((s32)m_value * 65535 / _ABS_MAX - 32768); \
+				})
+			u8 args[6] = {_data[1], 0, 0, 0, 0, _data[6]};
+			ph_split16(SCALE(2, 3), &args[1], &args[2]);
+			ph_split16(SCALE(4, 5), &args[3], &args[4]);
+#			undef SCALE
+			ph_cmd_mouse_send_abs_report(args);
+			return _OK;
+		}
+
+		case _CMD_MOUSE_REL:
+			if (_len != 5 || _data[0] != 0x01) {
+				return _ERR_PARAM;
+			}
+			ph_cmd_mouse_send_report(_data + 1); // Buttons, x, y, wheel
+			return _OK;
+
+		case _CMD_RESET:
+			for (u8 index = 0; index < 4; ++index) {
+				_media[index] = 0;
+			}
+			ph_cmd_send_clear(NULL);
+			return _OK;
+	}
+	return _ERR_CMD;
+}
+
+static void _process_media(u8 index, u8 bits) {
+	// Отдельного consumer-интерфейса нет, поэтому доходят только клавиши,
+	// у которых есть коды на странице клавиатуры. Остальные подтверждаются и молча теряются.
+	static const u8 usages[4][8] = {
+		{0x66, 0, 0, 0, 0, 0, 0, 0}, // ACPI: Power, Sleep, Wake
+		{0x80, 0x81, 0x7F, 0, 0, 0, 0, 0}, // Volume Up, Volume Down, Mute, Play, Next, Prev, Stop, Eject
+		{0, 0, 0, 0, 0, 0, 0, 0}, // Browser keys
+		{0, 0, 0, 0, 0, 0, 0, 0}, // Applications
+	};
+	const u8 changed = _media[index] ^ bits;
+	_media[index] = bits;
+	for (u8 bit = 0; bit < 8; ++bit) {
+		if ((changed & (1 << bit)) && usages[index][bit] > 0) {
+			const u8 args[2] = {usages[index][bit], !!(bits & (1 << bit))};
+			ph_cmd_kbd_send_usage(args);
+		}
+	}
+}
+
+static void _send_info(void) {
+	const u8 leds = ph_cmd_kbd_get_leds();
+	const bool online = !(ph_cmd_get_offlines() & PH_PROTO_PONG_KBD_OFFLINE);
+	const u8 info[8] = {
+		_VERSION,
+		online,
+		(
+			((leds & PH_PROTO_PONG_NUM) ? 0b001 : 0)
+			| ((leds & PH_PROTO_PONG_CAPS) ? 0b010 : 0)
+			| ((leds & PH_PROTO_PONG_SCROLL) ? 0b100 : 0)
+		),
+		0, 0, 0, 0, 0,
+	};
+	_send_reply(_CMD_GET_INFO | 0x80, info, 8);
+}
+
+static void _send_reply(u8 cmd, const u8 *data, u8 len) {
+	u8 reply[5 + 8 + 1] = {_HEAD1, _HEAD2, _ADDR, cmd, len};
+	u8 sum = _HEAD1 + _HEAD2 + _ADDR + cmd + len;
+	for (u8 index = 0; index < len; ++index) {
+		reply[5 + index] = data[index];
+		sum += data[index];
+	}
+	reply[5 + len] = sum;
+	ph_com_write_raw(reply, 5 + len + 1);
+}
@@ -20,20 +20,11 @@
 *****************************************************************************/
 
 
+
 #pragma once
 
 #include "ph_types.h"
 
-<%! import operator %>
-inline u8 ph_usb_keymap(u8 key) {
-	switch (key) {
-% for km in sorted(keymap, key=operator.attrgetter("mcu_code")):
-	% if km.usb_key.is_mod:
-		case ${km.mcu_code}: return ${km.usb_key.arduino_mod_code}; // ${km.web_name}
-	% else:
-		case ${km.mcu_code}: return ${km.usb_key.code}; // ${km.web_name}
-	% endif
-% endfor
-	}
-	return 0;
-}
+
+void ph_ch9329_init(void);
+void ph_ch9329_feed(u8 ch);
@@ -29,6 +29,10 @@
 #include "ph_usb.h"
 #include "ph_usb_keymap.h"
 #include "ph_ps2.h"
+#include "ph_stats.h"
+
+
+static void _set_outputs(u8 mask, u8 outputs);
 
 
 u8 ph_cmd_kbd_get_leds(void) {
@@ -63,11 +67,15 @@ u8 ph_cmd_get_offlines(void) {
 }
 
 void ph_cmd_set_kbd(const u8 *args) { // 1 byte
-	ph_outputs_write(PH_PROTO_OUT1_KBD_MASK, args[0], false);
+	_set_outputs(PH_PROTO_OUT1_KBD_MASK, args[0]);
 }
 
 void ph_cmd_set_mouse(const u8 *args) { // 1 byte
-	ph_outputs_write(PH_PROTO_OUT1_MOUSE_MASK, args[0], false);
+	_set_outputs(PH_PROTO_OUT1_MOUSE_MASK, args[0]);
+}
+
+void ph_cmd_set_mouse_interp(const u8 *args) { // 1 byte
+	ph_usb_mouse_set_interpolation(args[0]);
 }
 
 void ph_cmd_send_clear(const u8 *args) { // 0 bytes
@@ -87,6 +95,22 @@ void ph_cmd_kbd_send_key(const u8 *args) { // 2 bytes
 	}
 }
 
+void ph_cmd_kbd_send_report(const u8 *args) { // 8 bytes: modifiers, reserved, 6 USB keys
+	if (PH_O_IS_KBD_USB) {
+		ph_usb_kbd_send_report(args[0], args + 2);
+	} else if (PH_O_IS_KBD_PS2) {
+		ph_ps2_kbd_send_report(args[0], args + 2);
+	}
+}
+
+void ph_cmd_kbd_send_usage(const u8 *args) { // 2 bytes: USB key, state
+	if (PH_O_IS_KBD_USB) {
+		ph_usb_kbd_send_key(args[0], args[1]);
+	} else if (PH_O_IS_KBD_PS2) {
+		ph_ps2_kbd_send_key(args[0], args[1]);
+	}
+}
+
 void ph_cmd_mouse_send_button(const u8 *args) { // 2 bytes
 #	define HANDLE(x_byte_n, x_button) { \
 			if (args[x_byte_n] & PH_PROTO_CMD_MOUSE_##x_button##_SELECT) { \
@@ -129,3 +153,48 @@ void ph_cmd_mouse_send_wheel(const u8 *args) { // 2 bytes
 		ph_ps2_mouse_send_wheel(args[0], args[1]);
 	}
 }
+
+#define _MOUSE_BUTTONS ( \
+		MOUSE_BUTTON_LEFT | MOUSE_BUTTON_RIGHT | MOUSE_BUTTON_MIDDLE \
+		| MOUSE_BUTTON_BACKWARD | MOUSE_BUTTON_FORWARD \
+	)
+
+void ph_cmd_mouse_send_report(const u8 *args) { // 4 bytes: USB buttons bitmap, x, y, wheel
+	const u8 buttons = args[0] & _MOUSE_BUTTONS;
+	if (PH_O_IS_MOUSE_USB) {
+		ph_usb_mouse_send_report(buttons, args[1], args[2], args[3]);
+	} else if (PH_O_IS_MOUSE_PS2) {
+		ph_ps2_mouse_send_report(buttons, args[1], args[2], args[3]);
+	}
+}
+
+void ph_cmd_mouse_send_abs_report(const u8 *args) { // 6 bytes: USB buttons bitmap, x (2), y (2), wheel
+	if (PH_O_IS_MOUSE_USB_ABS) {
+		const s16 x = ph_merge8_s16(args[1], args[2]);
+		const s16 y = ph_merge8_s16(args[3], args[4]);
+		ph_usb_mouse_send_abs_report(args[0] & _MOUSE_BUTTONS, x, y, args[5]);
+	} else {
+		// Относительная мышь не умеет в координаты, но клики и колесо доходят
+		const u8 rel_args[4] = {args[0], 0, 0, args[5]};
+		ph_cmd_mouse_send_report(rel_args);
+	}
+}
+
+#undef _MOUSE_BUTTONS
+
+static void _set_outputs(u8 mask, u8 outputs) {
+	outputs &= mask;
+	ph_outputs_write(mask, outputs, false);
+
+	const u8 prev = ph_g_outputs_active;
+	if ((prev & mask) == outputs) {
+		return;
+	}
+	// Отпускаем всё на старом выходе, пока он ещё активен
+	ph_usb_send_clear();
+	ph_ps2_send_clear();
+	PH_STATS_INC(RESET_REQUESTS); // На месте вместо ресета, но для хоста это то же самое
+	ph_g_outputs_active = (prev & ~mask) | outputs;
+	ph_usb_reconfigure();
+	ph_ps2_reconfigure();
+}
@@ -49,13 +49,13 @@ static bool _use_spi = true;
 	}
 
 
-void ph_com_init(void (*data_cb)(const u8 *), void (*timeout_cb)(void)) {
+void ph_com_init(void (*data_cb)(const u8 *), void (*byte_cb)(u8), void (*timeout_cb)(void)) {
 	gpio_init(_USE_SPI_PIN);
 	gpio_set_dir(_USE_SPI_PIN, GPIO_IN);
 	gpio_pull_up(_USE_SPI_PIN);
 	sleep_ms(10); // Нужен небольшой слип для активации pull-up
 	_use_spi = gpio_get(_USE_SPI_PIN);
-	_COM(init, data_cb, timeout_cb);
+	_COM(init, data_cb, byte_cb, timeout_cb);
 }
 
 void ph_com_task(void) {
@@ -65,3 +65,7 @@ void ph_com_task(void) {
 void ph_com_write(const u8 *data) {
 	_COM(write, data);
 }
+
+void ph_com_write_raw(const u8 *data, uz len) {
+	_COM(write_raw, data, len);
+}
@@ -25,6 +25,7 @@
 #include "ph_types.h"
 
 
-void ph_com_init(void (*data_cb)(const u8 *), void (*timeout_cb)(void));
+void ph_com_init(void (*data_cb)(const u8 *), void (*byte_cb)(u8), void (*timeout_cb)(void));
 void ph_com_task(void);
 void ph_com_write(const u8 *data);
+void ph_com_write_raw(const u8 *data, uz len);
@@ -37,11 +37,13 @@ static u8 _index = 0;
 static u64 _last_ts = 0;
 
 static void (*_data_cb)(const u8 *) = NULL;
+static void (*_byte_cb)(u8) = NULL;
 static void (*_timeout_cb)(void) = NULL;
 
 
-void ph_com_bridge_init(void (*data_cb)(const u8 *), void (*timeout_cb)(void)) {
+void ph_com_bridge_init(void (*data_cb)(const u8 *), void (*byte_cb)(u8), void (*timeout_cb)(void)) {
 	_data_cb = data_cb;
+	_byte_cb = byte_cb;
 	_timeout_cb = timeout_cb;
 }
 
@@ -57,6 +59,7 @@ void ph_com_bridge_task(void) {
 			goto no_data;
 		}
 		_buf[_index] = (u8)ch;
+		_byte_cb((u8)ch);
 		if (_index == 7) {
 			_data_cb(_buf);
 			_index = 0;
@@ -82,3 +85,10 @@ void ph_com_bridge_write(const u8 *data) {
 		tud_cdc_write_flush();
 	}
 }
+
+void ph_com_bridge_write_raw(const u8 *data, uz len) {
+	if (tud_cdc_connected()) {
+		tud_cdc_write(data, len);
+		tud_cdc_write_flush();
+	}
+}
@@ -38,6 +38,9 @@
 #define _TX_PIN		19
 #define _CLK_PIN	18
 
+#define _STREAM_SIZE	256 // Indexes are u8 and wrap by themselves
+#define _STREAM_ZEROS	14 // The longest CH9329 packet tail of zeros
+
 
 static volatile u8 _in_buf[8] = {0};
 static volatile u8 _in_index = 0;
@@ -45,14 +48,20 @@ static volatile u8 _in_index = 0;
 static volatile u8 _out_buf[8] = {0};
 static volatile u8 _out_index = 0;
 
+static volatile u8 _stream[_STREAM_SIZE] = {0};
+static volatile u8 _stream_head = 0;
+static volatile u8 _stream_tail = 0;
+
 static void (*_data_cb)(const u8 *) = NULL;
+static void (*_byte_cb)(u8) = NULL;
 
 
 static void _xfer_isr(void);
 
 
-void ph_com_spi_init(void (*data_cb)(const u8 *), void (*timeout_cb)(void)) {
+void ph_com_spi_init(void (*data_cb)(const u8 *), void (*byte_cb)(u8), void (*timeout_cb)(void)) {
 	_data_cb = data_cb;
+	_byte_cb = byte_cb;
 	(void)timeout_cb;
 
 	spi_init(_BUS, _FREQ);
@@ -71,6 +80,10 @@ void ph_com_spi_init(void (*data_cb)(const u8 *), void (*timeout_cb)(void)) {
 }
 
 void ph_com_spi_task(void) {
+	while (_stream_tail != _stream_head) {
+		_byte_cb(_stream[_stream_tail]);
+		++_stream_tail;
+	}
 	if (!_out_buf[0] && _in_index == 8) {
 		_data_cb((const u8 *)_in_buf);
 	}
@@ -83,6 +96,12 @@ void ph_com_spi_write(const u8 *data) {
 	}
 }
 
+void ph_com_spi_write_raw(const u8 *data, uz len) {
+	// Мастер читает только 8-байтные ответы PiKVM, которые начинаются с меджика
+	(void)data;
+	(void)len;
+}
+
 void __isr __not_in_flash_func(_xfer_isr)(void) {
 #	define SR (spi_get_hw(_BUS)->sr)
 #	define DR (spi_get_hw(_BUS)->dr)
@@ -104,6 +123,16 @@ void __isr __not_in_flash_func(_xfer_isr)(void) {
 	while (SR & SPI_SSPSR_RNE_BITS) {
 		static bool receiving = false;
 		const u8 in = DR;
+
+		// Нулями мастер тактирует чтение ответа, в поток из них попадает
+		// только хвост не длиннее пакета CH9329
+		static u8 zeros = _STREAM_ZEROS;
+		zeros = (in != 0 ? 0 : (zeros < _STREAM_ZEROS ? zeros + 1 : zeros));
+		if (zeros < _STREAM_ZEROS && (u8)(_stream_head + 1) != _stream_tail) {
+			_stream[_stream_head] = in;
+			++_stream_head;
+		}
+
 		if (!receiving && in != 0) {
 			receiving = true;
 		}
@@ -41,11 +41,13 @@ static u8 _index = 0;
 static u64 _last_ts = 0;
 
 static void (*_data_cb)(const u8 *) = NULL;
+static void (*_byte_cb)(u8) = NULL;
 static void (*_timeout_cb)(void) = NULL;
 
 
-void ph_com_uart_init(void (*data_cb)(const u8 *), void (*timeout_cb)(void)) {
+void ph_com_uart_init(void (*data_cb)(const u8 *), void (*byte_cb)(u8), void (*timeout_cb)(void)) {
 	_data_cb = data_cb;
+	_byte_cb = byte_cb;
 	_timeout_cb = timeout_cb;
 	uart_init(_BUS, _SPEED);
 	gpio_set_function(_RX_PIN, GPIO_FUNC_UART);
@@ -55,6 +57,7 @@ void ph_com_uart_init(void (*data_cb)(const u8 *), void (*timeout_cb)(void)) {
 void ph_com_uart_task(void) {
 	if (uart_is_readable(_BUS)) {
 		_buf[_index] = (u8)uart_getc(_BUS);
+		_byte_cb(_buf[_index]);
 		if (_index == 7) {
 			_data_cb(_buf);
 			_index = 0;
@@ -73,3 +76,7 @@ void ph_com_uart_task(void) {
 void ph_com_uart_write(const u8 *data) {
 	uart_write_blocking(_BUS, data, 8);
 }
+
+void ph_com_uart_write_raw(const u8 *data, uz len) {
+	uart_write_blocking(_BUS, data, len);
+}
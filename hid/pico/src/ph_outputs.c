@@ -103,7 +103,7 @@ void ph_outputs_init(void) {
 	}
 
 	if (!o_usb_disabled) {
-		ph_g_outputs_avail |= PH_PROTO_OUT2_HAS_USB;
+		ph_g_outputs_avail |= PH_PROTO_OUT2_HAS_USB | PH_PROTO_OUT2_HAS_USB_NKRO;
 		if (o_usb_enabled_w98) {
 			ph_g_outputs_avail |= PH_PROTO_OUT2_HAS_USB_W98;
 		}
@@ -29,7 +29,8 @@
 #define PH_O_HAS_PS2			(!!(ph_g_outputs_avail & PH_PROTO_OUT2_HAS_PS2))
 #define PH_O_KBD(x_id)			((ph_g_outputs_active & PH_PROTO_OUT1_KBD_MASK) == PH_PROTO_OUT1_KBD_##x_id)
 #define PH_O_MOUSE(x_id)		((ph_g_outputs_active & PH_PROTO_OUT1_MOUSE_MASK) == PH_PROTO_OUT1_MOUSE_##x_id)
-#define PH_O_IS_KBD_USB			PH_O_KBD(USB)
+#define PH_O_IS_KBD_USB			(PH_O_KBD(USB) || PH_O_KBD(USB_NKRO))
+#define PH_O_IS_KBD_USB_NKRO	PH_O_KBD(USB_NKRO)
 #define PH_O_IS_MOUSE_USB		(PH_O_MOUSE(USB_ABS) || PH_O_MOUSE(USB_REL) || PH_O_MOUSE(USB_W98))
 #define PH_O_IS_MOUSE_USB_ABS	(PH_O_MOUSE(USB_ABS) || PH_O_MOUSE(USB_W98))
 #define PH_O_IS_MOUSE_USB_REL	PH_O_MOUSE(USB_REL)
@@ -0,0 +1,51 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#include "ph_profile.h"
+
+#ifdef PH_PROFILE
+
+#include "ph_types.h"
+#include "ph_proto.h"
+
+
+static u32 _hists[PH_PROTO_PROBES_COUNT][PH_PROTO_PROFILE_BUCKETS] = {0};
+
+
+void ph_profile_add(u8 probe, u32 us) {
+	u8 bucket = (us == 0 ? 0 : 32 - __builtin_clz(us)); // Номер старшего бита + 1
+	if (bucket >= PH_PROTO_PROFILE_BUCKETS) {
+		bucket = PH_PROTO_PROFILE_BUCKETS - 1;
+	}
+	u32 *const count = &_hists[probe][bucket];
+	if (*count < 0xFFFFFFFF) {
+		++*count;
+	}
+}
+
+u32 ph_profile_get(u8 probe, u8 bucket) {
+	const u32 value = _hists[probe][bucket];
+	_hists[probe][bucket] = 0; // Хост копит сумму сам, а здесь только прирост с прошлого опроса
+	return value;
+}
+
+#endif
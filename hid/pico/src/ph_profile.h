@@ -0,0 +1,44 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#pragma once
+
+#include "ph_types.h"
+#include "ph_proto.h"
+
+
+#ifdef PH_PROFILE
+#	include "hardware/timer.h"
+
+// Сырой счетчик таймера тикает раз в микросекунду, time_us_32() тут не нужен
+#	define PH_PROFILE_RUN(x_probe, x_call) { \
+			const u32 m_start_ts = timer_hw->timerawl; \
+			x_call; \
+			ph_profile_add(PH_PROTO_PROBE_##x_probe, timer_hw->timerawl - m_start_ts); \
+		}
+
+void ph_profile_add(u8 probe, u32 us);
+u32 ph_profile_get(u8 probe, u8 bucket);
+
+#else
+#	define PH_PROFILE_RUN(x_probe, x_call) { x_call; }
+#endif
@@ -33,6 +33,12 @@
 #define PH_PROTO_RESP_CRC_ERROR			((u8)0x40)
 #define PH_PROTO_RESP_INVALID_ERROR		((u8)0x45)
 #define PH_PROTO_RESP_TIMEOUT_ERROR		((u8)0x48)
+#define PH_PROTO_RESP_STATS				((u8)0x28) // The counter in bytes 2-5, big-endian
+#define PH_PROTO_RESP_TRACE				((u8)0x29) // Microseconds rx->apply in bytes 2-3, rx->report in bytes 4-5
+
+#define PH_PROTO_RESP_RECORD			((u8)0x2A) // A half of the flight recorder entry in bytes 2-5
+
+#define PH_PROTO_TRACE_PENDING			((u16)0xFFFF) // No report after the last input command yet
 
 // Complex response flags
 #define PH_PROTO_PONG_OK				((u8)0b10000000)
@@ -48,6 +54,7 @@
 #define PH_PROTO_OUT1_KBD_MASK			((u8)0b00000111)
 #define PH_PROTO_OUT1_KBD_USB			((u8)0b00000001)
 #define PH_PROTO_OUT1_KBD_PS2			((u8)0b00000011)
+#define PH_PROTO_OUT1_KBD_USB_NKRO		((u8)0b00000101)
 // +
 #define PH_PROTO_OUT1_MOUSE_MASK		((u8)0b00111000)
 #define PH_PROTO_OUT1_MOUSE_USB_ABS		((u8)0b00001000)
@@ -61,12 +68,54 @@
 #define PH_PROTO_OUT2_HAS_USB			((u8)0b00000001)
 #define PH_PROTO_OUT2_HAS_PS2			((u8)0b00000010)
 #define PH_PROTO_OUT2_HAS_USB_W98		((u8)0b00000100)
+#define PH_PROTO_OUT2_HAS_USB_NKRO		((u8)0b00001000)
+
+// Counters for PH_PROTO_CMD_GET_STATS
+#define PH_PROTO_STAT_RX_FRAMES			((u8)0)
+#define PH_PROTO_STAT_CRC_ERRORS		((u8)1)
+#define PH_PROTO_STAT_INVALID_CMDS		((u8)2)
+#define PH_PROTO_STAT_RX_TIMEOUTS		((u8)3)
+#define PH_PROTO_STAT_REPORT_FAILS		((u8)4)
+#define PH_PROTO_STAT_PS2_INHIBITS		((u8)5)
+#define PH_PROTO_STAT_RESET_REQUESTS	((u8)6)
+#define PH_PROTO_STAT_LOOP_MAX_US		((u8)7) // Zeroed on read
+#define PH_PROTO_STATS_COUNT			8
+
+// Probes for PH_PROTO_CMD_GET_PROFILE, log2 histograms in microseconds:
+// bucket 0 is under 1us, bucket N is [2^(N-1), 2^N), the last one also holds everything longer
+#define PH_PROTO_PROBE_LOOP				((u8)0)
+#define PH_PROTO_PROBE_USB				((u8)1)
+#define PH_PROTO_PROBE_PS2				((u8)2)
+#define PH_PROTO_PROBE_STORAGE			((u8)3)
+#define PH_PROTO_PROBE_TRANSPORT		((u8)4)
+#define PH_PROTO_PROBES_COUNT			5
+#define PH_PROTO_PROFILE_BUCKETS		16
+
+// Flight recorder entries for PH_PROTO_CMD_GET_RECORD: the half 0 is the timestamp in microseconds,
+// the half 1 is the type and three bytes of data. Halves 2 and 3 don't need the sequence number,
+// they are the current timestamp and the next sequence number with the number of entries.
+#define PH_PROTO_REC_BOOT				((u8)0x01) // Watchdog reboot flag
+#define PH_PROTO_REC_CMD				((u8)0x02) // Command, two first args
+#define PH_PROTO_REC_RESP				((u8)0x03) // Code or PONG bytes 1-3, PONG only when changed
+#define PH_PROTO_REC_ONLINE				((u8)0x04) // Endpoint, online flag
+#define PH_PROTO_REC_STAT				((u8)0x05) // Counter from PH_PROTO_STAT_*, except RX_FRAMES
+#define PH_PROTO_REC_CH9329				((u8)0x06) // Command, data bytes 0 and 2 (modifiers and the first key)
+// +
+#define PH_PROTO_REC_EP_USB_KBD			((u8)0)
+#define PH_PROTO_REC_EP_USB_MOUSE		((u8)1)
+#define PH_PROTO_REC_EP_PS2_KBD			((u8)2)
+#define PH_PROTO_REC_EP_PS2_MOUSE		((u8)3)
 
 #define PH_PROTO_CMD_PING				((u8)0x01)
 #define PH_PROTO_CMD_REPEAT				((u8)0x02)
 #define PH_PROTO_CMD_SET_KBD			((u8)0x03)
 #define PH_PROTO_CMD_SET_MOUSE			((u8)0x04)
 #define PH_PROTO_CMD_SET_CONNECTED		((u8)0x05)
+#define PH_PROTO_CMD_SET_MOUSE_INTERP	((u8)0x06)
+#define PH_PROTO_CMD_GET_STATS			((u8)0x07)
+#define PH_PROTO_CMD_GET_PROFILE		((u8)0x08) // Probe, bucket; the bucket is zeroed on read
+#define PH_PROTO_CMD_GET_TRACE			((u8)0x09) // Stamps of the last input command
+#define PH_PROTO_CMD_GET_RECORD			((u8)0x0A) // Entry sequence number (2 bytes), half of the entry
 #define PH_PROTO_CMD_CLEAR_HID			((u8)0x10)
 // +
 #define PH_PROTO_CMD_KBD_KEY			((u8)0x11)
@@ -22,11 +22,17 @@
 
 #include "ph_ps2.h"
 
-#include "ph_types.h"
-#include "ph_outputs.h"
+#include <string.h>
 
+#include "pico/stdlib.h"
 #include "hardware/gpio.h"
 
+#include "ph_types.h"
+#include "ph_outputs.h"
+#include "ph_stats.h"
+#include "ph_trace.h"
+#include "ph_recorder.h"
+
 
 #define _LS_POWER_PIN	13
 #define _KBD_DATA_PIN	11 // CLK == 12
@@ -35,6 +41,13 @@
 #define _KBD_IN_DATA_PIN	26 // passthru, CLK == 27
 #define _MOUSE_IN_DATA_PIN	16 // passthru, CLK == 17
 
+// Кадр PS/2 - 11 бит, на 10кГц это 1.1мс. Событие клавиши - до трех байт,
+// мышь шлет не чаще sample rate, а по умолчанию он 100/с. Всё, что хост
+// присылает быстрее, копится здесь, а не в очереди ps2x2pico.
+#define _KBD_QUEUE_SIZE		64
+#define _KBD_EVENT_US		3300
+#define _MOUSE_PACKET_US	10000
+
 
 u8 ph_g_ps2_kbd_leds = 0;
 bool ph_g_ps2_kbd_online = 0;
@@ -43,6 +56,30 @@ bool ph_g_ps2_mouse_online = 0;
 u8 ph_ps2_kbd_modifiers = 0;
 u8 ph_ps2_mouse_buttons = 0;
 
+static bool _kbd_inited = false;
+static bool _mouse_inited = false;
+
+static struct {
+	u8		key;
+	bool	state;
+} _kbd_queue[_KBD_QUEUE_SIZE];
+static u8 _kbd_queue_head = 0;
+static u8 _kbd_queue_count = 0;
+static u64 _kbd_sent_ts = 0;
+static u8 _kbd_report_mods = 0; // The last state from ph_ps2_kbd_send_report()
+static u8 _kbd_report_keys[6] = {0};
+
+static s32 _mouse_x = 0;
+static s32 _mouse_y = 0;
+static s32 _mouse_v = 0;
+static u8 _mouse_sent_buttons = 0;
+static u64 _mouse_sent_ts = 0;
+
+
+static bool _kbd_has_key(const u8 *keys, u8 key);
+static void _kbd_send_next(void);
+static void _mouse_send_packet(void);
+
 
 void tuh_kb_set_leds(u8 leds) {
 	ph_g_ps2_kbd_leds = leds;
@@ -59,48 +96,114 @@ void ph_ps2_init(void) {
 		gpio_init(x_pin); gpio_set_dir(x_pin, GPIO_IN); \
 		gpio_init(x_pin + 1); gpio_set_dir(x_pin + 1, GPIO_IN); \
 	}
+	INIT_STUB(_KBD_DATA_PIN);
+	INIT_STUB(_MOUSE_DATA_PIN);
+#	undef INIT_STUB
 
-	if (PH_O_IS_KBD_PS2) {
+	ph_ps2_reconfigure();
+}
+
+void ph_ps2_reconfigure(void) {
+	// PIO-программы ps2x2pico нельзя выгрузить, поэтому драйвер запускается
+	// один раз при первом переключении на PS/2 и дальше просто простаивает,
+	// если выход переключили обратно на USB.
+	if (PH_O_IS_KBD_PS2 && !_kbd_inited) {
 		kb_init(_KBD_DATA_PIN, _KBD_IN_DATA_PIN);
-	} else {
-		INIT_STUB(_KBD_DATA_PIN);
+		_kbd_inited = true;
 	}
-
-	if (PH_O_IS_MOUSE_PS2) {
+	if (PH_O_IS_MOUSE_PS2 && !_mouse_inited) {
 		ms_init(_MOUSE_DATA_PIN, _MOUSE_IN_DATA_PIN);
-	} else {
-		INIT_STUB(_MOUSE_DATA_PIN);
+		_mouse_inited = true;
 	}
-
-#	undef INIT_STUB
+	ph_ps2_kbd_modifiers = 0;
+	ph_ps2_mouse_buttons = 0;
+	_kbd_queue_count = 0;
+	_kbd_report_mods = 0;
+	memset(_kbd_report_keys, 0, 6);
+	_mouse_x = 0;
+	_mouse_y = 0;
+	_mouse_v = 0;
+	_mouse_sent_buttons = 0;
 }
 
 void ph_ps2_task(void) {
+	const u64 now_ts = time_us_64();
+
 	if (PH_O_IS_KBD_PS2) {
-		ph_g_ps2_kbd_online = kb_task();
+		const bool online = kb_task();
+		if (ph_g_ps2_kbd_online != online) {
+			ph_recorder_add(PH_PROTO_REC_ONLINE, PH_PROTO_REC_EP_PS2_KBD, online, 0);
+			if (!online) {
+				PH_STATS_INC(PS2_INHIBITS); // ps2x2pico считает клавиатуру оффлайн, пока хост держит линию
+			}
+		}
+		ph_g_ps2_kbd_online = online;
+		if (_kbd_queue_count > 0 && now_ts >= _kbd_sent_ts + _KBD_EVENT_US) {
+			_kbd_send_next();
+			_kbd_sent_ts = now_ts;
+		}
 	}
 
 	if (PH_O_IS_MOUSE_PS2) {
-		ph_g_ps2_mouse_online = ms_task();
+		const bool online = ms_task();
+		if (ph_g_ps2_mouse_online != online) {
+			ph_recorder_add(PH_PROTO_REC_ONLINE, PH_PROTO_REC_EP_PS2_MOUSE, online, 0);
+		}
+		ph_g_ps2_mouse_online = online;
+		if (now_ts >= _mouse_sent_ts + _MOUSE_PACKET_US) {
+			if (_mouse_x != 0 || _mouse_y != 0 || _mouse_v != 0 || ph_ps2_mouse_buttons != _mouse_sent_buttons) {
+				_mouse_send_packet();
+				_mouse_sent_ts = now_ts;
+			}
+		}
 	}
 }
 
 void ph_ps2_kbd_send_key(u8 key, bool state) {
 	if (PH_O_IS_KBD_PS2) {
-		if (key >= 0xe0 && key <= 0xe7) {
-			if (state) {
-				ph_ps2_kbd_modifiers = ph_ps2_kbd_modifiers | (1 << (key - 0xe0));
-			} else {
-				ph_ps2_kbd_modifiers = ph_ps2_kbd_modifiers & ~(1 << (key - 0xe0));
-			}
+		if (_kbd_queue_count >= _KBD_QUEUE_SIZE) {
+			_kbd_send_next(); // Не теряем отпускания, пусть лучше копится в ps2x2pico
 		}
+		const u8 index = (_kbd_queue_head + _kbd_queue_count) % _KBD_QUEUE_SIZE;
+		_kbd_queue[index].key = key;
+		_kbd_queue[index].state = state;
+		++_kbd_queue_count;
+	}
+}
 
-		kb_send_key(key, state, ph_ps2_kbd_modifiers);
+void ph_ps2_kbd_send_report(u8 mods, const u8 *keys) {
+	if (PH_O_IS_KBD_PS2) {
+		// У PS/2 нет отчетов, поэтому разница с прошлым состоянием превращается
+		// в make/break: сначала отпускания, потом модификаторы, потом нажатия
+		for (u8 i = 0; i < 6; ++i) {
+			if (_kbd_report_keys[i] > 0 && !_kbd_has_key(keys, _kbd_report_keys[i])) {
+				ph_ps2_kbd_send_key(_kbd_report_keys[i], false);
+			}
+		}
+		for (u8 bit = 0; bit < 8; ++bit) {
+			if ((_kbd_report_mods ^ mods) & (1 << bit)) {
+				ph_ps2_kbd_send_key(0xe0 + bit, mods & (1 << bit));
+			}
+		}
+		for (u8 i = 0; i < 6; ++i) {
+			if (keys[i] > 0 && !_kbd_has_key(_kbd_report_keys, keys[i])) {
+				ph_ps2_kbd_send_key(keys[i], true);
+			}
+		}
+		_kbd_report_mods = mods;
+		memcpy(_kbd_report_keys, keys, 6);
 	}
 }
 
 void ph_ps2_mouse_send_button(u8 button, bool state) {
 	if (PH_O_IS_MOUSE_PS2) {
+		if (ph_ps2_mouse_buttons != _mouse_sent_buttons) {
+			// Предыдущее изменение кнопок еще не ушло, склеивать нельзя,
+			// иначе быстрый клик пропадет целиком.
+			_mouse_send_packet();
+			_mouse_sent_ts = time_us_64();
+		}
+
 		button--;
 
 		if (state) {
@@ -108,26 +211,42 @@ void ph_ps2_mouse_send_button(u8 button, bool state) {
 		} else {
 			ph_ps2_mouse_buttons = ph_ps2_mouse_buttons & ~(1 << button);
 		}
-
-		ms_send_movement(ph_ps2_mouse_buttons, 0, 0, 0);
 	}
 }
 
 void ph_ps2_mouse_send_rel(s8 x, s8 y) {
 	if (PH_O_IS_MOUSE_PS2) {
-		ms_send_movement(ph_ps2_mouse_buttons, x, y, 0);
+		_mouse_x += x;
+		_mouse_y += y;
 	}
 }
 
 void ph_ps2_mouse_send_wheel(s8 h, s8 v) {
 	if (PH_O_IS_MOUSE_PS2) {
 		(void)h; // as far as I know there is no standard way for horizontal scrolling
-		ms_send_movement(ph_ps2_mouse_buttons, 0, 0, v);
+		_mouse_v += v;
+	}
+}
+
+void ph_ps2_mouse_send_report(u8 buttons, s8 x, s8 y, s8 v) {
+	if (PH_O_IS_MOUSE_PS2) {
+		if (buttons != ph_ps2_mouse_buttons && ph_ps2_mouse_buttons != _mouse_sent_buttons) {
+			_mouse_send_packet(); // The same as for the single buttons
+			_mouse_sent_ts = time_us_64();
+		}
+		ph_ps2_mouse_buttons = buttons;
+		_mouse_x += x;
+		_mouse_y += y;
+		_mouse_v += v;
 	}
 }
 
 void ph_ps2_send_clear(void) {
 	if (PH_O_IS_KBD_PS2) {
+		_kbd_queue_count = 0;
+		_kbd_report_mods = 0;
+		memset(_kbd_report_keys, 0, 6);
+
 		//for(u8 key = 0xe0; key <= 0xe7; key++) {
 		//	kb_send_key(key, false, 0);
 		//}
@@ -138,6 +257,53 @@ void ph_ps2_send_clear(void) {
 	}
 
 	if (PH_O_IS_MOUSE_PS2) {
+		_mouse_x = 0;
+		_mouse_y = 0;
+		_mouse_v = 0;
+		_mouse_sent_buttons = 0;
 		ms_send_movement(0, 0, 0, 0);
 	}
 }
+
+static bool _kbd_has_key(const u8 *keys, u8 key) {
+	for (u8 i = 0; i < 6; ++i) {
+		if (keys[i] == key) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void _kbd_send_next(void) {
+	const u8 key = _kbd_queue[_kbd_queue_head].key;
+	const bool state = _kbd_queue[_kbd_queue_head].state;
+	_kbd_queue_head = (_kbd_queue_head + 1) % _KBD_QUEUE_SIZE;
+	--_kbd_queue_count;
+
+	if (key >= 0xe0 && key <= 0xe7) {
+		if (state) {
+			ph_ps2_kbd_modifiers = ph_ps2_kbd_modifiers | (1 << (key - 0xe0));
+		} else {
+			ph_ps2_kbd_modifiers = ph_ps2_kbd_modifiers & ~(1 << (key - 0xe0));
+		}
+	}
+
+	kb_send_key(key, state, ph_ps2_kbd_modifiers);
+	ph_trace_submitted();
+}
+
+static void _mouse_send_packet(void) {
+	// Остаток, не влезший в пакет, уйдет в следующем
+#	define TAKE(x_acc, x_min, x_max) ({ \
+			const s32 m_part = (x_acc < x_min ? x_min : (x_acc > x_max ? x_max : x_acc)); \
+			x_acc -= m_part; \
+			(s8)m_part; \
+		})
+	const s8 x = TAKE(_mouse_x, -127, 127);
+	const s8 y = TAKE(_mouse_y, -127, 127);
+	const s8 v = TAKE(_mouse_v, -8, 7); // 4-bit Z of the IntelliMouse
+#	undef TAKE
+	ms_send_movement(ph_ps2_mouse_buttons, x, y, v);
+	ph_trace_submitted();
+	_mouse_sent_buttons = ph_ps2_mouse_buttons;
+}
@@ -0,0 +1,64 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#include "ph_recorder.h"
+
+#include "pico/stdlib.h"
+
+#include "ph_types.h"
+#include "ph_proto.h"
+
+
+static struct {
+	u32 ts;
+	u32 data; // Type and three bytes
+} _ring[PH_RECORDER_SIZE];
+
+static u16 _next_seq = 0;
+static u16 _count = 0;
+
+
+void ph_recorder_add(u8 type, u8 a, u8 b, u8 c) {
+	// Горячий путь: никаких проверок, только запись в кольцо
+	const u16 index = _next_seq & (PH_RECORDER_SIZE - 1);
+	_ring[index].ts = time_us_32();
+	_ring[index].data = ((u32)type << 24) | ((u32)a << 16) | ((u32)b << 8) | c;
+	++_next_seq;
+	if (_count < PH_RECORDER_SIZE) {
+		++_count;
+	}
+}
+
+bool ph_recorder_get(u16 seq, u8 half, u32 *value) {
+	switch (half) {
+		case 0: case 1: break;
+		case 2: *value = time_us_32(); return true;
+		case 3: *value = ((u32)_next_seq << 16) | _count; return true;
+		default: return false;
+	}
+	if ((u16)(_next_seq - seq - 1) >= _count) {
+		return false; // Еще не записана или уже затерта
+	}
+	const u16 index = seq & (PH_RECORDER_SIZE - 1);
+	*value = (half == 0 ? _ring[index].ts : _ring[index].data);
+	return true;
+}
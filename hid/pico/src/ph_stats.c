@@ -0,0 +1,38 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#include "ph_stats.h"
+
+#include "ph_types.h"
+#include "ph_proto.h"
+
+
+u32 ph_g_stats[PH_PROTO_STATS_COUNT] = {0};
+
+
+u32 ph_stats_get(u8 index) {
+	const u32 value = ph_g_stats[index];
+	if (index == PH_PROTO_STAT_LOOP_MAX_US) {
+		ph_g_stats[index] = 0; // Максимум за период между опросами, а не с загрузки
+	}
+	return value;
+}
@@ -22,25 +22,22 @@
 
 #pragma once
 
+#include "ph_types.h"
+#include "ph_proto.h"
+#include "ph_recorder.h"
 
-enum Ps2KeyType : uint8_t {
-	PS2_KEY_TYPE_UNKNOWN = 0,
-	PS2_KEY_TYPE_REG = 1,
-	PS2_KEY_TYPE_SPEC = 2,
-	PS2_KEY_TYPE_PRINT = 3,
-	PS2_KEY_TYPE_PAUSE = 4,
-};
-
-<%! import operator %>
-void keymapPs2(uint8_t code, Ps2KeyType *ps2_type, uint8_t *ps2_code) {
-	*ps2_type = PS2_KEY_TYPE_UNKNOWN;
-	*ps2_code = 0;
-
-	switch (code) {
-% for km in sorted(keymap, key=operator.attrgetter("mcu_code")):
-	% if km.ps2_key is not None:
-		case ${km.mcu_code}: *ps2_type = PS2_KEY_TYPE_${km.ps2_key.type.upper()}; *ps2_code = ${km.ps2_key.code}; return; // ${km.web_name}
-	% endif
-% endfor
+
+extern u32 ph_g_stats[PH_PROTO_STATS_COUNT];
+
+#define PH_STATS_INC(x_stat) { \
+		++ph_g_stats[PH_PROTO_STAT_##x_stat]; \
+		if (PH_PROTO_STAT_##x_stat != PH_PROTO_STAT_RX_FRAMES) { \
+			ph_recorder_add(PH_PROTO_REC_STAT, PH_PROTO_STAT_##x_stat, 0, 0); \
+		} \
+	}
+#define PH_STATS_MAX(x_stat, x_value) { \
+		if (ph_g_stats[PH_PROTO_STAT_##x_stat] < (x_value)) { ph_g_stats[PH_PROTO_STAT_##x_stat] = (x_value); } \
 	}
-}
+
+
+u32 ph_stats_get(u8 index);
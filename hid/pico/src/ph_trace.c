@@ -0,0 +1,61 @@
+/*****************************************************************************
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+*****************************************************************************/
+
+
+#include "ph_trace.h"
+
+#include "pico/stdlib.h"
+
+#include "ph_types.h"
+#include "ph_proto.h"
+
+
+static u32 _rx_ts = 0;
+static u16 _apply_us = 0;
+static u16 _report_us = PH_PROTO_TRACE_PENDING;
+static bool _armed = false; // Ждем первый отчет после входной команды
+
+
+static u16 _clamp_us(u32 us) {
+	return (us >= PH_PROTO_TRACE_PENDING ? PH_PROTO_TRACE_PENDING - 1 : us);
+}
+
+void ph_trace_begin(void) {
+	_rx_ts = time_us_32();
+	_apply_us = 0;
+	_report_us = PH_PROTO_TRACE_PENDING;
+	_armed = true;
+}
+
+void ph_trace_applied(void) {
+	_apply_us = _clamp_us(time_us_32() - _rx_ts);
+}
+
+void ph_trace_submitted(void) {
+	if (_armed) {
+		_report_us = _clamp_us(time_us_32() - _rx_ts);
+		_armed = false;
+	}
+}
+
+u32 ph_trace_get(void) {
+	return (((u32)_apply_us) << 16) | _report_us;
+}
@@ -30,6 +30,7 @@
 typedef int8_t s8;
 typedef int16_t s16;
 typedef int32_t s32;
+typedef int64_t s64;
 
 typedef size_t uz;
 typedef uint8_t u8;
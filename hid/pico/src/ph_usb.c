@@ -37,73 +37,163 @@
 #include "ph_outputs.h"
 #include "ph_usb_kbd.h"
 #include "ph_usb_mouse.h"
+#include "ph_stats.h"
+#include "ph_trace.h"
+#include "ph_recorder.h"
 
 
 u8 ph_g_usb_kbd_leds = 0;
 bool ph_g_usb_kbd_online = true;
 bool ph_g_usb_mouse_online = true;
 
-static int _kbd_iface = -1;
-static int _mouse_iface = -1;
+#define _RECONNECT_DELAY_US		100000 // Enough for the host to notice the disconnection
+#define _KBD_QUEUE_SIZE			64
+#define _REPORT_TIMEOUT_US		50000 // The host doesn't poll the endpoint, so it's offline
+
+
+static bool _inited = false;
+static u8 _layout = 0;
+static u64 _reconnect_ts = 0;
+
+static bool _bus_online = false; // Mounted and not suspended
+static bool _kbd_stuck = false; // The first keyboard's report is not taken in time
+static bool _kbd_force = false; // Resend the keyboard state after (re)connection
+static bool _mouse_stuck = false;
+static u64 _mouse_sent_ts = 0;
 
-static u8 _kbd_mods = 0;
-static u8 _kbd_keys[6] = {0};
-#define _KBD_CLEAR { _kbd_mods = 0; memset(_kbd_keys, 0, 6); }
+static int _kbd_iface = -1; // The first keyboard, others have the next numbers
+static u8 _kbd_ifaces = 0; // Keyboards in the descriptor, only one for NKRO
+static int _mouse_iface = -1;
+static bool _desc_filled = false;
+
+static u8 _kbd_used = 0b1; // Keyboard interfaces bound by the host driver
+static u8 _kbd_mods = 0; // Modifiers are reported by the first keyboard only
+static u8 _kbd_keys[PH_USB_KBD_IFACES][6] = {0};
+static u8 _kbd_bitmap[PH_USB_KBD_NKRO_KEYS / 8] = {0}; // The keys for NKRO instead of _kbd_keys
+static bool _kbd_dirty[PH_USB_KBD_IFACES] = {0};
+static u64 _kbd_sent_ts[PH_USB_KBD_IFACES] = {0}; // Non-zero if the report is not completed yet
+
+static struct {
+	u8		key;
+	bool	state;
+} _kbd_queue[_KBD_QUEUE_SIZE];
+static u8 _kbd_queue_head = 0;
+static u8 _kbd_queue_len = 0;
+
+#define _KBD_CLEAR { \
+		_kbd_mods = 0; \
+		memset(_kbd_keys, 0, sizeof(_kbd_keys)); \
+		memset(_kbd_bitmap, 0, sizeof(_kbd_bitmap)); \
+		_kbd_queue_len = 0; \
+	}
+#define _KBD_RESET { \
+		_KBD_CLEAR; \
+		memset(_kbd_dirty, 0, sizeof(_kbd_dirty)); \
+		memset(_kbd_sent_ts, 0, sizeof(_kbd_sent_ts)); \
+	}
 
 static u8 _mouse_buttons = 0;
 static s16 _mouse_abs_x = 0;
 static s16 _mouse_abs_y = 0;
+static bool _mouse_abs_pending = false; // The buttons wait for the report in flight
 #define _MOUSE_CLEAR { _mouse_buttons = 0; }
 
-
-static void _kbd_sync_report(bool new);
+static u8 _mouse_interp_ms = 0; // Max look-ahead, 0 is the exact passthrough
+static struct {
+	bool	active;
+	s16		from_x;
+	s16		from_y;
+	s16		to_x;
+	s16		to_y;
+	u64		start_ts;
+	u64		duration_us;
+	u64		cmd_ts; // When the previous position came from the host
+} _mouse_interp = {0};
+
+
+static u8 _get_layout(void);
+static void _update_online(void);
+static bool _is_kbd_iface(u8 iface);
+static bool _kbd_is_pending(void);
+static void _kbd_queue_push(u8 key, bool state);
+static void _kbd_fill_batch(void);
+static int _kbd_apply(u8 key, bool state, u8 min_index, u8 used, bool evict);
+static void _kbd_sync_report(bool force);
+static bool _kbd_nkro_send_report(void);
+static void _mouse_interp_step(u64 now_ts);
+static void _mouse_interp_flush(void);
 static void _mouse_abs_send_report(s8 h, s8 v);
 static void _mouse_rel_send_report(s8 x, s8 y, s8 h, s8 v);
 
 
 void ph_usb_init(void) {
-	if (ph_g_is_bridge || PH_O_IS_KBD_USB || PH_O_IS_MOUSE_USB) {
+	_layout = _get_layout();
+	if (ph_g_is_bridge || _layout) {
 		tud_init(0);
+		_inited = true;
+	}
+	_update_online();
+}
+
+void ph_usb_reconfigure(void) {
+	if (ph_g_is_bridge) {
+		return;
 	}
+	const u8 layout = _get_layout();
+	if (layout == _layout) {
+		return; // Interfaces are the same, nothing to re-enumerate (USB_ABS <-> USB_W98 for example)
+	}
+	_layout = layout;
+
+	_KBD_RESET;
+	_MOUSE_CLEAR;
+	_mouse_interp.active = false;
+	_kbd_used = 0b1;
+	_kbd_iface = -1;
+	_kbd_ifaces = 0;
+	_mouse_iface = -1;
+	_desc_filled = false; // The host will get the new descriptor after reconnection
+	_bus_online = false; // Until the host mounts the new configuration
+	_update_online();
+
+	if (!_inited) {
+		if (layout) {
+			tud_init(0);
+			_inited = true;
+		}
+		return;
+	}
+	tud_disconnect();
+	_reconnect_ts = (layout ? time_us_64() + _RECONNECT_DELAY_US : 0);
 }
 
 void ph_usb_task(void) {
-	if (ph_g_is_bridge || PH_O_IS_KBD_USB || PH_O_IS_MOUSE_USB) {
+	if (_inited) {
 		tud_task();
 
-		static u64 next_ts = 0;
 		const u64 now_ts = time_us_64();
-		if (next_ts == 0 || now_ts >= next_ts) {
-#			define CHECK_IFACE(x_dev) \
-				static u64 offline_ts = 0; \
-				static bool prev_online = true; \
-				const bool online = (tud_ready() && tud_hid_n_ready(_##x_dev##_iface)); \
-				bool force = false; \
-				if (online) { \
-					if (!ph_g_usb_##x_dev##_online) { \
-						force = true; /* Если был переход из долгого оффлайна в онлайн */ \
-					} \
-					ph_g_usb_##x_dev##_online = true; \
-					offline_ts = 0; \
-				} else if (prev_online && !online) { \
-					offline_ts = now_ts; /* Начинаем отсчет для долгого оффлайна */ \
-				} else if (!prev_online && !online && offline_ts + 50000 < now_ts) { \
-					ph_g_usb_##x_dev##_online = false; /* Долгий оффлайн найден */ \
-				} \
-				prev_online = online;
-
-			if (_kbd_iface >= 0) {
-				CHECK_IFACE(kbd);
-				_kbd_sync_report(force);
-			}
+		if (_reconnect_ts > 0 && now_ts >= _reconnect_ts) {
+			tud_connect();
+			_reconnect_ts = 0;
+		}
 
-			if (_mouse_iface >= 0) {
-				CHECK_IFACE(mouse);
-				(void)force;
-			}
+		if (_kbd_iface >= 0) {
+			// Submit the next batch as soon as the previous one is completed
+			_kbd_sync_report(_kbd_force);
+			_kbd_force = false;
+		}
+
+		if (_mouse_abs_pending && _mouse_sent_ts == 0) {
+			_mouse_abs_send_report(0, 0);
+		}
+		if (_mouse_interp.active && _mouse_sent_ts == 0) {
+			_mouse_interp_step(now_ts); // The next point after the host took the previous one
+		}
 
-#			undef CHECK_IFACE
-			next_ts = time_us_64() + 1000; // Every 1 ms
+		if (_mouse_sent_ts > 0 && now_ts >= _mouse_sent_ts + _REPORT_TIMEOUT_US) {
+			_mouse_sent_ts = 0;
+			_mouse_stuck = true;
+			_update_online();
 		}
 	}
 }
@@ -112,39 +202,34 @@ void ph_usb_kbd_send_key(u8 key, bool state) {
 	if (_kbd_iface < 0) {
 		return; // Допускаем планирование нажатия, пока устройство не готово
 	}
+	_kbd_queue_push(key, state);
+	_kbd_sync_report(false);
+}
 
-	if (key >= HID_KEY_CONTROL_LEFT && key <= HID_KEY_GUI_RIGHT) { // 0xE0...0xE7 - Modifiers
-		key = 1 << (key & 0x07); // Номер означает сдвиг
-		if (state) {
-			_kbd_mods |= key;
-		} else {
-			_kbd_mods &= ~key;
-		}
-
-	} else { // Regular keys
-		if (state) {
-			s8 pos = -1;
-			for (u8 i = 0; i < 6; ++i) {
-				if (_kbd_keys[i] == key) {
-					goto already_pressed;
-				} else if (_kbd_keys[i] == 0) {
-					pos = i;
-				}
-			}
-			_kbd_keys[pos >= 0 ? pos : 0] = key;
-			// already_pressed:
-		} else {
-			for (u8 i = 0; i < 6; ++i) {
-				if (_kbd_keys[i] == key) {
-					_kbd_keys[i] = 0;
-					break;
-				}
+void ph_usb_kbd_send_report(u8 mods, const u8 *keys) {
+	// Готовое состояние целиком заменяет очередь событий и уходит одним отчетом.
+	// Если предыдущий еще не забрали, следующий просто перезапишет этот.
+	if (_kbd_iface < 0) {
+		return;
+	}
+	if (_kbd_is_pending()) {
+		PH_STATS_INC(REPORT_FAILS); // Неотправленное состояние потеряно
+	}
+	_KBD_CLEAR;
+	_kbd_mods = mods;
+	if (PH_O_IS_KBD_USB_NKRO) {
+		for (u8 i = 0; i < 6; ++i) {
+			if (keys[i] > 0 && keys[i] < PH_USB_KBD_NKRO_KEYS) {
+				_kbd_bitmap[keys[i] >> 3] |= 1 << (keys[i] & 0x07);
 			}
 		}
+	} else {
+		memcpy(_kbd_keys[0], keys, 6);
 	}
-	already_pressed: // Old GCC doesn't like ^ that label in the end of block
-
-	_kbd_sync_report(true);
+	for (u8 index = 0; index < PH_USB_KBD_IFACES; ++index) {
+		_kbd_dirty[index] = (_kbd_used & (1 << index)); // The other keyboards are released
+	}
+	_kbd_sync_report(false);
 }
 
 void ph_usb_mouse_send_button(u8 button, bool state) {
@@ -157,20 +242,55 @@ void ph_usb_mouse_send_button(u8 button, bool state) {
 		_mouse_buttons &= ~button;
 	}
 	if (PH_O_IS_MOUSE_USB_ABS) {
-		_mouse_abs_send_report(0, 0);
+		_mouse_interp_flush(); // Click exactly where the host asked
+		if (_mouse_sent_ts > 0) {
+			// С интерполяцией эндпоинт почти всегда занят шагом, клик не должен потеряться
+			_mouse_abs_pending = true;
+		} else {
+			_mouse_abs_send_report(0, 0);
+		}
 	} else { // PH_O_IS_MOUSE_USB_REL
 		_mouse_rel_send_report(0, 0, 0, 0);
 	}
 }
 
 void ph_usb_mouse_send_abs(s16 x, s16 y) {
-	if (PH_O_IS_MOUSE_USB_ABS) {
+	if (!PH_O_IS_MOUSE_USB_ABS) {
+		return;
+	}
+	if (_mouse_interp_ms == 0) {
 		_mouse_abs_x = x;
 		_mouse_abs_y = y;
 		_mouse_abs_send_report(0, 0);
+		return;
+	}
+
+	// Интервал между точками от хоста предсказывает, когда придет следующая,
+	// поэтому курсор доезжает до цели как раз к ней, но не дольше look-ahead.
+	// Движение идет от текущей выданной позиции, так что перелета не бывает.
+	const u64 now_ts = time_us_64();
+	u64 duration_us = now_ts - _mouse_interp.cmd_ts;
+	if (duration_us > (u64)_mouse_interp_ms * 1000) {
+		duration_us = (u64)_mouse_interp_ms * 1000;
+	}
+	_mouse_interp.cmd_ts = now_ts;
+	_mouse_interp.from_x = _mouse_abs_x;
+	_mouse_interp.from_y = _mouse_abs_y;
+	_mouse_interp.to_x = x;
+	_mouse_interp.to_y = y;
+	_mouse_interp.start_ts = now_ts;
+	_mouse_interp.duration_us = duration_us;
+	_mouse_interp.active = true;
+	if (_mouse_sent_ts == 0) {
+		_mouse_interp_step(now_ts);
 	}
 }
 
+void ph_usb_mouse_set_interpolation(u8 lookahead_ms) {
+	_mouse_interp_flush();
+	_mouse_interp_ms = lookahead_ms;
+}
+
 void ph_usb_mouse_send_rel(s8 x, s8 y) {
 	if (PH_O_IS_MOUSE_USB_REL) {
 		_mouse_rel_send_report(x, y, 0, 0);
@@ -179,49 +299,400 @@ void ph_usb_mouse_send_rel(s8 x, s8 y) {
 
 void ph_usb_mouse_send_wheel(s8 h, s8 v) {
 	if (PH_O_IS_MOUSE_USB_ABS) {
+		_mouse_interp_flush();
 		_mouse_abs_send_report(h, v);
 	} else { // PH_O_IS_MOUSE_USB_REL
 		_mouse_rel_send_report(0, 0, h, v);
 	}
 }
 
+void ph_usb_mouse_send_report(u8 buttons, s8 x, s8 y, s8 v) {
+	// Кнопки, движение и колесо одним отчетом: по отдельности два из трех
+	// обычно теряются на занятом эндпоинте
+	if (!PH_O_IS_MOUSE_USB) {
+		return;
+	}
+	_mouse_buttons = buttons;
+	if (PH_O_IS_MOUSE_USB_ABS) {
+		_mouse_interp_flush();
+		_mouse_abs_send_report(0, v); // The relative motion has no meaning here
+	} else { // PH_O_IS_MOUSE_USB_REL
+		_mouse_rel_send_report(x, y, 0, v);
+	}
+}
+
+void ph_usb_mouse_send_abs_report(u8 buttons, s16 x, s16 y, s8 v) {
+	if (!PH_O_IS_MOUSE_USB_ABS) {
+		return;
+	}
+	if (buttons == _mouse_buttons && v == 0) {
+		ph_usb_mouse_send_abs(x, y); // Just a move, it may be interpolated
+		return;
+	}
+	_mouse_interp_flush();
+	_mouse_buttons = buttons;
+	_mouse_abs_x = x;
+	_mouse_abs_y = y;
+	_mouse_abs_send_report(0, v);
+}
+
 void ph_usb_send_clear(void) {
 	if (PH_O_IS_KBD_USB) {
 		_KBD_CLEAR;
+		memset(_kbd_dirty, 0, sizeof(_kbd_dirty)); // Drop the unsent batch, the force will send empty reports
 		_kbd_sync_report(true);
 	}
 	if (PH_O_IS_MOUSE_USB) {
 		_MOUSE_CLEAR;
 		if (PH_O_IS_MOUSE_USB_ABS) {
-			_mouse_abs_send_report(_mouse_abs_x, _mouse_abs_y);
+			_mouse_interp_flush();
+			_mouse_abs_send_report(0, 0);
 		} else { // PH_O_IS_MOUSE_USB_REL
 			_mouse_rel_send_report(0, 0, 0, 0);
 		}
 	}
 }
 
+static void _update_online(void) {
+	// Все изменения состояния идут из коллбеков TinyUSB и таймаутов отчетов,
+	// а горячий путь (PONG) только читает готовые флаги
+	const bool kbd_online = (_bus_online && !_kbd_stuck);
+	const bool mouse_online = (_bus_online && !_mouse_stuck);
+	if (ph_g_usb_kbd_online != kbd_online) {
+		ph_recorder_add(PH_PROTO_REC_ONLINE, PH_PROTO_REC_EP_USB_KBD, kbd_online, 0);
+	}
+	if (ph_g_usb_mouse_online != mouse_online) {
+		ph_recorder_add(PH_PROTO_REC_ONLINE, PH_PROTO_REC_EP_USB_MOUSE, mouse_online, 0);
+	}
+	ph_g_usb_kbd_online = kbd_online;
+	ph_g_usb_mouse_online = mouse_online;
+}
+
+static bool _is_kbd_iface(u8 iface) {
+	return (_kbd_iface >= 0 && iface >= _kbd_iface && iface < _kbd_iface + _kbd_ifaces);
+}
+
+static u8 _get_layout(void) {
+	// Set of HID interfaces in the configuration descriptor
+	return (
+		(PH_O_IS_KBD_USB ? 0b001 : 0)
+		| (PH_O_IS_KBD_USB_NKRO ? 0b1000 : 0)
+		| (PH_O_IS_MOUSE_USB_ABS ? 0b010 : 0)
+		| (PH_O_IS_MOUSE_USB_REL ? 0b100 : 0)
+	);
+}
+
+
+//--------------------------------------------------------------------
+// Keyboard events scheduler
+//--------------------------------------------------------------------
+
+// События раскладываются по батчам. Батч - это набор отчетов, которые
+// отправляются одновременно (по одному на интерфейс) и считаются
+// доставленными, когда хост забрал их все. Порядок обработки отчетов
+// внутри батча хостом не гарантирован, поэтому:
+//   - изменение модификаторов всегда идет отдельным батчем;
+//   - одна клавиша попадает в батч не больше одного раза, ее следующие
+//     события откладываются до следующего батча;
+//   - нажатия идут в порядке возрастания номеров интерфейсов, по одному
+//     на интерфейс (хосты опрашивают эндпоинты одного устройства по порядку)
+//     и никогда не обгоняют друг друга;
+//   - отпускания могут идти вместе с чем угодно, а нажатия других клавиш
+//     могут обгонять отложенные отпускания (это просто rollover).
+// С одним интерфейсом это дает одно нажатие на фрейм вместо склеивания
+// быстрых нажатий в общее состояние.
+
+#define _IS_KBD_MOD(x_key)	((x_key) >= HID_KEY_CONTROL_LEFT && (x_key) <= HID_KEY_GUI_RIGHT) // 0xE0...0xE7
+
+static bool _kbd_is_pending(void) {
+	for (u8 index = 0; index < PH_USB_KBD_IFACES; ++index) {
+		if (_kbd_dirty[index]) {
+			return true;
+		}
+	}
+	return (_kbd_queue_len > 0);
+}
+
+static void _kbd_queue_push(u8 key, bool state) {
+	if (_kbd_queue_len >= _KBD_QUEUE_SIZE) {
+		// Хост шлет события быстрее, чем их забирает USB:
+		// схлопываем очередь в текущее состояние, как было до батчей
+		PH_STATS_INC(REPORT_FAILS);
+		for (; _kbd_queue_len > 0; --_kbd_queue_len) {
+			_kbd_apply(_kbd_queue[_kbd_queue_head].key, _kbd_queue[_kbd_queue_head].state, 0, _kbd_used, true);
+			_kbd_queue_head = (_kbd_queue_head + 1) % _KBD_QUEUE_SIZE;
+		}
+	}
+	const u8 tail = (_kbd_queue_head + _kbd_queue_len) % _KBD_QUEUE_SIZE;
+	_kbd_queue[tail].key = key;
+	_kbd_queue[tail].state = state;
+	++_kbd_queue_len;
+}
+
+static void _kbd_fill_batch(void) {
+	u8 used = _kbd_used;
+	if (tud_hid_n_get_protocol(_kbd_iface) == HID_PROTOCOL_BOOT) {
+		used = 0b1; // BIOS works with the first keyboard only
+	}
+
+	u8 touched[_KBD_QUEUE_SIZE]; // Keys which are in the batch or deferred to the next one
+	u8 touched_len = 0;
+	bool taken[_KBD_QUEUE_SIZE] = {0};
+	u8 min_index = 0; // The next press should go to this keyboard or further
+
+	for (u8 n = 0; n < _KBD_QUEUE_SIZE && n < _kbd_queue_len; ++n) {
+		const u8 pos = (_kbd_queue_head + n) % _KBD_QUEUE_SIZE;
+		const u8 key = _kbd_queue[pos].key;
+		const bool state = _kbd_queue[pos].state;
+
+		if (_IS_KBD_MOD(key)) {
+			if (touched_len == 0) {
+				_kbd_apply(key, state, 0, used, true);
+				taken[n] = true;
+			}
+			break; // Modifiers can't be mixed with anything
+		}
+
+		bool deferred = false;
+		for (u8 i = 0; i < touched_len && !deferred; ++i) {
+			deferred = (touched[i] == key);
+		}
+		if (!deferred) {
+			const int index = _kbd_apply(key, state, min_index, used, (touched_len == 0));
+			if (index == -2) {
+				break; // No free slots on the next keyboards, wait for the next batch
+			}
+			taken[n] = true;
+			if (index >= 0 && state) {
+				min_index = index + 1;
+			}
+		} else if (state) {
+			break; // The next presses can't overtake this one
+		}
+		touched[touched_len++] = key;
+
+		// Skip the keyboards which are not used by the host
+		while (min_index < PH_USB_KBD_IFACES && !(used & (1 << min_index))) {
+			++min_index;
+		}
+		if (min_index >= PH_USB_KBD_IFACES) {
+			break;
+		}
+	}
+
+	// Remove the taken events, the deferred ones keep their order
+	const u8 len = _kbd_queue_len;
+	_kbd_queue_len = 0;
+	for (u8 n = 0; n < len; ++n) {
+		const u8 pos = (_kbd_queue_head + n) % _KBD_QUEUE_SIZE;
+		if (!taken[n]) {
+			_kbd_queue[(_kbd_queue_head + _kbd_queue_len) % _KBD_QUEUE_SIZE] = _kbd_queue[pos];
+			++_kbd_queue_len;
+		}
+	}
+}
+
+static int _kbd_apply(u8 key, bool state, u8 min_index, u8 used, bool evict) {
+	// Returns the index of the changed keyboard, -1 if nothing has been changed
+	// or -2 if there is no free slot for the press.
+
+	if (_IS_KBD_MOD(key)) {
+		const u8 prev = _kbd_mods;
+		key = 1 << (key & 0x07); // Номер означает сдвиг
+		if (state) {
+			_kbd_mods |= key;
+		} else {
+			_kbd_mods &= ~key;
+		}
+		if (_kbd_mods == prev) {
+			return -1;
+		}
+		_kbd_dirty[0] = true;
+		return 0;
+	}
+
+	if (PH_O_IS_KBD_USB_NKRO) {
+		if (key >= PH_USB_KBD_NKRO_KEYS) {
+			return -1;
+		}
+		const u8 bit = 1 << (key & 0x07);
+		if (!!(_kbd_bitmap[key >> 3] & bit) == state) {
+			return -1;
+		}
+		if (state) {
+			if (min_index > 0) {
+				return -2; // There is only one keyboard and it already has a press in the batch
+			}
+			_kbd_bitmap[key >> 3] |= bit;
+		} else {
+			_kbd_bitmap[key >> 3] &= ~bit;
+		}
+		_kbd_dirty[0] = true;
+		return 0;
+	}
+
+	for (u8 index = 0; index < PH_USB_KBD_IFACES; ++index) {
+		for (u8 i = 0; i < 6; ++i) {
+			if (_kbd_keys[index][i] == key) {
+				if (state) {
+					return -1; // Already pressed
+				}
+				_kbd_keys[index][i] = 0; // Released on the same keyboard where it was pressed
+				_kbd_dirty[index] = true;
+				return index;
+			}
+		}
+	}
+	if (!state) {
+		return -1;
+	}
+
+	for (u8 index = min_index; index < PH_USB_KBD_IFACES; ++index) {
+		if (used & (1 << index)) {
+			for (u8 i = 0; i < 6; ++i) {
+				if (_kbd_keys[index][i] == 0) {
+					_kbd_keys[index][i] = key;
+					_kbd_dirty[index] = true;
+					return index;
+				}
+			}
+		}
+	}
+	if (evict) {
+		_kbd_keys[0][0] = key; // Rollover, replace the first key
+		_kbd_dirty[0] = true;
+		return 0;
+	}
+	return -2;
+}
+
+#undef _IS_KBD_MOD
+
+
 //--------------------------------------------------------------------
 // RAW report senders
 //--------------------------------------------------------------------
 
-static void _kbd_sync_report(bool new) {
-	static bool sent = true;
+static void _kbd_sync_report(bool force) {
 	if (_kbd_iface < 0 || !PH_O_IS_KBD_USB) {
-		_KBD_CLEAR;
-		sent = true;
+		_KBD_RESET;
 		return;
 	}
-	if (new) {
-		sent = false;
+	if (force) {
+		for (u8 index = 0; index < PH_USB_KBD_IFACES; ++index) {
+			_kbd_dirty[index] = (_kbd_used & (1 << index));
+		}
 	}
-	if (!sent) {
-		if (tud_suspended()) {
-			tud_remote_wakeup();
-			//_KBD_CLEAR;
-			//sent = true;
-		} else {
-			sent = tud_hid_n_keyboard_report(_kbd_iface, 0, _kbd_mods, _kbd_keys);
+
+	const u64 now_ts = time_us_64();
+	bool dirty = false;
+	for (u8 index = 0; index < PH_USB_KBD_IFACES; ++index) {
+		if (_kbd_sent_ts[index] > 0) {
+			if (now_ts < _kbd_sent_ts[index] + _REPORT_TIMEOUT_US) {
+				return; // Ждем, пока хост заберет весь предыдущий батч
+			}
+			_kbd_sent_ts[index] = 0;
+			if (index == 0) {
+				_kbd_stuck = true;
+				_update_online();
+			} else {
+				// Хост перестал опрашивать дополнительную клавиатуру, больше ее не используем
+				if (_kbd_dirty[index]) {
+					PH_STATS_INC(REPORT_FAILS);
+				}
+				_kbd_used &= ~(1 << index);
+				memset(_kbd_keys[index], 0, 6);
+				_kbd_dirty[index] = false;
+			}
 		}
+		dirty = (dirty || _kbd_dirty[index]);
+	}
+	if (!dirty && _kbd_queue_len == 0) {
+		return;
+	}
+
+	if (tud_suspended()) {
+		tud_remote_wakeup();
+		return;
+	}
+
+	if (!dirty) {
+		_kbd_fill_batch();
+	}
+	for (u8 index = 0; index < PH_USB_KBD_IFACES; ++index) {
+		if (_kbd_dirty[index]) {
+			bool sent;
+			if (PH_O_IS_KBD_USB_NKRO) {
+				sent = _kbd_nkro_send_report();
+			} else {
+				const u8 mods = (index == 0 ? _kbd_mods : 0);
+				sent = tud_hid_n_keyboard_report(_kbd_iface + index, 0, mods, _kbd_keys[index]);
+			}
+			if (sent) {
+				ph_trace_submitted();
+				_kbd_dirty[index] = false;
+				_kbd_sent_ts[index] = now_ts;
+			}
+			// Неотправленный останется dirty и уйдет со следующей попыткой, это не потеря
+		}
+	}
+}
+
+static bool _kbd_nkro_send_report(void) {
+	if (tud_hid_n_get_protocol(_kbd_iface) == HID_PROTOCOL_BOOT) {
+		// BIOS can't parse our descriptor, so it gets the regular 6KRO report
+		u8 keys[6] = {0};
+		u8 count = 0;
+		for (u8 key = 0; key < PH_USB_KBD_NKRO_KEYS; ++key) {
+			if (_kbd_bitmap[key >> 3] & (1 << (key & 0x07))) {
+				if (count < 6) {
+					keys[count] = key;
+				}
+				++count;
+			}
+		}
+		if (count > 6) {
+			memset(keys, 0x01, 6); // ErrorRollOver, too many keys for boot protocol
+		}
+		return tud_hid_n_keyboard_report(_kbd_iface, 0, _kbd_mods, keys);
+	}
+
+	struct TU_ATTR_PACKED {
+		u8 mods;
+		u8 reserved;
+		u8 bitmap[sizeof(_kbd_bitmap)];
+	} report = {_kbd_mods, 0, {0}};
+	memcpy(report.bitmap, _kbd_bitmap, sizeof(_kbd_bitmap));
+	return tud_hid_n_report(_kbd_iface, 0, &report, sizeof(report));
+}
+
+static void _mouse_interp_step(u64 now_ts) {
+	const u64 elapsed_us = now_ts - _mouse_interp.start_ts;
+	s16 x = _mouse_interp.to_x;
+	s16 y = _mouse_interp.to_y;
+	if (elapsed_us >= _mouse_interp.duration_us) {
+		_mouse_interp.active = false;
+	} else {
+#		define STEP(x_axis) (_mouse_interp.from_##x_axis + (s16)( \
+				(s64)(_mouse_interp.to_##x_axis - _mouse_interp.from_##x_axis) \
+				* (s64)elapsed_us / (s64)_mouse_interp.duration_us \
+			))
+		x = STEP(x);
+		y = STEP(y);
+#		undef STEP
+	}
+	if (x != _mouse_abs_x || y != _mouse_abs_y) {
+		_mouse_abs_x = x;
+		_mouse_abs_y = y;
+		_mouse_abs_send_report(0, 0);
+	}
+}
+
+static void _mouse_interp_flush(void) {
+	if (_mouse_interp.active) {
+		_mouse_abs_x = _mouse_interp.to_x;
+		_mouse_abs_y = _mouse_interp.to_y;
+		_mouse_interp.active = false;
 	}
 }
 
@@ -233,6 +704,7 @@ static void _kbd_sync_report(bool new) {
 
 static void _mouse_abs_send_report(s8 h, s8 v) {
 	(void)h; // Horizontal scrolling is not supported due BIOS/UEFI compatibility reasons
+	_mouse_abs_pending = false; // Any report carries the current buttons
 	_CHECK_MOUSE(ABS);
 	u16 x = ((s32)_mouse_abs_x + 32768) / 2;
 	u16 y = ((s32)_mouse_abs_y + 32768) / 2;
@@ -246,7 +718,12 @@ static void _mouse_abs_send_report(s8 h, s8 v) {
 		u16 y;
 		s8 v;
 	} report = {_mouse_buttons, x, y, v};
-	tud_hid_n_report(_mouse_iface, 0, &report, sizeof(report));
+	if (tud_hid_n_report(_mouse_iface, 0, &report, sizeof(report))) {
+		ph_trace_submitted();
+		_mouse_sent_ts = time_us_64();
+	} else {
+		PH_STATS_INC(REPORT_FAILS);
+	}
 }
 
 static void _mouse_rel_send_report(s8 x, s8 y, s8 h, s8 v) {
@@ -258,7 +735,12 @@ static void _mouse_rel_send_report(s8 x, s8 y, s8 h, s8 v) {
 		s8 y;
 		s8 v;
 	} report = {_mouse_buttons, x, y, v};
-	tud_hid_n_report(_mouse_iface, 0, &report, sizeof(report));
+	if (tud_hid_n_report(_mouse_iface, 0, &report, sizeof(report))) {
+		ph_trace_submitted();
+		_mouse_sent_ts = time_us_64();
+	} else {
+		PH_STATS_INC(REPORT_FAILS);
+	}
 }
 
 #undef _CHECK_MOUSE
@@ -282,11 +764,67 @@ void tud_hid_set_report_cb(u8 iface, u8 report_id, hid_report_type_t report_type
 	// Invoked when received SET_REPORT control request
 	// or received data on OUT endpoint (ReportID=0, Type=0)
 	(void)report_id;
-	if (iface == _kbd_iface && report_type == HID_REPORT_TYPE_OUTPUT && len >= 1) {
-		ph_g_usb_kbd_leds = buf[0];
+	if (
+		_is_kbd_iface(iface)
+		&& report_type == HID_REPORT_TYPE_OUTPUT && len >= 1
+	) {
+		ph_g_usb_kbd_leds = buf[0]; // The host sends LEDs to all keyboards
+	}
+}
+
+void tud_hid_report_complete_cb(u8 iface, const u8 *report, u16 len) {
+	(void)report;
+	(void)len;
+	if ((int)iface == _mouse_iface) {
+		_mouse_sent_ts = 0;
+		if (_mouse_stuck) {
+			_mouse_stuck = false;
+			_update_online();
+		}
+	} else if (_is_kbd_iface(iface)) {
+		_kbd_sent_ts[iface - _kbd_iface] = 0;
+		if (iface == _kbd_iface && _kbd_stuck) {
+			_kbd_stuck = false;
+			_kbd_force = true; // Если был переход из долгого оффлайна в онлайн
+			_update_online();
+		}
 	}
 }
 
+void tud_mount_cb(void) {
+	// The extra keyboards will be marked as used when the host driver asks their report descriptors.
+	// BIOS doesn't do it, so it gets everything on the first one.
+	_kbd_used = 0b1;
+	for (u8 index = 1; index < PH_USB_KBD_IFACES; ++index) {
+		memset(_kbd_keys[index], 0, 6);
+	}
+	memset(_kbd_sent_ts, 0, sizeof(_kbd_sent_ts));
+	_mouse_sent_ts = 0;
+	_kbd_stuck = false;
+	_mouse_stuck = false;
+	_kbd_force = true;
+	_bus_online = true;
+	_update_online();
+}
+
+void tud_umount_cb(void) {
+	_bus_online = false;
+	_update_online();
+}
+
+void tud_suspend_cb(bool remote_wakeup_en) {
+	// Within 7 ms the device must draw an average of current less than 2.5 mA from bus
+	(void)remote_wakeup_en;
+	_bus_online = false;
+	_update_online();
+}
+
+void tud_resume_cb(void) {
+	_bus_online = tud_mounted();
+	_kbd_force = true;
+	_update_online();
+}
+
 const u8 *tud_hid_descriptor_report_cb(u8 iface) {
 	if ((int)iface == _mouse_iface) {
 		if (PH_O_IS_MOUSE_USB_ABS) {
@@ -295,6 +833,12 @@ const u8 *tud_hid_descriptor_report_cb(u8 iface) {
 			return PH_USB_MOUSE_REL_DESC;
 		}
 	}
+	if (_is_kbd_iface(iface)) {
+		_kbd_used |= 1 << (iface - _kbd_iface);
+	}
+	if (PH_O_IS_KBD_USB_NKRO) {
+		return PH_USB_KBD_NKRO_DESC;
+	}
 	return PH_USB_KBD_DESC; // _kbd_iface, PH_O_IS_KBD_USB
 }
 
@@ -323,10 +867,9 @@ const u8 *_bridge_tud_descriptor_configuration_cb(void) {
 }
 
 const u8 *_hid_tud_descriptor_configuration_cb(void) {
-	static u8 desc[TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN * 2] = {0};
-	static bool filled = false;
+	static u8 desc[TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN * CFG_TUD_HID] = {0};
 
-	if (!filled) {
+	if (!_desc_filled) {
 		uz offset = TUD_CONFIG_DESC_LEN;
 		u8 iface = 0;
 		u8 ep = 0x81;
@@ -340,8 +883,19 @@ const u8 *_hid_tud_descriptor_configuration_cb(void) {
 				offset += TUD_HID_DESC_LEN; ++iface; ++ep; \
 			}
 
-		if (PH_O_IS_KBD_USB) {
+		if (PH_O_IS_KBD_USB_NKRO) {
+			// Report protocol is NKRO, boot protocol falls back to 6KRO in _kbd_nkro_send_report()
+			APPEND_DESC(HID_ITF_PROTOCOL_KEYBOARD, PH_USB_KBD_NKRO_DESC, _kbd_iface);
+			_kbd_ifaces = 1;
+		} else if (PH_O_IS_KBD_USB) {
 			APPEND_DESC(HID_ITF_PROTOCOL_KEYBOARD, PH_USB_KBD_DESC, _kbd_iface);
+			for (u8 index = 1; index < PH_USB_KBD_IFACES; ++index) {
+				int extra_iface; // Always follows the first one
+				// The extra keyboards are not boot devices, BIOS should ignore them
+				APPEND_DESC(HID_ITF_PROTOCOL_NONE, PH_USB_KBD_DESC, extra_iface);
+				(void)extra_iface;
+			}
+			_kbd_ifaces = PH_USB_KBD_IFACES;
 		}
 		if (PH_O_IS_MOUSE_USB_ABS) {
 			APPEND_DESC(HID_ITF_PROTOCOL_NONE, PH_USB_MOUSE_ABS_DESC, _mouse_iface);
@@ -354,7 +908,7 @@ const u8 *_hid_tud_descriptor_configuration_cb(void) {
   		// Config number, interface count, string index, total length, attribute, power in mA
 		const u8 part[] = {TUD_CONFIG_DESCRIPTOR(1, iface, 0, offset, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100)};
 		memcpy(desc, part, TUD_CONFIG_DESC_LEN);
-		filled = true;
+		_desc_filled = true;
 	}
 	return desc;
 }
@@ -31,13 +31,18 @@ extern bool ph_g_usb_mouse_online;
 
 
 void ph_usb_init(void);
+void ph_usb_reconfigure(void);
 void ph_usb_task(void);
 
 void ph_usb_kbd_send_key(u8 key, bool state);
+void ph_usb_kbd_send_report(u8 mods, const u8 *keys);
 
 void ph_usb_mouse_send_button(u8 button, bool state);
 void ph_usb_mouse_send_abs(s16 x, s16 y);
+void ph_usb_mouse_set_interpolation(u8 lookahead_ms);
 void ph_usb_mouse_send_rel(s8 x, s8 y);
 void ph_usb_mouse_send_wheel(s8 h, s8 v);
+void ph_usb_mouse_send_report(u8 buttons, s8 x, s8 y, s8 v);
+void ph_usb_mouse_send_abs_report(u8 buttons, s16 x, s16 y, s8 v);
 
 void ph_usb_send_clear(void);
@@ -76,3 +76,56 @@ const u8 PH_USB_KBD_DESC[] = {
 };
 
 const uz PH_USB_KBD_DESC_LEN = sizeof(PH_USB_KBD_DESC);
+
+
+const u8 PH_USB_KBD_NKRO_DESC[] = {
+	// The same as above, but the keys array is replaced by the bitmap.
+	// The report is: modifiers, reserved byte, PH_USB_KBD_NKRO_KEYS bits.
+
+	// Keyboard
+	0x05, 0x01,	// USAGE_PAGE (Generic Desktop)
+	0x09, 0x06,	// USAGE (Keyboard)
+	0xA1, 0x01,	// COLLECTION (Application)
+
+	// Modifiers
+	0x05, 0x07,	// USAGE_PAGE (Keyboard)
+	0x19, 0xE0,	// USAGE_MINIMUM (Keyboard LeftControl)
+	0x29, 0xE7,	// USAGE_MAXIMUM (Keyboard Right GUI)
+	0x15, 0x00,	// LOGICAL_MINIMUM (0)
+	0x25, 0x01,	// LOGICAL_MAXIMUM (1)
+	0x75, 0x01,	// REPORT_SIZE (1)
+	0x95, 0x08,	// REPORT_COUNT (8)
+	0x81, 0x02,	// INPUT (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
+
+	// Reserved byte
+	0x95, 0x01,	// REPORT_COUNT (1)
+	0x75, 0x08,	// REPORT_SIZE (8)
+	0x81, 0x01,	// INPUT (Const,Array,Abs,No Wrap,Linear,Preferred State,No Null Position)
+
+	// LEDs output
+	0x95, 0x05,	// REPORT_COUNT (5)
+	0x75, 0x01,	// REPORT_SIZE (1)
+	0x05, 0x08,	// USAGE_PAGE (LEDs)
+	0x19, 0x01,	// USAGE_MINIMUM (Num Lock)
+	0x29, 0x05,	// USAGE_MAXIMUM (Kana)
+	0x91, 0x02,	// OUTPUT (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+
+	// Reserved 3 bits in output
+	0x95, 0x01,	// REPORT_COUNT (1)
+	0x75, 0x03,	// REPORT_SIZE (3)
+	0x91, 0x01,	// OUTPUT (Const,Array,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+
+	// Keys bitmap
+	0x05, 0x07,	// USAGE_PAGE (Keyboard)
+	0x19, 0x00,	// USAGE_MINIMUM (Reserved)
+	0x29, PH_USB_KBD_NKRO_KEYS - 1,	// USAGE_MAXIMUM (0x9F)
+	0x15, 0x00,	// LOGICAL_MINIMUM (0)
+	0x25, 0x01,	// LOGICAL_MAXIMUM (1)
+	0x75, 0x01,	// REPORT_SIZE (1)
+	0x95, PH_USB_KBD_NKRO_KEYS,	// REPORT_COUNT (160)
+	0x81, 0x02,	// INPUT (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
+
+	0xC0,		// END_COLLECTION
+};
+
+const uz PH_USB_KBD_NKRO_DESC_LEN = sizeof(PH_USB_KBD_NKRO_DESC);
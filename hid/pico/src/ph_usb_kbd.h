@@ -25,5 +25,11 @@
 #include "ph_types.h"
 
 
+#define PH_USB_KBD_NKRO_KEYS 0xA0 // Bitmap for usages 0x00...0x9F, modifiers are separate
+
+
 extern const u8 PH_USB_KBD_DESC[];
 extern const uz PH_USB_KBD_DESC_LEN;
+
+extern const u8 PH_USB_KBD_NKRO_DESC[];
+extern const uz PH_USB_KBD_NKRO_DESC_LEN;
@@ -59,12 +59,21 @@
 #	define CFG_TUD_ENDPOINT0_SIZE 64
 #endif
 
-// HID: Keyboard + Mouse
-#define CFG_TUD_HID 2
+// Number of keyboard interfaces. Key events are striped across them,
+// so each extra interface adds one more key report per USB frame.
+#ifndef PH_USB_KBD_IFACES
+#	define PH_USB_KBD_IFACES 1
+#endif
+#if PH_USB_KBD_IFACES < 1 || PH_USB_KBD_IFACES > 4
+#	error "PH_USB_KBD_IFACES should be in range 1...4"
+#endif
+
+// HID: Keyboard(s) + Mouse
+#define CFG_TUD_HID (PH_USB_KBD_IFACES + 1)
 
 // HID buffer size Should be sufficient to hold ID (if any) + Data
 #ifndef CFG_TUD_HID_EP_BUFSIZE
-#	define CFG_TUD_HID_EP_BUFSIZE 16
+#	define CFG_TUD_HID_EP_BUFSIZE 32 // NKRO report is 22 bytes
 #endif
 
 
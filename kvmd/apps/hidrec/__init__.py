@@ -0,0 +1,125 @@
+# ========================================================================== #
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+# ========================================================================== #
+
+
+import json
+import argparse
+
+from ...plugins.hid import get_hid_class
+from ...plugins.hid._mcu import BaseMcuHid
+from ...plugins.hid._mcu.proto import STATS_NAMES
+from ...plugins.hid._mcu.proto import RECORD_TYPES
+from ...plugins.hid._mcu.proto import RECORD_ENDPOINTS
+
+from ...keyboard.mappings import KEYMAP
+from ...keyboard.mappings import WEB_TO_EVDEV
+
+from .. import init
+
+
+# =====
+_CMDS = {
+    0x03: "set_keyboard",
+    0x04: "set_mouse",
+    0x05: "set_connected",
+    0x06: "set_mouse_interpolation",
+    0x10: "clear",
+    0x11: "key",
+    0x12: "mouse_move",
+    0x13: "mouse_button",
+    0x14: "mouse_wheel",
+    0x15: "mouse_relative",
+}
+
+_RESPS = {
+    0x24: "none",
+    0x40: "crc_error",
+    0x45: "invalid_error",
+    0x48: "timeout_error",
+}
+
+_KEYS = {
+    KEYMAP[evdev].mcu.code: web
+    for (web, evdev) in WEB_TO_EVDEV.items()
+    if evdev in KEYMAP
+}
+
+
+def _decode_record(now_ts: int, ts: int, data: int) -> dict:
+    (rtype, a, b, c) = ((data >> 24) & 0xFF, (data >> 16) & 0xFF, (data >> 8) & 0xFF, data & 0xFF)
+    ago = (((now_ts - ts) & 0xFFFFFFFF) / 1000000)  # The timer wraps in ~71 minutes
+    name = RECORD_TYPES.get(rtype, f"0x{rtype:02X}")
+    info: str
+    match name:
+        case "boot":
+            info = ("by watchdog" if a else "")
+        case "cmd":
+            if a == 0x11:
+                info = f"key {_KEYS.get(b, f'0x{b:02X}')} {'press' if c else 'release'}"
+            else:
+                info = f"{_CMDS.get(a, f'0x{a:02X}')} 0x{b:02X} 0x{c:02X}"
+        case "resp":
+            if a & 0x80:
+                info = f"pong 0x{a:02X} outputs 0x{b:02X} 0x{c:02X}"
+            else:
+                info = _RESPS.get(a, f"0x{a:02X}")
+        case "online":
+            ep = (RECORD_ENDPOINTS[a] if a < len(RECORD_ENDPOINTS) else f"0x{a:02X}")
+            info = f"{ep} {'online' if b else 'offline'}"
+        case "stat":
+            info = (STATS_NAMES[a] if a < len(STATS_NAMES) else f"0x{a:02X}")
+        case _:
+            info = f"0x{a:02X} 0x{b:02X} 0x{c:02X}"
+    return {"ago": ago, "type": name, "info": info, "raw": f"{data:08X}"}
+
+
+# =====
+def main() -> None:
+    ia = init(
+        add_help=False,
+        cli_logging=True,
+        load_hid=True,
+    )
+    parser = argparse.ArgumentParser(
+        prog="kvmd-hidrec",
+        description="Dump the flight recorder of the HID MCU; stop kvmd first, it owns the HID port",
+        parents=[ia.parser],
+    )
+    parser.add_argument("-j", "--json", action="store_true", help="Print JSON instead of the text")
+    options = parser.parse_args(ia.args)
+
+    config = ia.config.kvmd.hid
+    hid_cls = get_hid_class(config.type)
+    if not issubclass(hid_cls, BaseMcuHid):
+        raise SystemExit(f"HID type {config.type!r} has no MCU flight recorder")
+    hid = hid_cls(**config._unpack(ignore=["type", "keymap"]))
+
+    result = hid.read_recorder()
+    if result is None:
+        raise SystemExit("HID firmware doesn't support the flight recorder")
+    (now_ts, records) = result
+
+    decoded = [_decode_record(now_ts, ts, data) for (ts, data) in records]
+    if options.json:
+        print(json.dumps(decoded, indent=4))
+    else:
+        for record in decoded:
+            print(f"-{record['ago']:.6f}s  {record['type']:<7} {record['raw']}  {record['info']}")
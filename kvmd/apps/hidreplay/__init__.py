@@ -0,0 +1,242 @@
+# ========================================================================== #
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+# ========================================================================== #
+
+
+import asyncio
+import collections
+import contextlib
+import json
+import time
+import argparse
+
+from ...logging import get_logger
+
+from ...plugins.hid import BaseHid
+from ...plugins.hid import get_hid_class
+from ...plugins.hid._capture import EVENT_KEY
+from ...plugins.hid._capture import EVENT_MOUSE_BUTTON
+from ...plugins.hid._capture import EVENT_MOUSE_MOVE
+from ...plugins.hid._capture import EVENT_MOUSE_RELATIVE
+from ...plugins.hid._capture import EVENT_MOUSE_WHEEL
+from ...plugins.hid._capture import EVENT_CLEAR
+from ...plugins.hid._capture import EVENT_NAMES
+from ...plugins.hid._capture import CaptureError
+from ...plugins.hid._capture import read_capture
+
+from ...validators.basic import valid_float_f0
+from ...validators.basic import valid_float_f01
+
+from ... import aiotools
+
+from .. import init
+
+
+# =====
+_Events = list[tuple[int, int, tuple[int, ...]]]
+
+
+def _read_events(path: str) -> _Events:
+    try:
+        with open(path, "rb") as file:
+            return list(read_capture(file))
+    except (OSError, CaptureError) as ex:
+        raise SystemExit(f"Can't read HID capture {path!r}: {ex}")
+
+
+def _make_info(events: _Events) -> dict:
+    counts = collections.Counter(EVENT_NAMES[event] for (_, event, _) in events)
+    duration = (events[-1][0] / 1000000 if events else 0.0)
+    return {
+        "events": len(events),
+        "duration": duration,
+        "rate": (len(events) / duration if duration > 0 else 0.0),
+        "counts": dict(counts),
+    }
+
+
+def _percentiles(values: list[float]) -> dict[str, float]:
+    ordered = sorted(values)
+    return {
+        f"p{pct}": (ordered[min(len(ordered) * pct // 100, len(ordered) - 1)] if ordered else 0.0)
+        for pct in (50, 90, 99)
+    }
+
+
+# =====
+def _send_event(hid: BaseHid, event: int, args: tuple[int, ...]) -> None:
+    # Через публичные методы, как это делает kvmd: с ignore_keys, remap'ом и jiggler'ом
+    if event == EVENT_KEY:
+        hid.send_key_event(args[0], bool(args[1] & 0x01), bool(args[1] & 0x02))
+    elif event == EVENT_MOUSE_BUTTON:
+        hid.send_mouse_button_event(args[0], bool(args[1]))
+    elif event == EVENT_MOUSE_MOVE:
+        hid.send_mouse_move_event(*args)
+    elif event == EVENT_MOUSE_RELATIVE:
+        hid.send_mouse_relative_event(*args)
+    elif event == EVENT_MOUSE_WHEEL:
+        hid.send_mouse_wheel_event(*args)
+    elif event == EVENT_CLEAR:
+        hid.clear_events()
+
+
+async def _wait_online(hid: BaseHid, timeout: float) -> dict:
+    deadline = time.monotonic() + timeout
+    while True:
+        state = await hid.get_state()
+        if state.get("online"):
+            return state
+        if time.monotonic() > deadline:
+            raise SystemExit(f"HID is still offline after {timeout}s, check the device and the config")
+        await asyncio.sleep(0.1)
+
+
+async def _refresh_diagnostics(hid: BaseHid, timeout: float) -> dict:
+    # Статистика MCU и перцентили трейса обновляются отдельным опросом раз в 10 секунд,
+    # поэтому перед снимком состояния опрос запускается принудительно
+    if not (await hid.refresh_diagnostics(timeout)):
+        get_logger(0).error("HID stats are not refreshed in %gs, they may be stale", timeout)
+    return (await hid.get_state())
+
+
+async def _replay(hid: BaseHid, events: _Events, speed: float, wait: float, settle: float) -> dict:
+    hid.sysprep()
+    systask = asyncio.create_task(hid.systask())
+    try:
+        await _wait_online(hid, wait)
+        before = await _refresh_diagnostics(hid, wait)
+
+        lateness: list[float] = []
+        begin_ts = time.monotonic()
+        for (count, (offset_us, event, args)) in enumerate(events):
+            if speed > 0:
+                due_ts = begin_ts + offset_us / 1000000 / speed
+                delay = due_ts - time.monotonic()
+                if delay > 0:
+                    await asyncio.sleep(delay)
+                lateness.append(max(time.monotonic() - due_ts, 0.0))
+            elif count % 64 == 0:
+                await asyncio.sleep(0)  # Let get_state() and the plugin tasks breathe
+            _send_event(hid, event, args)
+        elapsed = time.monotonic() - begin_ts
+
+        # Очередь плагина разгребается после отправки последнего события
+        await asyncio.sleep(settle)
+        after = await _refresh_diagnostics(hid, wait)
+    finally:
+        systask.cancel()
+        with contextlib.suppress(asyncio.CancelledError):
+            await systask
+        await hid.cleanup()
+
+    stats: dict[str, int] = {}
+    if isinstance(after.get("stats"), dict):
+        stats = {
+            name: (value - before.get("stats", {}).get(name, 0)) & 0xFFFFFFFF  # The MCU counters are u32 and wrap
+            for (name, value) in after["stats"].items()
+            if name != "loop_max_us"  # Not a counter
+        }
+
+    requested = (events[-1][0] / 1000000 / speed if speed > 0 and events else 0.0)
+    return {
+        "events": len(events),
+        "speed": speed,
+        "elapsed": elapsed,
+        "requested_rate": (len(events) / requested if requested > 0 else 0.0),
+        "achieved_rate": (len(events) / elapsed if elapsed > 0 else 0.0),
+        "lateness": {
+            **_percentiles(lateness),
+            "max": max(lateness, default=0.0),
+        },
+        "trace": after.get("trace"),  # Queueing delay from the MCU plugin, if enabled
+        "stats": stats,
+        "online": bool(after.get("online")),
+    }
+
+
+def _print_report(report: dict) -> None:
+    print(f"Events:       {report['events']} in {report['elapsed']:.3f}s, speed x{report['speed']:g}")
+    if report["requested_rate"]:
+        print(f"Rate:         {report['achieved_rate']:.1f}/s achieved, {report['requested_rate']:.1f}/s in the capture")
+    else:
+        print(f"Rate:         {report['achieved_rate']:.1f}/s achieved, unthrottled")
+    lateness = report["lateness"]
+    print("Lateness:     " + ", ".join(f"{key} {value * 1000:.3f}ms" for (key, value) in lateness.items()))
+    trace = report["trace"]
+    if trace:
+        for (stage, pcts) in trace.items():
+            if isinstance(pcts, dict):
+                print(f"Trace {stage + ':':<7} " + ", ".join(f"{key} {value / 1000:.3f}ms" for (key, value) in pcts.items()))
+        print(f"Trace lost:   {trace['lost']}")
+    if report["stats"]:
+        print("MCU stats:    " + ", ".join(f"{name} +{value}" for (name, value) in report["stats"].items()))
+    if not report["online"]:
+        print("HID went offline during the replay")
+
+
+# =====
+def main() -> None:
+    ia = init(
+        add_help=False,
+        cli_logging=True,
+        load_hid=True,
+    )
+    parser = argparse.ArgumentParser(
+        prog="kvmd-hidreplay",
+        description="Replay a HID capture made with hid/capture/path through the configured HID;"
+            " stop kvmd first, it owns the HID. To drive the firmware simulator,"
+            " set kvmd/hid/device to the hid_pty link in the --override-config",
+        parents=[ia.parser],
+    )
+    parser.add_argument("capture", help="Path to the capture file")
+    parser.add_argument("-i", "--info", action="store_true", help="Print the capture summary and exit")
+    parser.add_argument("-s", "--speed", default=1.0, type=valid_float_f0,
+                        help="Playback speed multiplier, 0 means as fast as possible")
+    parser.add_argument("--wait", default=10.0, type=valid_float_f01,
+                        help="Timeout for the HID to become online and for the stats refresh")
+    parser.add_argument("--settle", default=1.0, type=valid_float_f0,
+                        help="Time to wait after the last event before the stats refresh")
+    parser.add_argument("-j", "--json", action="store_true", help="Print JSON instead of the text")
+    options = parser.parse_args(ia.args)
+
+    events = _read_events(options.capture)
+
+    if options.info:
+        info = _make_info(events)
+        if options.json:
+            print(json.dumps(info, indent=4))
+        else:
+            print(f"Events:   {info['events']} in {info['duration']:.3f}s, {info['rate']:.1f}/s")
+            for (name, count) in sorted(info["counts"].items()):
+                print(f"  {name:<16} {count}")
+        return
+
+    config = ia.config.kvmd.hid
+    kwargs = config._unpack(ignore=["type", "keymap"])
+    kwargs["capture"] = {"capture_path": ""}  # Don't record the replay into the same file
+    if "trace" in kwargs:
+        kwargs["trace"] = True  # MCU queueing delay percentiles
+    hid = get_hid_class(config.type)(**kwargs)
+
+    report = aiotools.run_sync(_replay(hid, events, options.speed, options.wait, options.settle))
+    if options.json:
+        print(json.dumps(report, indent=4))
+    else:
+        _print_report(report)
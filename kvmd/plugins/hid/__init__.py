@@ -35,6 +35,7 @@ from ...yamlconf import Option
 from ...validators.basic import valid_bool
 from ...validators.basic import valid_int_f1
 from ...validators.basic import valid_string_list
+from ...validators.os import valid_abs_path
 from ...validators.hid import valid_hid_key
 from ...validators.hid import valid_hid_mouse_move
 
@@ -45,6 +46,14 @@ from ...mouse import MouseRange
 from .. import BasePlugin
 from .. import get_plugin_class
 
+from ._capture import EVENT_KEY
+from ._capture import EVENT_MOUSE_BUTTON
+from ._capture import EVENT_MOUSE_MOVE
+from ._capture import EVENT_MOUSE_RELATIVE
+from ._capture import EVENT_MOUSE_WHEEL
+from ._capture import EVENT_CLEAR
+from ._capture import CaptureWriter
+
 
 # =====
 class BaseHid(BasePlugin):  # pylint: disable=too-many-instance-attributes
@@ -60,6 +69,8 @@ class BaseHid(BasePlugin):  # pylint: disable=too-many-instance-attributes
         jiggler_enabled: bool,
         jiggler_active: bool,
         jiggler_interval: int,
+
+        capture_path: str,
     ) -> None:
 
         self.__ignore_keys = [WEB_TO_EVDEV[key] for key in ignore_keys]
@@ -75,6 +86,9 @@ class BaseHid(BasePlugin):  # pylint: disable=too-many-instance-attributes
         self.__j_last_x = 0
         self.__j_last_y = 0
 
+        # Входные события как есть, для kvmd-hidreplay
+        self.__capture: (CaptureWriter | None) = (CaptureWriter(capture_path) if capture_path else None)
+
     @classmethod
     def _get_base_options(cls) -> dict[str, Any]:
         return {
@@ -92,6 +106,9 @@ class BaseHid(BasePlugin):  # pylint: disable=too-many-instance-attributes
                 "active":   Option(False, type=valid_bool, unpack_as="jiggler_active"),
                 "interval": Option(60,    type=valid_int_f1, unpack_as="jiggler_interval"),
             },
+            "capture": {
+                "path": Option("", type=valid_abs_path, if_empty="", unpack_as="capture_path"),
+            },
         }
 
     # =====
@@ -125,8 +142,15 @@ class BaseHid(BasePlugin):  # pylint: disable=too-many-instance-attributes
     async def reset(self) -> None:
         raise NotImplementedError
 
+    async def refresh_diagnostics(self, timeout: float) -> bool:
+        # Makes the stats and trace of get_state() up to date, if the plugin has them
+        _ = timeout
+        return True
+
     async def cleanup(self) -> None:
-        pass
+        # Plugins should call it at the end of their own cleanup()
+        if self.__capture:
+            self.__capture.close()
 
     def set_params(
         self,
@@ -161,6 +185,8 @@ class BaseHid(BasePlugin):  # pylint: disable=too-many-instance-attributes
                 self.send_key_event(key, state, False)
 
     def send_key_event(self, key: int, state: bool, finish: bool) -> None:
+        if self.__capture:
+            self.__capture.write(EVENT_KEY, key, (int(state) | (int(finish) << 1)))
         self._send_key_event(key, state)
         if state and finish and (key not in EvdevModifiers.ALL and key != ecodes.KEY_SYSRQ):
             # Считаем что PrintScreen это модификатор для Alt+SysRq+...
@@ -174,6 +200,8 @@ class BaseHid(BasePlugin):  # pylint: disable=too-many-instance-attributes
     # =====
 
     def send_mouse_button_event(self, button: int, state: bool) -> None:
+        if self.__capture:
+            self.__capture.write(EVENT_MOUSE_BUTTON, button, int(state))
         self._send_mouse_button_event(button, state)
         self.__bump_activity()
 
@@ -183,6 +211,11 @@ class BaseHid(BasePlugin):  # pylint: disable=too-many-instance-attributes
     # =====
 
     def send_mouse_move_event(self, to_x: int, to_y: int) -> None:
+        if self.__capture:
+            self.__capture.write(EVENT_MOUSE_MOVE, to_x, to_y)
+        self.__send_mouse_move_event(to_x, to_y)
+
+    def __send_mouse_move_event(self, to_x: int, to_y: int) -> None:
         self.__j_last_x = to_x
         self.__j_last_y = to_y
         if self.__mouse_x_range != MouseRange.RANGE:
@@ -202,6 +235,11 @@ class BaseHid(BasePlugin):  # pylint: disable=too-many-instance-attributes
         self.__process_mouse_delta_event(deltas, squash, self.send_mouse_relative_event)
 
     def send_mouse_relative_event(self, delta_x: int, delta_y: int) -> None:
+        if self.__capture:
+            self.__capture.write(EVENT_MOUSE_RELATIVE, delta_x, delta_y)
+        self.__send_mouse_relative_event(delta_x, delta_y)
+
+    def __send_mouse_relative_event(self, delta_x: int, delta_y: int) -> None:
         self._send_mouse_relative_event(delta_x, delta_y)
         self.__bump_activity()
 
@@ -215,6 +253,8 @@ class BaseHid(BasePlugin):  # pylint: disable=too-many-instance-attributes
         self.__process_mouse_delta_event(deltas, squash, self.send_mouse_wheel_event)
 
     def send_mouse_wheel_event(self, delta_x: int, delta_y: int) -> None:
+        if self.__capture:
+            self.__capture.write(EVENT_MOUSE_WHEEL, delta_x, delta_y)
         self._send_mouse_wheel_event(delta_x, delta_y)
         self.__bump_activity()
 
@@ -224,6 +264,8 @@ class BaseHid(BasePlugin):  # pylint: disable=too-many-instance-attributes
     # =====
 
     def clear_events(self) -> None:
+        if self.__capture:
+            self.__capture.write(EVENT_CLEAR)
         self._clear_events()  # Don't bump activity here
 
     def _clear_events(self) -> None:
@@ -279,15 +321,18 @@ class BaseHid(BasePlugin):  # pylint: disable=too-many-instance-attributes
     async def systask(self) -> None:
         while True:
             if self.__j_active and (self.__j_activity_ts + self.__j_interval < self.__get_monotonic_seconds()):
+                # Мимо записи: это не ввод оператора
                 if self.__j_absolute:
                     (x, y) = (self.__j_last_x, self.__j_last_y)
                     for move in (([100, -100] * 5) + [0]):
-                        self.send_mouse_move_event(MouseRange.normalize(x + move), MouseRange.normalize(y + move))
+                        self.__send_mouse_move_event(MouseRange.normalize(x + move), MouseRange.normalize(y + move))
                         await asyncio.sleep(0.1)
                 else:
                     for move in ([10, -10] * 5):
-                        self.send_mouse_relative_event(move, move)
+                        self.__send_mouse_relative_event(move, move)
                         await asyncio.sleep(0.1)
+            if self.__capture:
+                self.__capture.flush()
             await asyncio.sleep(1)
 
 
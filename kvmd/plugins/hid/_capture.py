@@ -0,0 +1,202 @@
+# ========================================================================== #
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+# ========================================================================== #
+
+
+import os
+import struct
+import time
+
+from typing import BinaryIO
+from typing import Generator
+
+from ...logging import get_logger
+
+from ... import tools
+
+
+# =====
+# Компактная запись входных событий BaseHid для реплея одинаковой нагрузки.
+#
+# Заголовок: magic "KVMDHIDC", u8 версия, 3 байта резерва, u64 unix-время начала в микросекундах.
+# Запись: varint (LEB128) микросекунд от предыдущего события, u8 тип и аргументы
+# фиксированного размера, little-endian:
+#   KEY             u16 evdev-код, u8 флаги (0x01 - нажатие, 0x02 - finish)
+#   MOUSE_BUTTON    u16 evdev-код, u8 нажатие
+#   MOUSE_MOVE      s16 x, s16 y (до mouse_x_range/mouse_y_range)
+#   MOUSE_RELATIVE  s8 dx, s8 dy
+#   MOUSE_WHEEL     s8 dx, s8 dy
+#   CLEAR           -
+# Типичное движение мыши занимает 6-7 байт.
+
+CAPTURE_MAGIC = b"KVMDHIDC"
+CAPTURE_VERSION = 1
+
+EVENT_KEY = 1
+EVENT_MOUSE_BUTTON = 2
+EVENT_MOUSE_MOVE = 3
+EVENT_MOUSE_RELATIVE = 4
+EVENT_MOUSE_WHEEL = 5
+EVENT_CLEAR = 6
+
+EVENT_NAMES = {
+    EVENT_KEY:            "key",
+    EVENT_MOUSE_BUTTON:   "mouse_button",
+    EVENT_MOUSE_MOVE:     "mouse_move",
+    EVENT_MOUSE_RELATIVE: "mouse_relative",
+    EVENT_MOUSE_WHEEL:    "mouse_wheel",
+    EVENT_CLEAR:          "clear",
+}
+
+_HEADER = struct.Struct("<8sB3xQ")
+_ARGS = {
+    EVENT_KEY:            struct.Struct("<HB"),
+    EVENT_MOUSE_BUTTON:   struct.Struct("<HB"),
+    EVENT_MOUSE_MOVE:     struct.Struct("<hh"),
+    EVENT_MOUSE_RELATIVE: struct.Struct("<bb"),
+    EVENT_MOUSE_WHEEL:    struct.Struct("<bb"),
+    EVENT_CLEAR:          struct.Struct("<"),
+}
+
+
+class CaptureError(Exception):
+    pass
+
+
+class CaptureWriter:
+    def __init__(self, path: str, flush_interval: float=1.0) -> None:
+        self.__path = path
+        self.__flush_interval = flush_interval
+
+        self.__pid = os.getpid()
+        self.__file: (BinaryIO | None) = None
+        self.__failed = False
+        self.__prev_us = 0
+        self.__flush_ts = 0.0
+        self.__unflushed = False
+
+    def write(self, event: int, *args: int) -> None:
+        if not self.__is_usable():
+            return
+        try:
+            now_us = time.monotonic_ns() // 1000
+            if self.__file is None:
+                # Лениво, чтобы форки не унаследовали буфер
+                self.__rotate()
+                self.__file = open(self.__path, "wb")  # pylint: disable=consider-using-with
+                self.__file.write(_HEADER.pack(CAPTURE_MAGIC, CAPTURE_VERSION, time.time_ns() // 1000))
+                self.__prev_us = now_us
+            self.__file.write(_pack_varint(now_us - self.__prev_us) + bytes([event]) + _ARGS[event].pack(*args))
+            self.__prev_us = now_us
+            self.__unflushed = True
+            if self.__flush_ts + self.__flush_interval < time.monotonic():
+                self.__flush()
+        except Exception as ex:
+            self.__fail(ex)
+
+    def flush(self) -> None:
+        # По таймеру из systask(), чтобы хвост записи не застревал в буфере, когда ввод затих
+        if self.__is_usable() and self.__file is not None and self.__unflushed:
+            try:
+                self.__flush()
+            except Exception as ex:
+                self.__fail(ex)
+
+    def close(self) -> None:
+        if self.__is_usable() and self.__file is not None:
+            try:
+                self.__file.close()  # With flush
+            except Exception as ex:
+                self.__fail(ex)
+        self.__file = None
+
+    def __is_usable(self) -> bool:
+        # Дочерние процессы плагинов тоже зовут clear_events() на ошибках,
+        # а их копия писателя открыла бы тот же файл заново поверх основного
+        return (not self.__failed and os.getpid() == self.__pid)
+
+    def __rotate(self) -> None:
+        # Запись прошлого запуска не затираем, а оставляем одну предыдущую: capture.1.kvmdhidc
+        if os.path.exists(self.__path):
+            (root, ext) = os.path.splitext(self.__path)
+            os.replace(self.__path, f"{root}.1{ext}")
+
+    def __flush(self) -> None:
+        assert self.__file is not None
+        self.__file.flush()
+        self.__flush_ts = time.monotonic()
+        self.__unflushed = False
+
+    def __fail(self, ex: Exception) -> None:
+        get_logger().error("Can't write HID capture %r, it's disabled: %s", self.__path, tools.efmt(ex))
+        self.__failed = True
+
+
+def read_capture(file: BinaryIO) -> Generator[tuple[int, int, tuple[int, ...]], None, None]:
+    # Yields (offset_us, event, args), the offset is from the first event
+    header = file.read(_HEADER.size)
+    if len(header) < _HEADER.size:
+        raise CaptureError("Too short for a HID capture")
+    (magic, version, _) = _HEADER.unpack(header)
+    if magic != CAPTURE_MAGIC:
+        raise CaptureError("Not a HID capture")
+    if version != CAPTURE_VERSION:
+        raise CaptureError(f"Unsupported HID capture version: {version}")
+
+    offset_us = 0
+    while True:
+        delta_us = _read_varint(file)
+        if delta_us is None:
+            return
+        offset_us += delta_us
+        raw = file.read(1)
+        if not raw or raw[0] not in _ARGS:
+            raise CaptureError(f"Broken HID capture at offset {offset_us}us")
+        event = raw[0]
+        args_st = _ARGS[event]
+        data = file.read(args_st.size)
+        if len(data) < args_st.size:
+            return  # Cut by the crash or kill
+        yield (offset_us, event, args_st.unpack(data))
+
+
+def _pack_varint(value: int) -> bytes:
+    result = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            result.append(byte | 0x80)
+        else:
+            result.append(byte)
+            return bytes(result)
+
+
+def _read_varint(file: BinaryIO) -> (int | None):
+    value = 0
+    shift = 0
+    while True:
+        raw = file.read(1)
+        if not raw:
+            return None
+        value |= (raw[0] & 0x7F) << shift
+        if not (raw[0] & 0x80):
+            return value
+        shift += 7
@@ -22,6 +22,7 @@
 
 import multiprocessing
 import contextlib
+import asyncio
 import queue
 import copy
 import time
@@ -45,19 +46,31 @@ from ....validators.basic import valid_int_f1
 from ....validators.basic import valid_float_f01
 from ....validators.os import valid_abs_path
 from ....validators.hw import valid_gpio_pin_optional
+from ....validators.hid import valid_hid_mouse_interpolation
 
 from .. import BaseHid
 
 from .gpio import Gpio
+from .trace import TRACE_STAGES
+from .trace import TRACE_PERCENTILES
+from .trace import Tracer
 
 from .proto import REQUEST_PING
 from .proto import REQUEST_REPEAT
 from .proto import RESPONSE_LEGACY_OK
+from .proto import STATS_NAMES
+from .proto import PROFILE_PROBES
+from .proto import PROFILE_BUCKETS
 
 from .proto import BaseEvent
 from .proto import SetKeyboardOutputEvent
 from .proto import SetMouseOutputEvent
 from .proto import SetConnectedEvent
+from .proto import SetMouseInterpolationEvent
+from .proto import GetStatsEvent
+from .proto import GetProfileEvent
+from .proto import GetTraceEvent
+from .proto import GetRecordEvent
 from .proto import ClearEvent
 from .proto import KeyEvent
 from .proto import MouseButtonEvent
@@ -67,6 +80,7 @@ from .proto import MouseWheelEvent
 
 from .proto import get_active_keyboard
 from .proto import get_active_mouse
+from .proto import get_stats_value
 from .proto import check_response
 
 
@@ -89,6 +103,15 @@ class _TempRequestError(_RequestError):
     pass
 
 
+_TRACED_EVENTS = (
+    KeyEvent,
+    MouseButtonEvent,
+    MouseMoveEvent,
+    MouseRelativeEvent,
+    MouseWheelEvent,
+)
+
+
 # =====
 class BasePhyConnection:
     def send(self, req: bytes) -> bytes:
@@ -113,17 +136,21 @@ class BaseMcuHid(BaseHid, multiprocessing.Process):  # pylint: disable=too-many-
         mouse_x_range: dict[str, Any],
         mouse_y_range: dict[str, Any],
         jiggler: dict[str, Any],
+        capture: dict[str, Any],
 
         reset_self: bool,
+        mouse_interpolation: int,
         read_retries: int,
         common_retries: int,
         retries_delay: float,
         errors_threshold: int,
         noop: bool,
+        trace: bool,
+        trace_path: str,
         **gpio_kwargs: Any,
     ) -> None:
 
-        BaseHid.__init__(self, ignore_keys=ignore_keys, **mouse_x_range, **mouse_y_range, **jiggler)
+        BaseHid.__init__(self, ignore_keys=ignore_keys, **mouse_x_range, **mouse_y_range, **jiggler, **capture)
         multiprocessing.Process.__init__(self, daemon=True)
 
         self.__read_retries = read_retries
@@ -136,9 +163,42 @@ class BaseMcuHid(BaseHid, multiprocessing.Process):  # pylint: disable=too-many-
         gpio_device_path = gpio_kwargs.pop("gpio_device_path")
         self.__gpio = Gpio(device_path=gpio_device_path, **gpio_kwargs)
         self.__reset_self = reset_self
+        self.__mouse_interpolation = mouse_interpolation
+
+        self.__kbd_inhibited = False
+        self.__stats_supported = True
+        self.__profile_supported = True
+        self.__profile_probe = 0
+
+        # Счетчики не дергают poll_state(), они просто попадают в следующий стейт
+        self.__stats = aiomulti.AioSharedFlags({
+            name: 0
+            for name in STATS_NAMES
+        }, aiomulti.AioProcessNotifier(), type=int)
+
+        # Гистограммы из прошивки с HID_PROFILE/PH_PROFILE: по одной пробе за опрос,
+        # в каждой то, что накопилось с ее предыдущего чтения
+        self.__profile = aiomulti.AioSharedFlags({
+            f"{name}:{bucket}": 0
+            for name in PROFILE_PROBES
+            for bucket in range(PROFILE_BUCKETS)
+        }, aiomulti.AioProcessNotifier(), type=int)
+
+        # Трейс: после каждого входного события спрашиваем у MCU его метки времени
+        self.__tracer: (Tracer | None) = (Tracer(trace_path) if trace else None)
+        self.__trace_flags = aiomulti.AioSharedFlags({
+            "lost": 0,
+            **{
+                f"{stage}_p{pct}": 0
+                for stage in TRACE_STAGES
+                for pct in TRACE_PERCENTILES
+            },
+        }, aiomulti.AioProcessNotifier(), type=int)
 
         self.__reset_required_event = multiprocessing.Event()
-        self.__events_queue: "multiprocessing.Queue[BaseEvent]" = multiprocessing.Queue()
+        self.__diag_required_event = multiprocessing.Event()
+        self.__diag_sweeps = multiprocessing.Value("L", 0)
+        self.__events_queue: "multiprocessing.Queue[tuple[float, BaseEvent]]" = multiprocessing.Queue()
 
         self.__notifier = aiomulti.AioProcessNotifier()
         self.__state_flags = aiomulti.AioSharedFlags({
@@ -162,12 +222,17 @@ class BaseMcuHid(BaseHid, multiprocessing.Process):  # pylint: disable=too-many-
             # </gpio_kwargs>
             "reset_self":             Option(False, type=valid_bool),
 
+            "mouse_interpolation": Option(0, type=valid_hid_mouse_interpolation),
+
             "read_retries":     Option(5,     type=valid_int_f1),
             "common_retries":   Option(5,     type=valid_int_f1),
             "retries_delay":    Option(0.5,   type=valid_float_f01),
             "errors_threshold": Option(5,     type=valid_int_f0),
             "noop":             Option(False, type=valid_bool),
 
+            "trace":      Option(False, type=valid_bool),
+            "trace_path": Option("",    type=valid_abs_path, if_empty=""),
+
             **cls._get_base_options(),
         }
 
@@ -199,6 +264,9 @@ class BaseMcuHid(BaseHid, multiprocessing.Process):  # pylint: disable=too-many-
             if outputs2 & 0b00000100:  # USB WIN98
                 mouse_outputs["available"].append("usb_win98")
 
+            if outputs2 & 0b00001000:  # USB NKRO
+                keyboard_outputs["available"].append("usb_nkro")
+
             if outputs2 & 0b00000010:  # PS/2
                 keyboard_outputs["available"].append("ps2")
                 mouse_outputs["available"].append("ps2")
@@ -235,6 +303,9 @@ class BaseMcuHid(BaseHid, multiprocessing.Process):  # pylint: disable=too-many-
                 "absolute": absolute,
                 "outputs": mouse_outputs,
             },
+            "stats": await self.__stats.get(),
+            "profile": self.__make_profile_state(await self.__profile.get()),
+            "trace": (self.__make_trace_state(await self.__trace_flags.get()) if self.__tracer else None),
             **self._get_jiggler_state(),
         }
 
@@ -254,13 +325,32 @@ class BaseMcuHid(BaseHid, multiprocessing.Process):  # pylint: disable=too-many-
     async def reset(self) -> None:
         self.__reset_required_event.set()
 
+    async def refresh_diagnostics(self, timeout: float) -> bool:
+        # Опрос начинается заново, а ждем его конца после того, как HID-процесс
+        # забрал запрос, чтобы не принять за свежий опрос, закончившийся до этого
+        deadline = time.monotonic() + timeout
+        self.__diag_required_event.set()
+        while self.__diag_required_event.is_set():
+            if time.monotonic() > deadline:
+                return False
+            await asyncio.sleep(0.05)
+        sweeps = self.__diag_sweeps.value
+        while self.__diag_sweeps.value == sweeps:
+            if time.monotonic() > deadline:
+                return False
+            await asyncio.sleep(0.05)
+        return True
+
     @aiotools.atomic_fg
     async def cleanup(self) -> None:
-        if self.is_alive():
-            get_logger(0).info("Stopping HID daemon ...")
-            self.__stop_event.set()
-        if self.is_alive() or self.exitcode is not None:
-            self.join()
+        try:
+            if self.is_alive():
+                get_logger(0).info("Stopping HID daemon ...")
+                self.__stop_event.set()
+            if self.is_alive() or self.exitcode is not None:
+                self.join()
+        finally:
+            await super().cleanup()
 
     # =====
 
@@ -310,7 +400,7 @@ class BaseMcuHid(BaseHid, multiprocessing.Process):  # pylint: disable=too-many-
                 # очисткой и добавлением нового события. Неприятно, но не смертельно.
                 # Починить блокировкой после перехода на асинхронные очереди.
                 tools.clear_queue(self.__events_queue)
-            self.__events_queue.put_nowait(event)
+            self.__events_queue.put_nowait((time.monotonic(), event))
 
     def run(self) -> None:  # pylint: disable=too-many-branches
         logger = aioproc.settle("HID", "hid")
@@ -336,21 +426,47 @@ class BaseMcuHid(BaseHid, multiprocessing.Process):  # pylint: disable=too-many-
                 if not self.__hid_loop_wait_device(reset):
                     continue
                 reset = True
+                self.__stats_supported = True
+                self.__profile_supported = True
+                stats_ts = 0.0
+                diag_step = 0
                 with self.__phy.connected() as conn:
+                    if self.__mouse_interpolation > 0:
+                        # Не сохраняется в MCU, поэтому шлем после каждого резета
+                        event = SetMouseInterpolationEvent(self.__mouse_interpolation)
+                        self.__process_request(conn, event.make_request())
                     while not (self.__stop_event.is_set() and self.__events_queue.qsize() == 0):
                         if self.__reset_required_event.is_set():
                             self.__set_state_busy(True)
                             self.__reset_required_event.clear()
                             break  # Проваливаемся и резетим в __hid_loop_wait_device()
                         try:
-                            event = self.__events_queue.get(timeout=0.1)
+                            (enqueue_ts, event) = self.__events_queue.get(timeout=0.1)
                         except queue.Empty:
-                            self.__process_request(conn, REQUEST_PING)
+                            # Опрос диагностики идет по одному запросу за тик простоя вместо пинга,
+                            # так что входное событие никогда не ждет за пачкой запросов
+                            req = REQUEST_PING
+                            if self.__diag_required_event.is_set():
+                                self.__diag_required_event.clear()
+                                (stats_ts, diag_step) = (0.0, 0)
+                            if time.monotonic() >= stats_ts:
+                                (diag_step, diag_req) = self.__next_diag_request(diag_step)
+                                if diag_req is None:
+                                    self.__finish_diag()
+                                    stats_ts = time.monotonic() + 10
+                                else:
+                                    req = diag_req
+                            self.__process_request(conn, req)
                         else:
                             if isinstance(event, (SetKeyboardOutputEvent, SetMouseOutputEvent)):
                                 self.__set_state_busy(True)
+                            tracer = (self.__tracer if isinstance(event, _TRACED_EVENTS) else None)
+                            if tracer:
+                                tracer.begin(type(event).__name__, enqueue_ts)
                             if not self.__process_request(conn, event.make_request()):
                                 self.clear_events()
+                            if tracer:
+                                self.__finish_trace(conn)
             except _SelfResetError:
                 time.sleep(1)  # Pico перезагружается сам вскоре после ответа
                 reset = False
@@ -359,6 +475,35 @@ class BaseMcuHid(BaseHid, multiprocessing.Process):  # pylint: disable=too-many-
                 get_logger(0).exception("Unexpected error in the HID loop")
                 time.sleep(1)
 
+    def read_recorder(self) -> (tuple[int, list[tuple[int, int]]] | None):
+        # Для kvmd-hidrec при остановленном kvmd: сам HID-процесс держит соединение
+        # и резетит MCU на старте, а после резета кольцо уже пустое.
+        with self.__phy.connected() as conn:
+            now_ts = self.__read_record(conn, 0, 2)
+            header = self.__read_record(conn, 0, 3)
+            if now_ts is None or header is None:
+                return None
+            (next_seq, count) = (header >> 16, header & 0xFFFF)
+            records: list[tuple[int, int]] = []
+            for seq in range(next_seq - count, next_seq):
+                ts = self.__read_record(conn, seq & 0xFFFF, 0)
+                data = self.__read_record(conn, seq & 0xFFFF, 1)
+                if ts is not None and data is not None:  # Otherwise it was overwritten while reading
+                    records.append((ts, data))
+            return (now_ts, records)
+
+    def __read_record(self, conn: BasePhyConnection, seq: int, half: int) -> (int | None):
+        req = GetRecordEvent(seq, half).make_request()
+        for _ in range(self.__common_retries):
+            resp = conn.send(req)
+            if len(resp) == 8 and check_response(resp):
+                if resp[1] == 0x2A:
+                    return get_stats_value(resp)
+                if resp[1] == 0x45:  # Not supported or not available anymore
+                    return None
+            time.sleep(self.__retries_delay)
+        raise RuntimeError(f"Can't read the HID flight recorder: request={req!r}")
+
     def __hid_loop_wait_device(self, reset: bool) -> bool:
         logger = get_logger(0)
         if reset:
@@ -377,8 +522,57 @@ class BaseMcuHid(BaseHid, multiprocessing.Process):  # pylint: disable=too-many-
         self.__set_state_online(False)
         return False
 
-    def __process_request(self, conn: BasePhyConnection, req: bytes) -> bool:  # pylint: disable=too-many-branches
+    def __next_diag_request(self, step: int) -> tuple[int, (bytes | None)]:
+        # Returns the next step and the request, or None if the sweep is over:
+        # the stats counters first, then the buckets of the current profiler probe
+        if step < len(STATS_NAMES) and self.__stats_supported:
+            return (step + 1, GetStatsEvent(step).make_request())
+        bucket = max(step - len(STATS_NAMES), 0)
+        if bucket < PROFILE_BUCKETS and self.__profile_supported:
+            return (len(STATS_NAMES) + bucket + 1, GetProfileEvent(self.__profile_probe, bucket).make_request())
+        return (0, None)
+
+    def __finish_diag(self) -> None:
+        self.__profile_probe = (self.__profile_probe + 1) % len(PROFILE_PROBES)
+        self.__flush_trace()
+        with self.__diag_sweeps.get_lock():
+            self.__diag_sweeps.value += 1
+
+    def __finish_trace(self, conn: BasePhyConnection) -> None:
+        # USB отчет может уйти только на следующем проходе main loop'а MCU
+        for _ in range(3):
+            if not (self.__tracer and self.__tracer.is_pending()):
+                break
+            self.__process_request(conn, GetTraceEvent().make_request())
+        if self.__tracer:
+            self.__tracer.finish()
+
+    def __flush_trace(self) -> None:
+        if self.__tracer:
+            self.__trace_flags.update(**self.__tracer.get_percentiles())
+            self.__tracer.dump()
+
+    def __make_trace_state(self, flags: dict[str, int]) -> dict:
+        return {
+            "lost": flags["lost"],
+            **{
+                stage: {f"p{pct}": flags[f"{stage}_p{pct}"] for pct in TRACE_PERCENTILES}
+                for stage in TRACE_STAGES
+            },
+        }
+
+    def __make_profile_state(self, flags: dict[str, int]) -> dict[str, list[int]]:
+        return {
+            name: [flags[f"{name}:{bucket}"] for bucket in range(PROFILE_BUCKETS)]
+            for name in PROFILE_PROBES
+        }
+
+    def __process_request(self, conn: BasePhyConnection, req: bytes) -> bool:  # pylint: disable=too-many-branches,too-many-statements
         logger = get_logger()
+        stats_index = (req[2] if req[1] == 0x07 else -1)
+        profile_key = (f"{PROFILE_PROBES[req[2]]}:{req[3]}" if req[1] == 0x08 else "")
+        trace_req = (req[1] == 0x09)
+        interp_req = (req[1] == 0x06)
         error_messages: list[str] = []
         live_log_errors = False
 
@@ -387,6 +581,7 @@ class BaseMcuHid(BaseHid, multiprocessing.Process):  # pylint: disable=too-many-
         error_retval = False
 
         while self.__gpio.is_powered() and common_retries and read_retries:
+            send_ts = time.monotonic()
             resp = (RESPONSE_LEGACY_OK if self.__noop else conn.send(req))
             try:
                 if len(resp) < 4:
@@ -403,14 +598,41 @@ class BaseMcuHid(BaseHid, multiprocessing.Process):  # pylint: disable=too-many-
                 elif code == 0x40:  # CRC Error
                     raise _TempRequestError(f"Got CRC error of request from HID: request={req!r}")
                 elif code == 0x45:  # Unknown command
+                    if stats_index >= 0:
+                        logger.info("HID firmware doesn't support the statistics")
+                        self.__stats_supported = False
+                        return True
+                    if profile_key:
+                        logger.info("HID firmware doesn't support the profiler")
+                        self.__profile_supported = False
+                        return True
+                    if trace_req:
+                        logger.info("HID firmware doesn't support the tracing")
+                        self.__tracer = None
+                        return True
+                    if interp_req:
+                        logger.info("HID firmware doesn't support the mouse interpolation")
+                        return True
                     raise _PermRequestError(f"HID did not recognize the request={req!r}")
                 elif code == 0x24:  # Rebooted?
                     raise _PermRequestError("No previous command state inside HID, seems it was rebooted")
                 elif code == 0x20:  # Legacy done
                     self.__set_state_online(True)
                     return True
+                elif code == 0x28 and stats_index >= 0:  # Stats
+                    self.__stats.update(**{STATS_NAMES[stats_index]: get_stats_value(resp)})  # Unsigned, wraps
+                    return True
+                elif code == 0x28 and profile_key:
+                    self.__profile.update(**{profile_key: get_stats_value(resp)})
+                    return True
+                elif code == 0x29 and trace_req:  # Trace stamps
+                    if self.__tracer:
+                        self.__tracer.feed_mcu(get_stats_value(resp))
+                    return True
                 elif code & 0x80:  # Pong/Done with state
                     self.__set_state_pong(resp)
+                    if self.__tracer:
+                        self.__tracer.feed_link(send_ts, time.monotonic())
                     return True
                 raise _TempRequestError(f"Invalid response from HID: request={req!r}, response=0x{resp!r}")
 
@@ -452,10 +674,22 @@ class BaseMcuHid(BaseHid, multiprocessing.Process):  # pylint: disable=too-many-
     def __set_state_busy(self, busy: bool) -> None:
         self.__state_flags.update(busy=int(busy))
 
+    def __check_kbd_inhibit(self, queued: int, inhibit: int) -> None:
+        # PS/2 клавиатура Arduino: хост держит clock, нажатия копятся в очереди
+        inhibited = (inhibit == 0xFF)
+        if inhibited != self.__kbd_inhibited:
+            if inhibited:
+                get_logger(0).error("The target holds the PS/2 keyboard clock line for too long; queued=%d", queued)
+            else:
+                get_logger(0).info("The target released the PS/2 keyboard clock line")
+            self.__kbd_inhibited = inhibited
+
     def __set_state_pong(self, resp: bytes) -> None:
         status = resp[1] << 16
         if len(resp) > 4:
             status |= (resp[2] << 8) | resp[3]
+        if len(resp) > 6:
+            self.__check_kbd_inhibit(resp[4], resp[5])
         reset_required = (1 if resp[1] & 0b01000000 else 0)
         self.__state_flags.update(online=1, busy=reset_required, status=status)
         if reset_required:
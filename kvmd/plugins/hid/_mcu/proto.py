@@ -45,6 +45,7 @@ _KEYBOARD_NAMES_TO_CODES = {
     "disabled": 0b00000000,
     "usb":      0b00000001,
     "ps2":      0b00000011,
+    "usb_nkro": 0b00000101,
 }
 _KEYBOARD_CODES_TO_NAMES = tools.swapped_kvs(_KEYBOARD_NAMES_TO_CODES)
 
@@ -100,6 +101,106 @@ class SetConnectedEvent(BaseEvent):
         return _make_request(struct.pack(">BBxxx", 0x05, int(self.connected)))
 
 
+@dataclasses.dataclass(frozen=True)
+class SetMouseInterpolationEvent(BaseEvent):
+    lookahead: int  # Milliseconds, 0 is the exact passthrough
+
+    def __post_init__(self) -> None:
+        assert 0 <= self.lookahead <= 255
+
+    def make_request(self) -> bytes:
+        return _make_request(struct.pack(">BBxxx", 0x06, self.lookahead))
+
+
+# =====
+STATS_NAMES = (
+    "rx_frames",
+    "crc_errors",
+    "invalid_commands",
+    "rx_timeouts",
+    "report_failures",
+    "ps2_inhibits",
+    "reset_requests",
+    "loop_max_us",  # Since the previous read
+)
+
+
+@dataclasses.dataclass(frozen=True)
+class GetStatsEvent(BaseEvent):
+    index: int
+
+    def __post_init__(self) -> None:
+        assert 0 <= self.index < len(STATS_NAMES)
+
+    def make_request(self) -> bytes:
+        return _make_request(struct.pack(">BBxxx", 0x07, self.index))
+
+
+PROFILE_PROBES = (
+    "loop",
+    "usb",
+    "ps2",
+    "storage",
+    "transport",
+)
+
+PROFILE_BUCKETS = 16  # Log2 of microseconds: [0, 1), [1, 2), [2, 4) ... [16384, inf)
+
+
+@dataclasses.dataclass(frozen=True)
+class GetProfileEvent(BaseEvent):
+    probe: int
+    bucket: int
+
+    def __post_init__(self) -> None:
+        assert 0 <= self.probe < len(PROFILE_PROBES)
+        assert 0 <= self.bucket < PROFILE_BUCKETS
+
+    def make_request(self) -> bytes:
+        return _make_request(struct.pack(">BBBxx", 0x08, self.probe, self.bucket))
+
+
+class GetTraceEvent(BaseEvent):
+    def make_request(self) -> bytes:
+        return _make_request(b"\x09\x00\x00\x00\x00")
+
+
+# =====
+RECORD_TYPES = {
+    0x01: "boot",
+    0x02: "cmd",
+    0x03: "resp",
+    0x04: "online",
+    0x05: "stat",
+    0x06: "ch9329",
+}
+
+RECORD_ENDPOINTS = (
+    "usb_keyboard",
+    "usb_mouse",
+    "ps2_keyboard",
+    "ps2_mouse",
+)
+
+
+@dataclasses.dataclass(frozen=True)
+class GetRecordEvent(BaseEvent):
+    seq: int
+    half: int  # 0 - timestamp, 1 - type and data, 2 - current timestamp, 3 - next seq and count
+
+    def __post_init__(self) -> None:
+        assert 0 <= self.seq <= 0xFFFF
+        assert 0 <= self.half <= 3
+
+    def make_request(self) -> bytes:
+        return _make_request(struct.pack(">BHBx", 0x0A, self.seq, self.half))
+
+
+def get_stats_value(resp: bytes) -> int:
+    assert len(resp) == 8 and resp[1] in [0x28, 0x29, 0x2A], resp
+    return struct.unpack(">I", resp[2:6])[0]
+
+
 # =====
 class ClearEvent(BaseEvent):
     def make_request(self) -> bytes:
@@ -0,0 +1,151 @@
+# ========================================================================== #
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+# ========================================================================== #
+
+
+import os
+import json
+import collections
+import dataclasses
+
+from ....logging import get_logger
+
+from .... import tools
+
+
+# =====
+TRACE_STAGES = (
+    "queue",   # From the API to the HID process
+    "link",    # Round trip of the request minus the MCU handling
+    "apply",   # From the frame receive to the command applied by the MCU
+    "report",  # From the command applied to the report sent by the MCU
+    "total",   # From the API to the report, the link is counted one way
+)
+
+TRACE_PERCENTILES = (50, 90, 99)
+
+
+@dataclasses.dataclass
+class _Request:
+    req_id: int
+    name: str
+    enqueue_ts: float
+    send_ts: float = 0.0
+    recv_ts: float = 0.0
+    apply_us: int = -1
+    report_us: int = -1
+
+
+class Tracer:
+    def __init__(self, path: str, window: int=1000, max_events: int=10000) -> None:
+        self.__path = path
+
+        self.__samples: dict[str, collections.deque[float]] = {
+            stage: collections.deque(maxlen=window)
+            for stage in TRACE_STAGES
+        }
+        self.__lost = 0
+
+        self.__events: collections.deque[dict] = collections.deque(maxlen=max_events)
+        self.__events_dirty = False
+
+        self.__req_id = 0
+        self.__req: (_Request | None) = None
+
+    def begin(self, name: str, enqueue_ts: float) -> None:
+        self.__req_id = (self.__req_id + 1) & 0xFFFFFFFF
+        self.__req = _Request(self.__req_id, name, enqueue_ts)
+
+    def is_pending(self) -> bool:
+        return (self.__req is not None and self.__req.report_us < 0)
+
+    def feed_link(self, send_ts: float, recv_ts: float) -> None:
+        if self.__req is not None and self.__req.recv_ts == 0:
+            self.__req.send_ts = send_ts
+            self.__req.recv_ts = recv_ts
+
+    def feed_mcu(self, value: int) -> None:
+        if self.__req is not None:
+            self.__req.apply_us = value >> 16
+            report_us = value & 0xFFFF
+            if report_us != 0xFFFF:  # Otherwise there was no report yet
+                self.__req.report_us = report_us
+
+    def finish(self) -> None:
+        req = self.__req
+        self.__req = None
+        if req is None:
+            return
+        if req.recv_ts == 0 or req.apply_us < 0 or req.report_us < 0:
+            self.__lost += 1
+            return
+
+        queue = req.send_ts - req.enqueue_ts
+        link = max(req.recv_ts - req.send_ts - req.apply_us / 1000000, 0.0)
+        apply = req.apply_us / 1000000
+        report = max(req.report_us - req.apply_us, 0) / 1000000
+        total = queue + link / 2 + req.report_us / 1000000
+        for (stage, value) in zip(TRACE_STAGES, [queue, link, apply, report, total]):
+            self.__samples[stage].append(value)
+
+        if self.__path:
+            mcu_ts = req.send_ts + link / 2  # Best guess, the clocks are not synced
+            args = {"id": req.req_id, "event": req.name}
+            self.__events.extend([
+                self.__make_event("queue", "host", req.enqueue_ts, queue, args),
+                self.__make_event(req.name, "host", req.send_ts, req.recv_ts - req.send_ts, args),
+                self.__make_event("apply", "mcu", mcu_ts, apply, args),
+                self.__make_event("report", "mcu", mcu_ts + apply, report, args),
+            ])
+            self.__events_dirty = True
+
+    def get_percentiles(self) -> dict[str, int]:
+        # Microseconds, like on the MCU side
+        result: dict[str, int] = {"lost": self.__lost}
+        for (stage, samples) in self.__samples.items():
+            ordered = sorted(samples)
+            for pct in TRACE_PERCENTILES:
+                value = (ordered[min(len(ordered) * pct // 100, len(ordered) - 1)] if ordered else 0.0)
+                result[f"{stage}_p{pct}"] = int(value * 1000000)
+        return result
+
+    def dump(self) -> None:
+        if not self.__path or not self.__events_dirty:
+            return
+        self.__events_dirty = False
+        try:
+            tmp_path = f"{self.__path}.tmp"
+            with open(tmp_path, "w") as file:
+                json.dump({"traceEvents": list(self.__events), "displayTimeUnit": "ms"}, file)
+            os.replace(tmp_path, self.__path)
+        except Exception as ex:
+            get_logger().error("Can't write HID trace %r: %s", self.__path, tools.efmt(ex))
+
+    def __make_event(self, name: str, tid: str, ts: float, dur: float, args: dict) -> dict:
+        # https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+        return {
+            "name": name,
+            "ph": "X",
+            "pid": "kvmd-hid",
+            "tid": tid,
+            "ts": int(ts * 1000000),
+            "dur": max(int(dur * 1000000), 1),
+            "args": args,
+        }
@@ -67,6 +67,7 @@ class Plugin(BaseHid):  # pylint: disable=too-many-instance-attributes
         mouse_x_range: dict[str, Any],
         mouse_y_range: dict[str, Any],
         jiggler: dict[str, Any],
+        capture: dict[str, Any],
 
         manufacturer: str,
         product: str,
@@ -85,7 +86,7 @@ class Plugin(BaseHid):  # pylint: disable=too-many-instance-attributes
         select_timeout: float,
     ) -> None:
 
-        super().__init__(ignore_keys=ignore_keys, **mouse_x_range, **mouse_y_range, **jiggler)
+        super().__init__(ignore_keys=ignore_keys, **mouse_x_range, **mouse_y_range, **jiggler, **capture)
         self._set_jiggler_absolute(False)
 
         self.__proc: (multiprocessing.Process | None) = None
@@ -181,12 +182,15 @@ class Plugin(BaseHid):  # pylint: disable=too-many-instance-attributes
 
     @aiotools.atomic_fg
     async def cleanup(self) -> None:
-        if self.__proc is not None:
-            if self.__proc.is_alive():
-                get_logger(0).info("Stopping HID daemon ...")
-                self.__stop_event.set()
-            if self.__proc.is_alive() or self.__proc.exitcode is not None:
-                self.__proc.join()
+        try:
+            if self.__proc is not None:
+                if self.__proc.is_alive():
+                    get_logger(0).info("Stopping HID daemon ...")
+                    self.__stop_event.set()
+                if self.__proc.is_alive() or self.__proc.exitcode is not None:
+                    self.__proc.join()
+        finally:
+            await super().cleanup()
 
     # =====
 
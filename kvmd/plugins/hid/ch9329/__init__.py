@@ -58,13 +58,14 @@ class Plugin(BaseHid, multiprocessing.Process):  # pylint: disable=too-many-inst
         mouse_x_range: dict[str, Any],
         mouse_y_range: dict[str, Any],
         jiggler: dict[str, Any],
+        capture: dict[str, Any],
 
         device_path: str,
         speed: int,
         read_timeout: float,
     ) -> None:
 
-        BaseHid.__init__(self, ignore_keys=ignore_keys, **mouse_x_range, **mouse_y_range, **jiggler)
+        BaseHid.__init__(self, ignore_keys=ignore_keys, **mouse_x_range, **mouse_y_range, **jiggler, **capture)
         multiprocessing.Process.__init__(self, daemon=True)
 
         self.__device_path = device_path
@@ -142,11 +143,14 @@ class Plugin(BaseHid, multiprocessing.Process):  # pylint: disable=too-many-inst
 
     @aiotools.atomic_fg
     async def cleanup(self) -> None:
-        if self.is_alive():
-            get_logger(0).info("Stopping HID daemon ...")
-            self.__stop_event.set()
-        if self.is_alive() or self.exitcode is not None:
-            self.join()
+        try:
+            if self.is_alive():
+                get_logger(0).info("Stopping HID daemon ...")
+                self.__stop_event.set()
+            if self.is_alive() or self.exitcode is not None:
+                self.join()
+        finally:
+            await super().cleanup()
 
     # =====
 
@@ -51,6 +51,7 @@ class Plugin(BaseHid):  # pylint: disable=too-many-instance-attributes
         mouse_x_range: dict[str, Any],
         mouse_y_range: dict[str, Any],
         jiggler: dict[str, Any],
+        capture: dict[str, Any],
 
         keyboard: dict[str, Any],
         mouse: dict[str, Any],
@@ -60,7 +61,7 @@ class Plugin(BaseHid):  # pylint: disable=too-many-instance-attributes
         udc: str,  # XXX: Not from options, see /kvmd/apps/kvmd/__init__.py for details
     ) -> None:
 
-        super().__init__(ignore_keys=ignore_keys, **mouse_x_range, **mouse_y_range, **jiggler)
+        super().__init__(ignore_keys=ignore_keys, **mouse_x_range, **mouse_y_range, **jiggler, **capture)
 
         self.__udc = udc
 
@@ -183,8 +184,11 @@ class Plugin(BaseHid):  # pylint: disable=too-many-instance-attributes
             try:
                 self.__mouse_proc.cleanup()
             finally:
-                if self.__mouse_alt_proc:
-                    self.__mouse_alt_proc.cleanup()
+                try:
+                    if self.__mouse_alt_proc:
+                        self.__mouse_alt_proc.cleanup()
+                finally:
+                    await super().cleanup()
 
     # =====
 
@@ -37,7 +37,7 @@ from .basic import valid_number
 # =====
 @add_validator_magic
 def valid_hid_keyboard_output(arg: Any) -> str:
-    return check_string_in_list(arg, "Keyboard output", ["usb", "ps2", "disabled"])
+    return check_string_in_list(arg, "Keyboard output", ["usb", "usb_nkro", "ps2", "disabled"])
 
 
 @add_validator_magic
@@ -56,6 +56,11 @@ def valid_hid_mouse_move(arg: Any) -> int:
     return MouseRange.normalize(arg)
 
 
+@add_validator_magic
+def valid_hid_mouse_interpolation(arg: Any) -> int:
+    return int(valid_number(arg, min=0, max=100, name="Mouse interpolation"))
+
+
 @add_validator_magic
 def valid_hid_mouse_button(arg: Any) -> str:
     return check_string_in_list(arg, "Mouse button", MOUSE_TO_EVDEV)
@@ -96,6 +96,8 @@ def main() -> None:
             "kvmd.apps.otgmsd",
             "kvmd.apps.otgconf",
             "kvmd.apps.swctl",
+            "kvmd.apps.hidrec",
+            "kvmd.apps.hidreplay",
             "kvmd.apps.htpasswd",
             "kvmd.apps.totp",
             "kvmd.apps.edidconf",
@@ -128,6 +130,8 @@ def main() -> None:
                 "kvmd-otgnet = kvmd.apps.otgnet:main",
                 "kvmd-otgmsd = kvmd.apps.otgmsd:main",
                 "kvmd-otgconf = kvmd.apps.otgconf:main",
+                "kvmd-hidrec = kvmd.apps.hidrec:main",
+                "kvmd-hidreplay = kvmd.apps.hidreplay:main",
                 "kvmd-htpasswd = kvmd.apps.htpasswd:main",
                 "kvmd-totp = kvmd.apps.totp:main",
                 "kvmd-edidconf = kvmd.apps.edidconf:main",
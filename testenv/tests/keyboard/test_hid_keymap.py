@@ -0,0 +1,108 @@
+# ========================================================================== #
+#                                                                            #
+#    KVMD - The main PiKVM daemon.                                           #
+#                                                                            #
+#    Copyright (C) 2018-2024  Maxim Devaev <mdevaev@gmail.com>               #
+#                                                                            #
+#    This program is free software: you can redistribute it and/or modify    #
+#    it under the terms of the GNU General Public License as published by    #
+#    the Free Software Foundation, either version 3 of the License, or       #
+#    (at your option) any later version.                                     #
+#                                                                            #
+#    This program is distributed in the hope that it will be useful,         #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of          #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           #
+#    GNU General Public License for more details.                            #
+#                                                                            #
+#    You should have received a copy of the GNU General Public License       #
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.  #
+#                                                                            #
+# ========================================================================== #
+
+
+import os
+import csv
+import shutil
+import pathlib
+import subprocess
+
+import pytest
+
+
+# =====
+_ROOT_PATH = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", "..", ".."))
+
+_DUMP_C = """
+#include <stdio.h>
+#include "hid-keymap.h"
+
+int main(void) {
+	for (unsigned code = 0; code < HID_KEYMAP_SIZE; ++code) {
+		printf("%u %u %u", code, HID_KEYMAP_READ(&hid_keymap_usb[code]), HID_KEYMAP_READ(&hid_keymap_ps2_type[code]));
+		printf(" |");
+		for (unsigned index = 0; index < hid_keymap_ps2_make[code][0]; ++index) {
+			printf(" %u", hid_keymap_ps2_make[code][index + 1]);
+		}
+		printf(" |");
+		for (unsigned index = 0; index < hid_keymap_ps2_break[code][0]; ++index) {
+			printf(" %u", hid_keymap_ps2_break[code][index + 1]);
+		}
+		printf("\\n");
+	}
+	return 0;
+}
+"""
+
+
+def _parse_usb(key: str) -> int:
+    if key.startswith("^"):  # Modifier mask -> 0xE0 + bit
+        return 0xE0 + int(key[1:], 16).bit_length() - 1
+    return int(key, 16)
+
+
+def _parse_ps2(key: str) -> tuple[int, list[int], list[int]]:
+    if not key:
+        return (0, [], [])
+    (code_type, raw_code) = key.split(":")
+    code = int(raw_code, 16)
+    return {
+        "reg":   (1, [code], [0xF0, code]),
+        "spec":  (2, [0xE0, code], [0xE0, 0xF0, code]),
+        "print": (3, [0xE0, 0x12, 0xE0, 0x7C], [0xE0, 0xF0, 0x7C, 0xE0, 0xF0, 0x12]),
+        "pause": (4, [0xE1, 0x14, 0x77, 0xE1, 0xF0, 0x14, 0xF0, 0x77], []),
+    }[code_type]
+
+
+def _dump_tables(tmp_path: pathlib.Path) -> dict[int, tuple[int, int, list[int], list[int]]]:
+    cc = shutil.which("cc")
+    if cc is None:
+        pytest.skip("No C compiler")
+    src_path = tmp_path / "dump.c"
+    bin_path = tmp_path / "dump"
+    src_path.write_text(_DUMP_C)
+    subprocess.run([
+        cc, "-std=c99", "-Wall", "-Werror",
+        "-I", os.path.join(_ROOT_PATH, "hid", "common"),
+        str(src_path), "-o", str(bin_path),
+    ], check=True)
+    tables: dict[int, tuple[int, int, list[int], list[int]]] = {}
+    for line in subprocess.run([str(bin_path)], check=True, capture_output=True, text=True).stdout.splitlines():
+        (head, make, brk) = line.split("|")
+        (code, usb, ps2_type) = map(int, head.split())
+        tables[code] = (usb, ps2_type, list(map(int, make.split())), list(map(int, brk.split())))
+    return tables
+
+
+# =====
+def test_ok__hid_keymap__roundtrip(tmp_path: pathlib.Path) -> None:
+    tables = _dump_tables(tmp_path)
+    seen: set[int] = set()
+    with open(os.path.join(_ROOT_PATH, "keymap.csv")) as file:
+        for row in csv.DictReader(file):
+            code = int(row["mcu_code"])
+            (ps2_type, make, brk) = _parse_ps2(row["ps2_key"])
+            assert tables[code] == (_parse_usb(row["usb_key"]), ps2_type, make, brk), row["web_name"]
+            seen.add(code)
+    for (code, value) in tables.items():
+        if code not in seen:
+            assert value == (0, 0, [], []), code
@@ -29,6 +29,7 @@ from kvmd.keyboard.mappings import WEB_TO_EVDEV
 from kvmd.validators import ValidatorError
 from kvmd.validators.hid import valid_hid_key
 from kvmd.validators.hid import valid_hid_mouse_move
+from kvmd.validators.hid import valid_hid_mouse_interpolation
 from kvmd.validators.hid import valid_hid_mouse_button
 from kvmd.validators.hid import valid_hid_mouse_delta
 
@@ -66,6 +67,20 @@ def test_fail__valid_hid_mouse_move(arg: Any) -> None:
         print(valid_hid_mouse_move(arg))
 
 
+# =====
+@pytest.mark.parametrize("arg", ["0 ", "1", 8, 100, "0x10"])
+def test_ok__valid_hid_mouse_interpolation(arg: Any) -> None:
+    value = valid_hid_mouse_interpolation(arg)
+    assert type(value) is int  # pylint: disable=unidiomatic-typecheck
+    assert value == int(str(arg).strip(), 0)
+
+
+@pytest.mark.parametrize("arg", ["test", "", None, -1, 101, 1.1])
+def test_fail__valid_hid_mouse_interpolation(arg: Any) -> None:
+    with pytest.raises(ValidatorError):
+        print(valid_hid_mouse_interpolation(arg))
+
+
 # =====
 @pytest.mark.parametrize("arg", ["LEFT ", "RIGHT ", "Up ", " Down", " MiDdLe "])
 def test_ok__valid_hid_mouse_button(arg: Any) -> None:
@@ -165,6 +165,7 @@ export function Hid(__getGeometry, __recorder) {
 				let html = "";
 				for (let kv of [
 					["USB",  "usb"],
+					["NKRO", "usb_nkro"],
 					["PS/2", "ps2"],
 					["Off",  "disabled"],
 				]) {